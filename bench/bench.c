@@ -0,0 +1,693 @@
+/*
+benchmarks of the whole analysis and of its kernels on a corpus
+(generate_corpus.py, make bench). every result is printed as one
+JSON object per line, times are the best and the median of all
+repetitions.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "tree_sitter/api.h"
+#include "analysis.h"
+#include "detector_registry.h"
+#include "file_utils.h"
+#include "filter_utils.h"
+#include "line_index.h"
+#include "path_table.h"
+#include "prefilter.h"
+#include "query_registry.h"
+#include "smell_list.h"
+#include "tree_visitor.h"
+#include "tree_allocator.h"
+#include "cc.h"
+#include "tcc.h"
+#include "atfd.h"
+
+#define DEFAULT_REPEAT 5
+#define DEFAULT_FILTER_SIZE 100000
+#define INITIAL_NODE_CAPACITY 256
+
+typedef struct {
+    const char *path;
+    size_t thread_count;
+    size_t repeat;
+    size_t filter_size;
+} Bench_options;
+
+// a parsed file of the corpus
+typedef struct {
+    const Matlab_file *file;
+    TSTree *tree;
+    size_t node_count;
+} Parsed_file;
+
+typedef struct {
+    TSNode node;
+    const char *source_code;
+} Subtree;
+
+// collects the subtrees of one node type, the state of the collecting hooks
+typedef struct {
+    Subtree *subtrees;
+    size_t count;
+    size_t capacity;
+    const char *source_code;
+    int failed;
+} Subtree_list;
+
+static uint64_t now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000u + (uint64_t)time.tv_nsec;
+}
+
+static int compare_times(const void *a, const void *b) {
+    uint64_t time_a = *(const uint64_t *)a;
+    uint64_t time_b = *(const uint64_t *)b;
+    return (time_a > time_b) - (time_a < time_b);
+}
+
+// sorts the times, times[0] is the best run afterwards
+static uint64_t median_time(uint64_t *times, size_t count) {
+    qsort(times, count, sizeof(uint64_t), compare_times);
+    return times[count / 2];
+}
+
+static long peak_rss_kib(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+    return usage.ru_maxrss; // KiB on Linux
+}
+
+static void print_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s [options] <corpus path>\n", program_name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -j N              threads of the end to end run (default 1)\n");
+    fprintf(stderr, "  --repeat N        repetitions of every benchmark (default %d)\n", DEFAULT_REPEAT);
+    fprintf(stderr, "  --filter-size N   candidates per detector of the filter benchmarks (default %d)\n",
+            DEFAULT_FILTER_SIZE);
+}
+
+static int parse_count(const char *value, size_t *count) {
+    char *end;
+    long parsed = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || parsed <= 0) return -1;
+    *count = (size_t)parsed;
+    return 0;
+}
+
+static int parse_bench_options(int argc, char *argv[], Bench_options *options) {
+    options->path = NULL;
+    options->thread_count = 1;
+    options->repeat = DEFAULT_REPEAT;
+    options->filter_size = DEFAULT_FILTER_SIZE;
+
+    for (int arg_i = 1; arg_i < argc; ++arg_i) {
+        const char *arg = argv[arg_i];
+        size_t *count = NULL;
+        if (strcmp(arg, "-j") == 0) count = &options->thread_count;
+        else if (strcmp(arg, "--repeat") == 0) count = &options->repeat;
+        else if (strcmp(arg, "--filter-size") == 0) count = &options->filter_size;
+
+        if (count) {
+            if (arg_i + 1 >= argc || parse_count(argv[arg_i + 1], count) != 0) {
+                fprintf(stderr, "Error: %s expects a positive number.\n", arg);
+                print_usage(argv[0]);
+                return -1;
+            }
+            ++arg_i;
+            continue;
+        }
+        if (arg[0] == '-' || options->path) {
+            print_usage(argv[0]);
+            return -1;
+        }
+        options->path = arg;
+    }
+    if (!options->path) {
+        print_usage(argv[0]);
+        return -1;
+    }
+    return 0;
+}
+
+static void reset_smell_lists(void) {
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        detectors[detector_i]->smell_list->count = 0;
+        detectors[detector_i]->candidate_count = 0;
+    }
+}
+
+static const char *const allocator_names[] = { "heap", "arena" };
+
+// discovery, reading and analysis of the whole corpus like main does it
+static int bench_end_to_end(const Bench_options *options, int use_arenas) {
+    uint64_t times[options->repeat];
+    size_t file_count = 0;
+    size_t byte_count = 0;
+    uint32_t total_LOC = 0;
+
+    enable_tree_arenas(use_arenas);
+    for (size_t run_i = 0; run_i < options->repeat; ++run_i) {
+        reset_smell_lists();
+        uint64_t begin = now_ns();
+        File_list file_list;
+        init_file_list(&file_list);
+        Walk_options walk = { UNLIMITED_DEPTH, options->thread_count, NULL, 0, 1 };
+        load_files(options->path, &walk, &file_list);
+        int result = analyze_files(&file_list, options->thread_count, 0, &total_LOC);
+        times[run_i] = now_ns() - begin;
+
+        file_count = file_list.count;
+        byte_count = 0;
+        for (size_t file_i = 0; file_i < file_list.count; ++file_i) {
+            byte_count += file_list.files[file_i]->length;
+        }
+        free_file_list(&file_list);
+        if (result != 0) return -1;
+    }
+    enable_tree_arenas(0);
+
+    uint64_t median = median_time(times, options->repeat);
+    double best_s = times[0] / 1e9;
+    printf("{\"benchmark\": \"end_to_end\", \"allocator\": \"%s\", \"threads\": %zu, \"files\": %zu, \"loc\": %u, \"bytes\": %zu, "
+           "\"best_s\": %.6f, \"median_s\": %.6f, \"files_per_s\": %.1f, \"loc_per_s\": %.1f, "
+           "\"mb_per_s\": %.2f, \"peak_rss_kib\": %ld}\n",
+           allocator_names[use_arenas], options->thread_count, file_count, total_LOC, byte_count, best_s, median / 1e9,
+           file_count / best_s, total_LOC / best_s, byte_count / best_s / 1e6, peak_rss_kib());
+    return 0;
+}
+
+static size_t count_nodes(TSNode root) {
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+    size_t node_count = 0;
+    for (;;) {
+        node_count++;
+        if (ts_tree_cursor_goto_first_child(&cursor)) continue;
+        while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                ts_tree_cursor_delete(&cursor);
+                return node_count;
+            }
+        }
+    }
+}
+
+static Parsed_file *parse_corpus(const File_list *file_list, size_t *node_count) {
+    TSParser *parser = ts_parser_new();
+    Parsed_file *parsed = calloc(file_list->count ? file_list->count : 1, sizeof(Parsed_file));
+    if (!parser || !parsed || !ts_parser_set_language(parser, tree_sitter_matlab())) {
+        fprintf(stderr, "Failed to create parser.\n");
+        if (parser) ts_parser_delete(parser);
+        free(parsed);
+        return NULL;
+    }
+
+    *node_count = 0;
+    for (size_t file_i = 0; file_i < file_list->count; ++file_i) {
+        parsed[file_i].file = file_list->files[file_i];
+        parsed[file_i].tree = parse_matlab_file(parser, NULL, file_list->files[file_i]);
+        if (parsed[file_i].tree) {
+            parsed[file_i].node_count = count_nodes(ts_tree_root_node(parsed[file_i].tree));
+            *node_count += parsed[file_i].node_count;
+        }
+    }
+    ts_parser_delete(parser);
+    return parsed;
+}
+
+/*
+parses and drops every file of the corpus on one thread, with the
+tree-sitter allocations on the heap (one parser for all files, every
+tree deleted) and in an arena (parser and tree reset with the arena)
+*/
+static int bench_parse(const Bench_options *options, const File_list *file_list) {
+    uint64_t times[options->repeat];
+    if (file_list->count == 0) return 0;
+    size_t byte_count = 0;
+    for (size_t file_i = 0; file_i < file_list->count; ++file_i) {
+        byte_count += file_list->files[file_i]->length;
+    }
+
+    for (int use_arena = 0; use_arena <= 1; ++use_arena) {
+        Arena arena;
+        init_arena(&arena);
+        TSParser *parser = NULL;
+        if (!use_arena) {
+            parser = ts_parser_new();
+            ts_parser_set_language(parser, tree_sitter_matlab());
+        }
+
+        // the counts of the last run, the earlier ones warm up the parser and the arena
+        Tree_allocations before = {0, 0, 0};
+        Tree_allocations after = {0, 0, 0};
+        for (size_t run_i = 0; run_i < options->repeat; ++run_i) {
+            read_tree_allocations(&before);
+            uint64_t begin = now_ns();
+            for (size_t file_i = 0; file_i < file_list->count; ++file_i) {
+                if (use_arena) {
+                    begin_tree_arena(&arena);
+                    parser = ts_parser_new();
+                    ts_parser_set_language(parser, tree_sitter_matlab());
+                }
+                TSTree *tree = parse_matlab_file(parser, NULL, file_list->files[file_i]);
+                if (use_arena) {
+                    end_tree_arena();
+                    reset_arena(&arena);
+                } else if (tree) {
+                    ts_tree_delete(tree);
+                }
+            }
+            times[run_i] = now_ns() - begin;
+            read_tree_allocations(&after);
+        }
+
+        uint64_t median = median_time(times, options->repeat);
+        double file_count = (double)file_list->count;
+        printf("{\"benchmark\": \"parse\", \"allocator\": \"%s\", \"files\": %zu, \"bytes\": %zu, "
+               "\"best_s\": %.6f, \"median_s\": %.6f, \"mb_per_s\": %.2f, \"heap_allocations_per_file\": %.1f, "
+               "\"heap_frees_per_file\": %.1f, \"arena_allocations_per_file\": %.1f, \"arena_blocks\": %zu}\n",
+               allocator_names[use_arena], file_list->count, byte_count, times[0] / 1e9, median / 1e9,
+               byte_count / (times[0] / 1e9) / 1e6,
+               (after.heap_allocations - before.heap_allocations) / file_count,
+               (after.heap_frees - before.heap_frees) / file_count,
+               (after.arena_allocations - before.arena_allocations) / file_count, arena_block_count(&arena));
+
+        if (!use_arena) ts_parser_delete(parser);
+        free_arena(&arena);
+    }
+    return 0;
+}
+
+// keyword scan of every file of the corpus, with the line count of the files it skips
+static int bench_prefilter(const Bench_options *options, const File_list *file_list) {
+    uint64_t times[options->repeat];
+    size_t byte_count = 0;
+    size_t skipped_count = 0;
+    uint32_t skipped_LOC = 0;
+    for (size_t file_i = 0; file_i < file_list->count; ++file_i) {
+        byte_count += file_list->files[file_i]->length;
+    }
+
+    for (size_t run_i = 0; run_i < options->repeat; ++run_i) {
+        skipped_count = 0;
+        skipped_LOC = 0;
+        uint64_t begin = now_ns();
+        for (size_t file_i = 0; file_i < file_list->count; ++file_i) {
+            if (!file_needs_parse(file_list->files[file_i])) {
+                ++skipped_count;
+                skipped_LOC += count_unparsed_LOC(file_list->files[file_i]);
+            }
+        }
+        times[run_i] = now_ns() - begin;
+    }
+
+    uint64_t median = median_time(times, options->repeat);
+    printf("{\"benchmark\": \"prefilter\", \"files\": %zu, \"bytes\": %zu, \"skipped_files\": %zu, "
+           "\"skipped_loc\": %u, \"best_s\": %.6f, \"median_s\": %.6f, \"mb_per_s\": %.2f}\n",
+           file_list->count, byte_count, skipped_count, skipped_LOC, times[0] / 1e9, median / 1e9,
+           byte_count / (times[0] / 1e9) / 1e6);
+    return 0;
+}
+
+// newline scan and line classification of every file of the corpus, one index reused like the workers do
+static int bench_line_index(const Bench_options *options, const File_list *file_list) {
+    uint64_t times[options->repeat];
+    size_t byte_count = 0;
+    size_t line_count = 0;
+    for (size_t file_i = 0; file_i < file_list->count; ++file_i) {
+        byte_count += file_list->files[file_i]->length;
+    }
+
+    Line_index index;
+    init_line_index(&index);
+    int result = 0;
+    for (size_t run_i = 0; run_i < options->repeat && result == 0; ++run_i) {
+        line_count = 0;
+        uint64_t begin = now_ns();
+        for (size_t file_i = 0; file_i < file_list->count && result == 0; ++file_i) {
+            result = build_line_index(&index, file_list->files[file_i]->content, file_list->files[file_i]->length);
+            line_count += index.line_count;
+        }
+        times[run_i] = now_ns() - begin;
+    }
+    free_line_index(&index);
+    if (result != 0) {
+        fprintf(stderr, "Failed to index the lines of the corpus.\n");
+        return -1;
+    }
+
+    uint64_t median = median_time(times, options->repeat);
+    printf("{\"benchmark\": \"line_index\", \"files\": %zu, \"bytes\": %zu, \"lines\": %zu, "
+           "\"best_s\": %.6f, \"median_s\": %.6f, \"mb_per_s\": %.2f}\n",
+           file_list->count, byte_count, line_count, times[0] / 1e9, median / 1e9,
+           byte_count / (times[0] / 1e9) / 1e6);
+    return 0;
+}
+
+static void free_parsed_corpus(Parsed_file *parsed, size_t file_count) {
+    for (size_t file_i = 0; file_i < file_count; ++file_i) {
+        if (parsed[file_i].tree) ts_tree_delete(parsed[file_i].tree);
+    }
+    free(parsed);
+}
+
+static void print_visitor_result(const char *name, uint64_t *times, size_t repeat, size_t node_count) {
+    uint64_t median = median_time(times, repeat);
+    printf("{\"benchmark\": \"detector\", \"detector\": \"%s\", \"nodes\": %zu, "
+           "\"best_ns_per_node\": %.3f, \"median_ns_per_node\": %.3f}\n",
+           name, node_count, (double)times[0] / node_count, (double)median / node_count);
+}
+
+/*
+every detector alone on the parsed trees, then all of them in
+the shared pass and a visitor without hooks as the cost of the
+traversal itself
+*/
+static int bench_detectors(const Bench_options *options, const Parsed_file *parsed, size_t file_count,
+                           size_t node_count) {
+    uint64_t times[options->repeat];
+    if (node_count == 0) return 0;
+
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        Smell_detector *detector = detectors[detector_i];
+        const Visitor_hook *hook_list = detector->hooks;
+        Tree_visitor *visitor = create_tree_visitor(&hook_list, 1);
+        void *state = calloc(1, detector->state_size);
+        Smell_list list;
+        if (!visitor || !state || init_smell_list(&list, detector->metrics, detector->metric_count) != 0) {
+            fprintf(stderr, "Failed to prepare detector %s.\n", detector->name);
+            free_tree_visitor(visitor);
+            free(state);
+            return -1;
+        }
+
+        for (size_t run_i = 0; run_i < options->repeat; ++run_i) {
+            list.count = 0;
+            uint64_t begin = now_ns();
+            for (size_t file_i = 0; file_i < file_count; ++file_i) {
+                if (!parsed[file_i].tree) continue;
+                detector->begin_file(state, parsed[file_i].file, &list);
+                walk_tree(visitor, ts_tree_root_node(parsed[file_i].tree), &state);
+                if (detector->end_file) detector->end_file(state);
+            }
+            times[run_i] = now_ns() - begin;
+        }
+        print_visitor_result(detector->name, times, options->repeat, node_count);
+
+        if (detector->free_state) detector->free_state(state);
+        free(state);
+        free_smell_list(&list);
+        free_tree_visitor(visitor);
+    }
+
+    Tree_visitor *visitor = create_detector_visitor();
+    void *detector_states[detector_count];
+    Smell_list lists[detector_count];
+    Smell_list *list_pointers[detector_count];
+    memset(detector_states, 0, sizeof(detector_states));
+    int result = visitor ? init_detector_states(detector_states) : -1;
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        if (init_smell_list(&lists[detector_i], detectors[detector_i]->metrics,
+                            detectors[detector_i]->metric_count) != 0) {
+            result = -1;
+        }
+        list_pointers[detector_i] = &lists[detector_i];
+    }
+
+    if (result == 0) {
+        for (size_t run_i = 0; run_i < options->repeat; ++run_i) {
+            for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) lists[detector_i].count = 0;
+            uint64_t begin = now_ns();
+            for (size_t file_i = 0; file_i < file_count; ++file_i) {
+                if (!parsed[file_i].tree) continue;
+                run_detectors(visitor, detector_states, ts_tree_root_node(parsed[file_i].tree),
+                              parsed[file_i].file, list_pointers);
+            }
+            times[run_i] = now_ns() - begin;
+        }
+        print_visitor_result("all", times, options->repeat, node_count);
+    }
+    free_detector_states(detector_states);
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) free_smell_list(&lists[detector_i]);
+    free_tree_visitor(visitor);
+    if (result != 0) {
+        fprintf(stderr, "Failed to prepare the shared detector pass.\n");
+        return -1;
+    }
+
+    static const Visitor_hook no_hooks[] = { END_OF_HOOKS };
+    const Visitor_hook *hook_list = no_hooks;
+    Tree_visitor *empty_visitor = create_tree_visitor(&hook_list, 1);
+    if (!empty_visitor) return -1;
+    void *no_state = NULL;
+    for (size_t run_i = 0; run_i < options->repeat; ++run_i) {
+        uint64_t begin = now_ns();
+        for (size_t file_i = 0; file_i < file_count; ++file_i) {
+            if (parsed[file_i].tree) walk_tree(empty_visitor, ts_tree_root_node(parsed[file_i].tree), &no_state);
+        }
+        times[run_i] = now_ns() - begin;
+    }
+    print_visitor_result("traversal", times, options->repeat, node_count);
+    free_tree_visitor(empty_visitor);
+    return 0;
+}
+
+static void collect_subtree(void *state, TSNode node) {
+    Subtree_list *list = state;
+    if (list->failed) return;
+    if (list->count >= list->capacity) {
+        size_t new_capacity = list->capacity ? list->capacity * 2 : INITIAL_NODE_CAPACITY;
+        Subtree *larger = realloc(list->subtrees, new_capacity * sizeof(Subtree));
+        if (!larger) {
+            list->failed = 1;
+            return;
+        }
+        list->subtrees = larger;
+        list->capacity = new_capacity;
+    }
+    list->subtrees[list->count++] = (Subtree){ node, list->source_code };
+}
+
+static int collect_subtrees(const Parsed_file *parsed, size_t file_count,
+                            Subtree_list *functions, Subtree_list *classes) {
+    static const Visitor_hook function_hooks[] = { {"function_definition", collect_subtree, NULL}, END_OF_HOOKS };
+    static const Visitor_hook class_hooks[] = { {"class_definition", collect_subtree, NULL}, END_OF_HOOKS };
+    const Visitor_hook *hook_lists[] = { function_hooks, class_hooks };
+    Tree_visitor *visitor = create_tree_visitor(hook_lists, 2);
+    if (!visitor) return -1;
+
+    void *states[] = { functions, classes };
+    for (size_t file_i = 0; file_i < file_count; ++file_i) {
+        if (!parsed[file_i].tree) continue;
+        functions->source_code = parsed[file_i].file->content;
+        classes->source_code = parsed[file_i].file->content;
+        walk_tree(visitor, ts_tree_root_node(parsed[file_i].tree), states);
+    }
+    free_tree_visitor(visitor);
+    return functions->failed || classes->failed ? -1 : 0;
+}
+
+typedef enum {
+    KERNEL_BINARY_SPLITS,
+    KERNEL_TCC,
+    KERNEL_ATFD
+} Kernel_id;
+
+static const char *const kernel_names[] = {
+    [KERNEL_BINARY_SPLITS] = "count_binary_splits",
+    [KERNEL_TCC] = "compute_tcc",
+    [KERNEL_ATFD] = "compute_atfd"
+};
+
+// keeps the compiler from dropping the kernel calls
+static volatile double kernel_sink;
+
+static void bench_kernel(const Bench_options *options, Kernel_id kernel, const Subtree_list *subtrees) {
+    if (subtrees->count == 0) return;
+    uint64_t times[options->repeat];
+    for (size_t run_i = 0; run_i < options->repeat; ++run_i) {
+        double sum = 0;
+        uint64_t begin = now_ns();
+        for (size_t subtree_i = 0; subtree_i < subtrees->count; ++subtree_i) {
+            const Subtree *subtree = &subtrees->subtrees[subtree_i];
+            switch (kernel) {
+                case KERNEL_BINARY_SPLITS: sum += count_binary_splits(subtree->node); break;
+                case KERNEL_TCC: sum += compute_tcc(subtree->node, subtree->source_code); break;
+                case KERNEL_ATFD: sum += compute_atfd(subtree->node, subtree->source_code); break;
+            }
+        }
+        times[run_i] = now_ns() - begin;
+        kernel_sink = sum;
+    }
+    uint64_t median = median_time(times, options->repeat);
+    printf("{\"benchmark\": \"kernel\", \"kernel\": \"%s\", \"calls\": %zu, "
+           "\"best_ns_per_call\": %.1f, \"median_ns_per_call\": %.1f}\n",
+           kernel_names[kernel], subtrees->count, (double)times[0] / subtrees->count,
+           (double)median / subtrees->count);
+}
+
+static int bench_kernels(const Bench_options *options, const Parsed_file *parsed, size_t file_count) {
+    Subtree_list functions = {0};
+    Subtree_list classes = {0};
+    int result = collect_subtrees(parsed, file_count, &functions, &classes);
+    if (result == 0) {
+        bench_kernel(options, KERNEL_BINARY_SPLITS, &functions);
+        bench_kernel(options, KERNEL_TCC, &classes);
+        bench_kernel(options, KERNEL_ATFD, &classes);
+    } else {
+        fprintf(stderr, "Failed to collect functions and classes.\n");
+    }
+    free(functions.subtrees);
+    free(classes.subtrees);
+    return result;
+}
+
+// deterministic pseudo random numbers (xorshift64)
+static uint64_t next_random(uint64_t *random_state) {
+    uint64_t x = *random_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *random_state = x;
+}
+
+static int fill_synthetic_candidates(Smell_list *list, size_t count, uint64_t *random_state) {
+    for (size_t smell_i = 0; smell_i < count; ++smell_i) {
+        // every candidate needs a distinct location, the filters order ties by it
+        size_t added = add_smell(list, create_location("synthetic.m", (uint32_t)smell_i + 1));
+        if (added == SMELL_NOT_ADDED) return -1;
+        for (size_t metric_i = 0; metric_i < list->metric_count; ++metric_i) {
+            uint64_t value = next_random(random_state);
+            if (list->metrics[metric_i].is_float) {
+                set_float_metric(list, added, metric_i, (float)(value % 10001) / 10000.0f);
+            } else {
+                set_int_metric(list, added, metric_i, (int32_t)(value % 200));
+            }
+        }
+    }
+    return 0;
+}
+
+static void set_use_percentage(Smell_detector *detector, const int *use_percentage) {
+    for (size_t config_i = 0; config_i < detector->config_count; ++config_i) {
+        detector->configs[config_i].use_percentage = use_percentage[config_i];
+    }
+}
+
+/*
+filter_smell_list on filter_size synthetic candidates per
+detector, once with config.ini and once with every step
+keeping a percentage
+*/
+static int bench_filters(const Bench_options *options) {
+    uint64_t times[options->repeat];
+    uint64_t random_state = 0x9e3779b97f4a7c15u;
+
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        Smell_detector *detector = detectors[detector_i];
+        Smell_list candidates;
+        if (init_smell_list(&candidates, detector->metrics, detector->metric_count) != 0) return -1;
+        if (fill_synthetic_candidates(&candidates, options->filter_size, &random_state) != 0) {
+            free_smell_list(&candidates);
+            return -1;
+        }
+
+        int configured[MAX_CONFIGS];
+        int all_percentage[MAX_CONFIGS];
+        for (size_t config_i = 0; config_i < detector->config_count; ++config_i) {
+            configured[config_i] = detector->configs[config_i].use_percentage;
+            all_percentage[config_i] = 1;
+        }
+        const char *mode_names[] = { "configured", "percentage" };
+        const int *modes[] = { configured, all_percentage };
+
+        for (size_t mode_i = 0; mode_i < 2; ++mode_i) {
+            set_use_percentage(detector, modes[mode_i]);
+            size_t kept = 0;
+            for (size_t run_i = 0; run_i < options->repeat; ++run_i) {
+                if (copy_smell_list(detector->smell_list, &candidates) != 0) {
+                    set_use_percentage(detector, configured);
+                    free_smell_list(&candidates);
+                    return -1;
+                }
+                detector->candidate_count = candidates.count;
+                uint64_t begin = now_ns();
+                filter_smell_list(detector);
+                times[run_i] = now_ns() - begin;
+                kept = detector->smell_list->count;
+            }
+            uint64_t median = median_time(times, options->repeat);
+            printf("{\"benchmark\": \"filter\", \"detector\": \"%s\", \"mode\": \"%s\", \"candidates\": %zu, "
+                   "\"kept\": %zu, \"best_ns_per_candidate\": %.2f, \"median_ns_per_candidate\": %.2f}\n",
+                   detector->name, mode_names[mode_i], candidates.count, kept,
+                   (double)times[0] / candidates.count, (double)median / candidates.count);
+        }
+        set_use_percentage(detector, configured);
+        detector->smell_list->count = 0;
+        free_smell_list(&candidates);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    Bench_options options;
+    if (parse_bench_options(argc, argv, &options) != 0) return EXIT_FAILURE;
+
+    load_config("config.ini", detectors, detector_count);
+    // both allocators are compared, the heap mode counts its calls through the same wrapper
+    install_tree_allocator();
+    if (compile_queries() != 0) {
+        fprintf(stderr, "Error: Failed to compile detector queries.\n");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < detector_count; ++i) {
+        detectors[i]->smell_list = malloc(sizeof(Smell_list));
+        if (!detectors[i]->smell_list
+                || init_smell_list(detectors[i]->smell_list, detectors[i]->metrics, detectors[i]->metric_count) != 0) {
+            fprintf(stderr, "Error: Failed to allocate smell lists.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // first, so peak_rss_kib is the peak of the analysis alone (of both runs for the arena)
+    int result = bench_end_to_end(&options, 0);
+    if (result == 0) result = bench_end_to_end(&options, 1);
+
+    File_list file_list;
+    init_file_list(&file_list);
+    size_t node_count = 0;
+    Parsed_file *parsed = NULL;
+    Walk_options walk = { UNLIMITED_DEPTH, options.thread_count, NULL, 0, 1 };
+    if (result == 0 && load_files(options.path, &walk, &file_list) == 0) {
+        if (bench_parse(&options, &file_list) != 0) result = -1;
+        if (bench_prefilter(&options, &file_list) != 0) result = -1;
+        if (bench_line_index(&options, &file_list) != 0) result = -1;
+        parsed = parse_corpus(&file_list, &node_count);
+    }
+    if (!parsed) {
+        result = -1;
+    } else {
+        if (bench_detectors(&options, parsed, file_list.count, node_count) != 0) result = -1;
+        if (bench_kernels(&options, parsed, file_list.count) != 0) result = -1;
+        free_parsed_corpus(parsed, file_list.count);
+    }
+    free_file_list(&file_list);
+
+    if (result == 0 && bench_filters(&options) != 0) result = -1;
+    printf("{\"benchmark\": \"process\", \"peak_rss_kib\": %ld}\n", peak_rss_kib());
+
+    for (size_t i = 0; i < detector_count; ++i) {
+        free_smell_list(detectors[i]->smell_list);
+        free(detectors[i]->smell_list);
+    }
+    free_path_table();
+    free_queries();
+    if (result != 0) fprintf(stderr, "Error: Benchmark failed.\n");
+    return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,36 @@
+# this python script checks the results of the benchmarks (make
+# bench) before they are passed on. every line has to be one JSON
+# object, anything else printed to stdout (by the library or the
+# benchmarks) makes the results file unreadable and fails the run.
+# the lines are printed unchanged once all of them are valid.
+
+import argparse
+import json
+import sys
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(description="check that the benchmark results are JSON lines")
+    parser.add_argument("results", help="stdout of bench/bench")
+    return parser.parse_args()
+
+
+def main():
+    arguments = parse_arguments()
+    with open(arguments.results, encoding="utf-8") as file:
+        lines = file.read().splitlines()
+
+    for line_number, line in enumerate(lines, start=1):
+        try:
+            result = json.loads(line)
+        except json.JSONDecodeError as error:
+            raise SystemExit(f"{arguments.results}:{line_number}: no JSON ({error}): {line[:80]}")
+        if not isinstance(result, dict) or "benchmark" not in result:
+            raise SystemExit(f"{arguments.results}:{line_number}: no benchmark result: {line[:80]}")
+
+    for line in lines:
+        print(line)
+
+
+if __name__ == "__main__":
+    main()
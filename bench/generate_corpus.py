@@ -0,0 +1,184 @@
+# this python script generates a synthetic MATLAB code base for
+# the benchmarks (make bench). the output only depends on the
+# arguments, the same seed always produces the same files.
+#
+# every size is given as mean, the actual values vary by
+# --jitter around it. a share of the files are classdef files,
+# the others are function files with local functions.
+
+import argparse
+import json
+import os
+import random
+import shutil
+
+MANIFEST = "corpus.json"
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(description="generate a synthetic MATLAB corpus")
+    parser.add_argument("output", help="directory of the corpus, replaced if the parameters changed")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--files", type=int, default=2000, help="number of .m files")
+    parser.add_argument("--directories", type=int, default=20, help="files are spread over this many directories")
+    parser.add_argument("--class-share", type=float, default=0.3, help="share of classdef files")
+    parser.add_argument("--functions", type=int, default=6, help="functions per function file")
+    parser.add_argument("--parameters", type=int, default=3, help="parameters per function")
+    parser.add_argument("--statements", type=int, default=20, help="statements per function or method body")
+    parser.add_argument("--branches", type=int, default=4, help="control flow statements per body")
+    parser.add_argument("--nesting", type=int, default=2, help="maximum nesting depth of control flow")
+    parser.add_argument("--properties", type=int, default=8, help="properties per class")
+    parser.add_argument("--methods", type=int, default=10, help="methods per class")
+    parser.add_argument("--foreign-accesses", type=int, default=2, help="foreign field accesses per method")
+    parser.add_argument("--jitter", type=float, default=0.5, help="relative variation of all sizes")
+    return parser.parse_args()
+
+
+class Generator:
+    def __init__(self, arguments):
+        self.arguments = arguments
+        self.random = random.Random(arguments.seed)
+
+    def size(self, mean):
+        """mean varied by the jitter, at least 0"""
+        spread = int(mean * self.arguments.jitter)
+        return max(0, mean + self.random.randint(-spread, spread))
+
+    def variable(self, names):
+        return self.random.choice(names)
+
+    def expression(self, names):
+        operator = self.random.choice(["+", "-", "*", "./", ".*"])
+        return f"{self.variable(names)} {operator} {self.random.randint(1, 99)}"
+
+    def condition(self, names):
+        operator = self.random.choice(["<", ">", "==", "~=", ">="])
+        return f"{self.variable(names)} {operator} {self.random.randint(0, 50)}"
+
+    def statement(self, names, accesses):
+        choice = self.random.random()
+        target = self.variable(names)
+        if accesses and choice < 0.3:
+            return f"{target} = {self.random.choice(accesses)} + {self.expression(names)};"
+        if choice < 0.5:
+            return f"{target} = zeros({self.random.randint(1, 9)}, {self.random.randint(1, 9)});"
+        if choice < 0.6:
+            return f"disp({target}); % {self.random.randint(0, 1 << 20):x}"
+        return f"{target} = {self.expression(names)};"
+
+    def branch(self, names, accesses, depth, indent):
+        """one control flow statement, bodies may nest further branches"""
+        pad = "    " * indent
+        body = lambda: self.block(names, accesses, self.random.randint(1, 3),
+                                  1 if depth < self.arguments.nesting else 0, depth + 1, indent + 1)
+        kind = self.random.choice(["if", "if", "for", "while", "switch", "try"])
+        if kind == "if":
+            lines = [f"{pad}if {self.condition(names)}"] + body()
+            for _ in range(self.random.randint(0, 2)):
+                lines += [f"{pad}elseif {self.condition(names)}"] + body()
+            if self.random.random() < 0.5:
+                lines += [f"{pad}else"] + body()
+        elif kind == "for":
+            lines = [f"{pad}for k = 1:{self.random.randint(2, 100)}"] + body()
+        elif kind == "while":
+            lines = [f"{pad}while {self.condition(names)}"] + body()
+        elif kind == "switch":
+            lines = [f"{pad}switch {self.variable(names)}"]
+            for case in range(self.random.randint(1, 4)):
+                lines += [f"{pad}    case {case}"] + [
+                    "    " + line for line in body()]
+            lines += [f"{pad}    otherwise", f"{pad}        {self.statement(names, accesses)}"]
+        else:
+            lines = [f"{pad}try"] + body() + [f"{pad}catch err", f"{pad}    disp(err.message);"]
+        return lines + [f"{pad}end"]
+
+    def block(self, names, accesses, statements, branches, depth, indent):
+        """statements and branches in random order"""
+        kinds = ["statement"] * statements + ["branch"] * branches
+        self.random.shuffle(kinds)
+        lines = []
+        for kind in kinds:
+            if kind == "branch":
+                lines += self.branch(names, accesses, depth, indent)
+            else:
+                lines.append("    " * indent + self.statement(names, accesses))
+        return lines
+
+    def function(self, name, first_parameter=None, accesses=(), indent=0):
+        parameters = [f"p{i}" for i in range(self.size(self.arguments.parameters))]
+        if first_parameter:
+            parameters.insert(0, first_parameter)
+        names = ["result"] + parameters[1 if first_parameter else 0:] + [f"v{i}" for i in range(3)]
+        pad = "    " * indent
+        lines = [f"{pad}function result = {name}({', '.join(parameters)})",
+                 f"{pad}    result = 0;"]
+        lines += [f"{pad}    v{i} = {self.random.randint(0, 9)};" for i in range(3)]
+        lines += self.block(names, list(accesses), self.size(self.arguments.statements),
+                            self.size(self.arguments.branches), 1, indent + 1)
+        return lines + [f"{pad}end", ""]
+
+    def function_file(self, name):
+        lines = []
+        for function_i in range(max(1, self.size(self.arguments.functions))):
+            lines += self.function(name if function_i == 0 else f"{name}_helper{function_i}")
+        return lines
+
+    def class_file(self, name):
+        properties = [f"prop{i}" for i in range(max(1, self.size(self.arguments.properties)))]
+        lines = [f"classdef {name} < handle", "    properties"]
+        lines += [f"        {prop} = {self.random.randint(0, 9)}" for prop in properties]
+        lines += ["    end", "", "    methods"]
+
+        # constructor, excluded from ATFD and TCC
+        lines += [f"        function obj = {name}(value)"]
+        lines += [f"            obj.{prop} = value;" for prop in properties]
+        lines += ["        end", ""]
+
+        for method_i in range(self.size(self.arguments.methods)):
+            used = self.random.sample(properties, self.random.randint(1, min(3, len(properties))))
+            accesses = [f"obj.{prop}" for prop in used]
+            accesses += [f"other{i}.field{self.random.randint(0, 9)}"
+                         for i in range(self.size(self.arguments.foreign_accesses))]
+            lines += self.function(f"method{method_i}", "obj", accesses, indent=2)
+        return lines + ["    end", "end", ""]
+
+
+def write_corpus(arguments):
+    generator = Generator(arguments)
+    directories = max(1, arguments.directories)
+    for file_i in range(arguments.files):
+        directory = os.path.join(arguments.output, f"package{file_i % directories}")
+        os.makedirs(directory, exist_ok=True)
+        if generator.random.random() < arguments.class_share:
+            name = f"Class{file_i}"
+            lines = generator.class_file(name)
+        else:
+            name = f"function{file_i}"
+            lines = generator.function_file(name)
+        with open(os.path.join(directory, name + ".m"), "w", encoding="utf-8") as file:
+            file.write("\n".join(lines))
+
+
+def main():
+    arguments = parse_arguments()
+    parameters = dict(vars(arguments))
+    del parameters["output"]
+
+    manifest_path = os.path.join(arguments.output, MANIFEST)
+    if os.path.exists(manifest_path):
+        with open(manifest_path, encoding="utf-8") as file:
+            if json.load(file) == parameters:
+                return  # already generated with the same parameters
+        shutil.rmtree(arguments.output)
+    elif os.path.exists(arguments.output) and os.listdir(arguments.output):
+        # never replace a directory this script didn't generate
+        raise SystemExit(f"{arguments.output} exists and is no generated corpus")
+
+    write_corpus(arguments)
+    with open(manifest_path, "w", encoding="utf-8") as file:
+        json.dump(parameters, file, indent=2)
+    print(f"generated {arguments.files} files in {arguments.output}")
+
+
+if __name__ == "__main__":
+    main()
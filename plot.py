@@ -11,7 +11,18 @@ import pandas as pd
 import matplotlib.pyplot as plt
 import os
 
-df = pd.read_csv("output.csv")
+from smell_results import default_results_path, load_results
+
+# fast path: ./main --binary output.bin, no parsing
+results_path = default_results_path()
+if results_path:
+    tables = load_results(results_path).values()
+    df = pd.DataFrame({
+        'smell_type': [table.name for table in tables for _ in range(len(table))],
+        'file_name': [name for table in tables for name in table.file_names()],
+    })
+else:
+    df = pd.read_csv("output.csv")
 
 # strips path from file name
 df['file_name'] = df['file_name'].apply(os.path.basename)
@@ -2,38 +2,68 @@ import csv
 import matplotlib.pyplot as plt
 import numpy as np
 
-with open('output.csv', 'r', encoding='utf-8') as file:
-    csv_reader = csv.DictReader(file)
-    rows = list(csv_reader)
+from smell_results import default_results_path, load_results
 
-smell_types = []
-for row in rows:
-    if row['smell_type'] not in smell_types:
-        smell_types.append(row['smell_type'])
 
-# one plot for each smell type
-for smell_type in smell_types:
-    file_names = []
-    all_metrics = []  # stores dictionaries of metric_name: value
-   
-    count = 0
+def worst_from_binary(path):
+    """smell type -> (labels, metrics) of the first 5 smells, read from the binary results"""
+    worst = {}
+    for smell_type, table in load_results(path).items():
+        count = min(len(table), 5)
+        file_names = []
+        all_metrics = []
+        for i in range(count):
+            short_filename = table.files[table.file_ids[i]].split('/')[-1]
+            file_names.append(f"{short_filename}\n(line {table.lines[i]})")
+            all_metrics.append({name: float(column[i]) for name, column in table.metrics.items()})
+        worst[smell_type] = (file_names, all_metrics)
+    return worst
+
+
+def worst_from_csv(path):
+    with open(path, 'r', encoding='utf-8') as file:
+        csv_reader = csv.DictReader(file)
+        rows = list(csv_reader)
+
+    smell_types = []
     for row in rows:
-        if row['smell_type'] == smell_type and count < 5:
-            # extract file name from path
-            short_filename = row['file_name'].split('/')[-1]
-            file_names.append(f"{short_filename}\n(line {row['line']})")
-           
-            metrics = {}
-            if row['metric1_name'] and row['metric1_measured_value']:
-                metrics[row['metric1_name']] = float(row['metric1_measured_value'])
-            if row['metric2_name'] and row['metric2_measured_value']:
-                metrics[row['metric2_name']] = float(row['metric2_measured_value'])
-            if row['metric3_name'] and row['metric3_measured_value']:
-                metrics[row['metric3_name']] = float(row['metric3_measured_value'])
-           
-            all_metrics.append(metrics)
-            count += 1
-   
+        if row['smell_type'] not in smell_types:
+            smell_types.append(row['smell_type'])
+
+    worst = {}
+    for smell_type in smell_types:
+        file_names = []
+        all_metrics = []  # stores dictionaries of metric_name: value
+
+        count = 0
+        for row in rows:
+            if row['smell_type'] == smell_type and count < 5:
+                # extract file name from path
+                short_filename = row['file_name'].split('/')[-1]
+                file_names.append(f"{short_filename}\n(line {row['line']})")
+
+                metrics = {}
+                # as many metric columns as the detector with the most metrics has
+                metric_i = 1
+                while f'metric{metric_i}_name' in row:
+                    name = row[f'metric{metric_i}_name']
+                    value = row[f'metric{metric_i}_measured_value']
+                    if name and value:
+                        metrics[name] = float(value)
+                    metric_i += 1
+
+                all_metrics.append(metrics)
+                count += 1
+        worst[smell_type] = (file_names, all_metrics)
+    return worst
+
+
+# fast path: ./main --binary output.bin, no parsing
+results_path = default_results_path()
+worst = worst_from_binary(results_path) if results_path else worst_from_csv('output.csv')
+
+# one plot for each smell type
+for smell_type, (file_names, all_metrics) in worst.items():
     if not file_names:
         continue
    
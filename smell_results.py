@@ -0,0 +1,111 @@
+# this python module reads the binary results file written with
+# ./main --binary FILE (layout described in src/binary_report.h)
+# the file is memory mapped, the columns are numpy views into the
+# mapping and nothing is parsed except the small header and the
+# string pool
+
+import mmap
+import os
+
+import numpy as np
+
+MAGIC = b"MSDR"
+FORMAT_VERSION = 3
+BYTE_ORDER = 0x01020304
+METRIC_TYPES = (np.int32, np.float32)
+
+HEADER = np.dtype([
+    ("magic", "S4"), ("version", "u4"), ("byte_order", "u4"),
+    ("detector_count", "u4"), ("string_count", "u4"), ("flags", "u4"),
+    ("string_offsets_at", "u8"), ("string_data_at", "u8"),
+    ("file_count", "u8"), ("total_loc", "u8"),
+    ("shard_index", "u4"), ("shard_count", "u4"),
+    ("file_table_at", "u8"), ("file_table_count", "u8"),
+])
+# set in files of ./main --shard, they hold unfiltered candidates
+FLAG_UNFILTERED = 1
+DETECTOR = np.dtype([
+    ("name", "u4"), ("metric_count", "u4"),
+    ("smell_count", "u8"), ("data_at", "u8"),
+])
+METRIC = np.dtype([("name", "u4"), ("type", "u4")])
+
+
+def _padded(size):
+    return (size + 7) & ~7
+
+
+class Smell_table:
+    """smells of one detector, every column is a numpy array"""
+
+    def __init__(self, name, files, file_ids, lines, metrics):
+        self.name = name
+        self.files = files        # string pool, file_ids index into it
+        self.file_ids = file_ids
+        self.lines = lines
+        self.metrics = metrics    # metric name -> column, in detector order
+
+    def __len__(self):
+        return len(self.lines)
+
+    def file_names(self):
+        return [self.files[file_id] for file_id in self.file_ids]
+
+
+def load_results(path):
+    """returns a dict smell type -> Smell_table, in detector order"""
+    with open(path, "rb") as file:
+        mapping = mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_READ)
+    buffer = memoryview(mapping)
+
+    header = np.frombuffer(buffer, HEADER, count=1)[0]
+    if header["magic"] != MAGIC:
+        raise ValueError(f"{path} is not a smell results file")
+    if header["byte_order"] != BYTE_ORDER:
+        raise ValueError(f"{path} was written on a machine with a different byte order")
+    if header["version"] != FORMAT_VERSION:
+        raise ValueError(f"{path} has format version {header['version']}, expected {FORMAT_VERSION}")
+    if header["flags"] & FLAG_UNFILTERED:
+        raise ValueError(f"{path} holds the unfiltered candidates of shard {header['shard_index']} "
+                         f"of {header['shard_count']}, combine the shards with ./main merge")
+
+    string_count = int(header["string_count"])
+    offsets = np.frombuffer(buffer, np.uint64, count=string_count + 1,
+                            offset=int(header["string_offsets_at"]))
+    data_at = int(header["string_data_at"])
+    strings = [bytes(buffer[data_at + int(offsets[i]):data_at + int(offsets[i + 1])]).decode("utf-8")
+               for i in range(string_count)]
+
+    entries = np.frombuffer(buffer, DETECTOR, count=int(header["detector_count"]),
+                            offset=HEADER.itemsize)
+    results = {}
+    for entry in entries:
+        metric_count = int(entry["metric_count"])
+        smell_count = int(entry["smell_count"])
+        position = int(entry["data_at"])
+        definitions = np.frombuffer(buffer, METRIC, count=metric_count, offset=position)
+        position += _padded(metric_count * METRIC.itemsize)
+
+        column_size = _padded(smell_count * 4)
+        file_ids = np.frombuffer(buffer, np.uint32, count=smell_count, offset=position)
+        lines = np.frombuffer(buffer, np.uint32, count=smell_count, offset=position + column_size)
+        position += 2 * column_size
+
+        metrics = {}
+        for definition in definitions:
+            metrics[strings[definition["name"]]] = np.frombuffer(
+                buffer, METRIC_TYPES[definition["type"]], count=smell_count, offset=position)
+            position += column_size
+
+        name = strings[entry["name"]]
+        results[name] = Smell_table(name, strings, file_ids, lines, metrics)
+    return results
+
+
+def default_results_path():
+    """output.bin next to output.csv if it exists and isn't older, else None"""
+    if not os.path.exists("output.bin"):
+        return None
+    if os.path.exists("output.csv") and os.path.getmtime("output.csv") > os.path.getmtime("output.bin"):
+        return None
+    return "output.bin"
@@ -0,0 +1,790 @@
+#include "analysis.h"
+#include "candidate_cache.h"
+#include "detector_registry.h"
+#include "file_utils.h"
+#include "filter_utils.h"
+#include "prefilter.h"
+#include "smell_list.h"
+#include "work_queue.h"
+#include "tree_visitor.h"
+#include "trace.h"
+#include "tree_allocator.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_SEGMENT_CAPACITY 64
+#define INITIAL_FILE_LOC_CAPACITY 256
+
+extern uint32_t count_LOC(TSNode node);
+
+/*
+range of smells in a shard that was found in one file,
+used to restore the file order when merging the shards
+*/
+typedef struct {
+    size_t file_index;
+    size_t start;
+    size_t count;
+} Shard_segment;
+
+typedef struct {
+    File_LOC *entries;
+    size_t count;
+    size_t capacity;
+} File_LOC_table;
+
+static int recording_file_LOCs;
+static File_LOC_table recorded_table;
+
+typedef struct {
+    Smell_list smells;
+    Shard_segment *segments;
+    size_t segment_count;
+    size_t segment_capacity;
+} Smell_shard;
+
+/*
+files are either taken from a loaded file list (batch mode)
+or popped from the pipeline queue, which owns them and
+frees their content once they are analyzed
+*/
+typedef struct {
+    File_list *files;
+    atomic_size_t next_file;
+    Work_queue *queue;
+    const Tree_visitor *visitor; // hooks of all detectors, shared by the workers
+    // one visitor per detector with perf counters, so every detector is counted on its own
+    Tree_visitor *const *detector_visitors;
+} Work_source;
+
+typedef struct {
+    Work_source *source;
+    Smell_shard *shards; // detector_count shards per worker
+    // bounded mode only, the prefilter of detector i is tops[i * top_stride]
+    Top_candidates *tops;
+    size_t top_stride;
+    void **detector_states; // one visitor state per detector
+    Arena *tree_arena; // NULL unless every file is parsed in an arena (tree_allocator.h)
+    File_LOC_table file_LOCs; // only filled while recording
+    uint32_t total_LOC;
+    int failed;
+} Worker_state;
+
+static int append_file_LOC(File_LOC_table *table, const char *file_name, uint32_t LOC) {
+    if (table->count == table->capacity) {
+        size_t new_capacity = table->capacity ? table->capacity * 2 : INITIAL_FILE_LOC_CAPACITY;
+        File_LOC *entries = realloc(table->entries, new_capacity * sizeof(File_LOC));
+        if (!entries) return -1;
+        table->entries = entries;
+        table->capacity = new_capacity;
+    }
+    table->entries[table->count].file_name = file_name;
+    table->entries[table->count].LOC = LOC;
+    ++table->count;
+    return 0;
+}
+
+void record_file_LOCs(int enabled) {
+    recording_file_LOCs = enabled;
+}
+
+int add_file_LOC(const char *file_name, uint32_t LOC) {
+    return append_file_LOC(&recorded_table, file_name, LOC);
+}
+
+static int compare_file_LOCs(const void *a, const void *b) {
+    const char *name_a = ((const File_LOC *)a)->file_name;
+    const char *name_b = ((const File_LOC *)b)->file_name;
+    return compare_walk_order(name_a, strlen(name_a), name_b, strlen(name_b));
+}
+
+const File_LOC *recorded_file_LOCs(size_t *count) {
+    if (recorded_table.count > 0) {
+        qsort(recorded_table.entries, recorded_table.count, sizeof(File_LOC), compare_file_LOCs);
+    }
+    *count = recorded_table.count;
+    return recorded_table.entries;
+}
+
+void free_recorded_file_LOCs(void) {
+    free(recorded_table.entries);
+    recorded_table = (File_LOC_table){0};
+}
+
+// the workers' tables replace the recorded one, the files of an earlier pass are recorded again
+static int collect_file_LOCs(Worker_state *states, size_t worker_count) {
+    recorded_table.count = 0;
+    int result = 0;
+    for (size_t worker_i = 0; worker_i < worker_count; ++worker_i) {
+        const File_LOC_table *table = &states[worker_i].file_LOCs;
+        for (size_t file_i = 0; file_i < table->count && result == 0; ++file_i) {
+            result = add_file_LOC(table->entries[file_i].file_name, table->entries[file_i].LOC);
+        }
+        free(table->entries);
+    }
+    if (result != 0) fprintf(stderr, "Failed to allocate memory for the LOC of the files.\n");
+    return result;
+}
+
+static void record_file(Worker_state *state, const Matlab_file *file, uint32_t LOC) {
+    if (recording_file_LOCs && append_file_LOC(&state->file_LOCs, file->file_name, LOC) != 0) {
+        fprintf(stderr, "Failed to allocate memory for the LOC of the files.\n");
+        state->failed = 1;
+    }
+}
+
+static int init_shards(Smell_shard *shards) {
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        int list_failed = init_smell_list(&shards[detector_i].smells, detectors[detector_i]->metrics,
+                                          detectors[detector_i]->metric_count) != 0;
+        shards[detector_i].segments = malloc(INITIAL_SEGMENT_CAPACITY * sizeof(Shard_segment));
+        if (list_failed || !shards[detector_i].segments) {
+            fprintf(stderr, "Failed to allocate memory for smell shard.\n");
+            return -1;
+        }
+        shards[detector_i].segment_count = 0;
+        shards[detector_i].segment_capacity = INITIAL_SEGMENT_CAPACITY;
+    }
+    return 0;
+}
+
+static void free_shards(Smell_shard *shards) {
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        free_smell_list(&shards[detector_i].smells);
+        free(shards[detector_i].segments);
+    }
+}
+
+static int add_segment(Smell_shard *shard, size_t file_index, size_t start) {
+    size_t count = shard->smells.count - start;
+    if (count == 0) return 0;
+
+    if (shard->segment_count >= shard->segment_capacity) {
+        size_t new_capacity = shard->segment_capacity * 2;
+        Shard_segment *larger = realloc(shard->segments, new_capacity * sizeof(Shard_segment));
+        if (!larger) {
+            fprintf(stderr, "Failed to allocate memory for shard segments.\n");
+            return -1;
+        }
+        shard->segments = larger;
+        shard->segment_capacity = new_capacity;
+    }
+    Shard_segment *segment = &shard->segments[shard->segment_count++];
+    segment->file_index = file_index;
+    segment->start = start;
+    segment->count = count;
+    return 0;
+}
+
+uint32_t run_detectors(const Tree_visitor *visitor, void *const *detector_states, TSNode root_node,
+                       const Matlab_file *file, Smell_list *const *lists) {
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        detectors[detector_i]->begin_file(detector_states[detector_i], file, lists[detector_i]);
+    }
+
+    // all detectors share one pass over the tree
+    walk_tree(visitor, root_node, detector_states);
+
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        if (detectors[detector_i]->end_file) {
+            detectors[detector_i]->end_file(detector_states[detector_i]);
+        }
+    }
+    return count_LOC(root_node);
+}
+
+// run_detectors with the time of every detector's hooks, begin_file and end_file traced
+static uint32_t run_detectors_traced(const Tree_visitor *visitor, void *const *detector_states, TSNode root_node,
+                                     const Matlab_file *file, Smell_list *const *lists) {
+    uint64_t detector_times[detector_count];
+    uint64_t begin = trace_now();
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        uint64_t detector_begin = trace_now();
+        detectors[detector_i]->begin_file(detector_states[detector_i], file, lists[detector_i]);
+        detector_times[detector_i] = trace_now() - detector_begin;
+    }
+
+    walk_tree_timed(visitor, root_node, detector_states, detector_times);
+
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        if (detectors[detector_i]->end_file) {
+            uint64_t detector_begin = trace_now();
+            detectors[detector_i]->end_file(detector_states[detector_i]);
+            detector_times[detector_i] += trace_now() - detector_begin;
+        }
+    }
+    trace_detect(file->file_name, begin, trace_now(), detector_times);
+    return count_LOC(root_node);
+}
+
+/*
+perf counter mode: every detector walks the tree on its own and
+its begin_file, hooks and end_file are one scope. reading the
+counters around every hook of the shared pass would cost more
+than most hooks.
+*/
+static uint32_t run_detectors_counted(Tree_visitor *const *visitors, void *const *detector_states,
+                                      TSNode root_node, const Matlab_file *file, Smell_list *const *lists) {
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        Scope_start scope;
+        begin_scope(&scope);
+        detectors[detector_i]->begin_file(detector_states[detector_i], file, lists[detector_i]);
+        walk_tree(visitors[detector_i], root_node, &detector_states[detector_i]);
+        if (detectors[detector_i]->end_file) {
+            detectors[detector_i]->end_file(detector_states[detector_i]);
+        }
+        end_scope(&scope, PHASE_DETECT, detectors[detector_i]->name, file->file_name);
+    }
+    return count_LOC(root_node);
+}
+
+// runs all detectors on the file, returns the LOC of the file or -1 if it couldn't be parsed
+static int64_t detect_in_file(TSParser *parser, Matlab_file *file, Worker_state *state,
+                              Smell_list *const *lists) {
+    int scoped = scopes_enabled();
+    Scope_start scope;
+    if (scoped) begin_scope(&scope);
+    TSTree *tree = parse_matlab_file(parser, NULL, file);
+    // a failed parse took its time too, and the scopes around it still nest
+    if (scoped) end_scope(&scope, PHASE_PARSE, NULL, file->file_name);
+    if (!tree) {
+        fprintf(stderr, "Failed to parse file %s.\n", file->file_name);
+        return -1;
+    }
+    TSNode root_node = ts_tree_root_node(tree);
+    if (scoped && perf_counters_enabled()) add_counted_nodes(ts_node_descendant_count(root_node));
+
+    uint32_t LOC;
+    const Work_source *source = state->source;
+    if (source->detector_visitors) {
+        LOC = run_detectors_counted(source->detector_visitors, state->detector_states, root_node, file, lists);
+    } else if (tracing_enabled()) {
+        LOC = run_detectors_traced(source->visitor, state->detector_states, root_node, file, lists);
+    } else {
+        LOC = run_detectors(source->visitor, state->detector_states, root_node, file, lists);
+    }
+    if (!state->tree_arena) ts_tree_delete(tree);
+    return LOC;
+}
+
+/*
+the parser keeps pools of subtrees between files, so in an arena
+every file gets its own parser. neither the parser nor the tree
+is deleted, resetting the arena releases both at once.
+*/
+static int64_t detect_in_arena(Matlab_file *file, Worker_state *state, Smell_list *const *lists) {
+    begin_tree_arena(state->tree_arena);
+    TSParser *parser = ts_parser_new();
+    ts_parser_set_language(parser, tree_sitter_matlab());
+    int64_t LOC = detect_in_file(parser, file, state, lists);
+    end_tree_arena();
+    reset_arena(state->tree_arena);
+    return LOC;
+}
+
+static void analyze_file(TSParser *parser, Matlab_file *file, size_t file_index, Worker_state *state) {
+    // no detector can find a candidate, only the lines are counted
+    if (!file_needs_parse(file)) {
+        uint32_t LOC = count_unparsed_LOC(file);
+        state->total_LOC = state->total_LOC + LOC;
+        record_file(state, file, LOC);
+        return;
+    }
+
+    Smell_list *lists[detector_count];
+    size_t starts[detector_count];
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        lists[detector_i] = &state->shards[detector_i].smells;
+        starts[detector_i] = lists[detector_i]->count;
+    }
+
+    int use_cache = candidate_cache_enabled();
+    int scoped = use_cache && scopes_enabled();
+    Scope_start scope;
+    Cache_key key = {0, 0};
+    uint32_t LOC = 0;
+    int cached = 0;
+    if (use_cache) {
+        if (scoped) begin_scope(&scope);
+        key = candidate_cache_key(file);
+        cached = load_cached_candidates(key, file, lists, &LOC);
+        if (scoped) end_scope(&scope, PHASE_CACHE, "load", file->file_name);
+    }
+
+    if (!cached) {
+        int64_t parsed_LOC = state->tree_arena ? detect_in_arena(file, state, lists)
+                                               : detect_in_file(parser, file, state, lists);
+        if (parsed_LOC < 0) {
+            state->failed = 1;
+            record_file(state, file, 0);
+            return;
+        }
+        LOC = (uint32_t)parsed_LOC;
+        if (use_cache) {
+            if (scoped) begin_scope(&scope);
+            store_cached_candidates(key, LOC, lists, starts);
+            if (scoped) end_scope(&scope, PHASE_CACHE, "store", file->file_name);
+        }
+    }
+    state->total_LOC = state->total_LOC + LOC;
+    record_file(state, file, LOC);
+
+    if (state->tops) {
+        // the shard only holds the candidates of this file, they are offered and dropped
+        for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+            Top_candidates *top = &state->tops[detector_i * state->top_stride];
+            for (size_t smell_i = starts[detector_i]; smell_i < lists[detector_i]->count; ++smell_i) {
+                offer_candidate(top, lists[detector_i], smell_i);
+            }
+            lists[detector_i]->count = starts[detector_i];
+        }
+        return;
+    }
+
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        if (add_segment(&state->shards[detector_i], file_index, starts[detector_i]) != 0) {
+            state->failed = 1;
+        }
+    }
+}
+
+static Matlab_file *take_file(Work_source *source, size_t *file_index) {
+    if (source->queue) {
+        void *item;
+        if (!work_queue_pop(source->queue, &item)) return NULL;
+        Matlab_file *file = item;
+        *file_index = file->index;
+        return file;
+    }
+    *file_index = atomic_fetch_add(&source->next_file, 1);
+    if (*file_index >= source->files->count) return NULL;
+    return source->files->files[*file_index];
+}
+
+static void *run_worker(void *argument) {
+    Worker_state *state = argument;
+    Work_source *source = state->source;
+
+    TSParser *parser = NULL;
+    Arena tree_arena;
+    if (tree_arenas_enabled()) {
+        init_arena(&tree_arena);
+        state->tree_arena = &tree_arena;
+    } else {
+        parser = ts_parser_new();
+        ts_parser_set_language(parser, tree_sitter_matlab());
+    }
+
+    size_t file_index;
+    Matlab_file *file;
+    while ((file = take_file(source, &file_index))) {
+        analyze_file(parser, file, file_index, state);
+        if (source->queue) {
+            // smells only reference the file name, which lives in the path table
+            free_matlab_file(file);
+        }
+    }
+
+    if (state->tree_arena) {
+        free_arena(&tree_arena);
+        state->tree_arena = NULL;
+    } else {
+        ts_parser_delete(parser);
+    }
+    return NULL;
+}
+
+typedef struct {
+    const Shard_segment *segment;
+    const Smell_shard *shard;
+} Segment_ref;
+
+static int compare_segment_refs(const void *a, const void *b) {
+    size_t index_a = ((const Segment_ref *)a)->segment->file_index;
+    size_t index_b = ((const Segment_ref *)b)->segment->file_index;
+    if (index_a < index_b) return -1;
+    if (index_a > index_b) return 1;
+    return 0;
+}
+
+// appends the segments of all workers for one detector in file order
+static int merge_shards(Worker_state *states, size_t worker_count, size_t detector_i, Smell_list *target) {
+    size_t segment_total = 0;
+    for (size_t worker_i = 0; worker_i < worker_count; ++worker_i) {
+        segment_total += states[worker_i].shards[detector_i].segment_count;
+    }
+    if (segment_total == 0) return 0;
+
+    Segment_ref *refs = malloc(segment_total * sizeof(Segment_ref));
+    if (!refs) {
+        fprintf(stderr, "Failed to allocate memory for merging smell shards.\n");
+        return -1;
+    }
+
+    size_t ref_i = 0;
+    for (size_t worker_i = 0; worker_i < worker_count; ++worker_i) {
+        const Smell_shard *shard = &states[worker_i].shards[detector_i];
+        for (size_t segment_i = 0; segment_i < shard->segment_count; ++segment_i) {
+            refs[ref_i].segment = &shard->segments[segment_i];
+            refs[ref_i].shard = shard;
+            ++ref_i;
+        }
+    }
+    // every file is analyzed by exactly one worker, file indices are unique
+    qsort(refs, segment_total, sizeof(Segment_ref), compare_segment_refs);
+
+    int result = 0;
+    for (ref_i = 0; ref_i < segment_total && result == 0; ++ref_i) {
+        const Shard_segment *segment = refs[ref_i].segment;
+        result = append_smells(target, &refs[ref_i].shard->smells, segment->start, segment->count);
+    }
+    free(refs);
+    return result;
+}
+
+Tree_visitor *create_detector_visitor(void) {
+    const Visitor_hook *hook_lists[detector_count];
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        hook_lists[detector_i] = detectors[detector_i]->hooks;
+    }
+    return create_tree_visitor(hook_lists, detector_count);
+}
+
+static void free_single_detector_visitors(Tree_visitor **visitors) {
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        free_tree_visitor(visitors[detector_i]);
+        visitors[detector_i] = NULL;
+    }
+}
+
+static int create_single_detector_visitors(Tree_visitor **visitors) {
+    int result = 0;
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        const Visitor_hook *hook_list = detectors[detector_i]->hooks;
+        visitors[detector_i] = create_tree_visitor(&hook_list, 1);
+        if (!visitors[detector_i]) result = -1;
+    }
+    if (result != 0) free_single_detector_visitors(visitors);
+    return result;
+}
+
+int init_detector_states(void **detector_states) {
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        detector_states[detector_i] = calloc(1, detectors[detector_i]->state_size);
+        if (!detector_states[detector_i]) {
+            fprintf(stderr, "Failed to allocate memory for detector state.\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void free_detector_states(void **detector_states) {
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        if (detector_states[detector_i] && detectors[detector_i]->free_state) {
+            detectors[detector_i]->free_state(detector_states[detector_i]);
+        }
+        free(detector_states[detector_i]);
+    }
+}
+
+/*
+one pass of the bounded mode. known_totals holds the number of
+candidates of every detector once an earlier pass counted them
+and is NULL before, complete is cleared if a prefilter dropped a
+candidate the filter could keep.
+*/
+typedef struct {
+    const size_t *known_totals;
+    int complete;
+} Bounded_pass;
+
+static int init_tops(Top_candidates *tops, size_t thread_count, const size_t *known_totals) {
+    int result = 0;
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        const size_t *known_total = known_totals ? &known_totals[detector_i] : NULL;
+        for (size_t worker_i = 0; worker_i < thread_count; ++worker_i) {
+            if (init_top_candidates(&tops[detector_i * thread_count + worker_i],
+                                    detectors[detector_i], known_total) != 0) {
+                result = -1;
+            }
+        }
+    }
+    return result;
+}
+
+static void free_tops(Top_candidates *tops, size_t thread_count) {
+    for (size_t top_i = 0; top_i < thread_count * detector_count; ++top_i) {
+        free_top_candidates(&tops[top_i]);
+    }
+}
+
+// bounded is NULL unless the candidates are prefiltered while they are found
+static int run_workers(Work_source *source, size_t thread_count, Bounded_pass *bounded,
+                       uint32_t *total_LOC) {
+    Tree_visitor *visitor = create_detector_visitor();
+    if (!visitor) {
+        fprintf(stderr, "Failed to create tree visitor for the detectors.\n");
+        return -1;
+    }
+    source->visitor = visitor;
+
+    Tree_visitor *detector_visitors[detector_count];
+    source->detector_visitors = NULL;
+    if (perf_counters_enabled()) {
+        if (create_single_detector_visitors(detector_visitors) != 0) {
+            fprintf(stderr, "Failed to create tree visitors for the detectors.\n");
+            free_tree_visitor(visitor);
+            return -1;
+        }
+        source->detector_visitors = detector_visitors;
+    }
+
+    Worker_state *states = calloc(thread_count, sizeof(Worker_state));
+    Smell_shard *shards = calloc(thread_count * detector_count, sizeof(Smell_shard));
+    void **detector_states = calloc(thread_count * detector_count, sizeof(void *));
+    Top_candidates *tops = bounded ? calloc(thread_count * detector_count, sizeof(Top_candidates)) : NULL;
+    pthread_t *threads = malloc(thread_count * sizeof(pthread_t));
+    if (!states || !shards || !detector_states || !threads || (bounded && !tops)) {
+        fprintf(stderr, "Failed to allocate memory for analysis workers.\n");
+        free(states);
+        free(shards);
+        free(tops);
+        free(detector_states);
+        free(threads);
+        free_tree_visitor(visitor);
+        if (source->detector_visitors) free_single_detector_visitors(detector_visitors);
+        return -1;
+    }
+
+    int result = 0;
+    if (tops && init_tops(tops, thread_count, bounded->known_totals) != 0) {
+        result = -1;
+    }
+    for (size_t worker_i = 0; worker_i < thread_count; ++worker_i) {
+        states[worker_i].source = source;
+        states[worker_i].shards = &shards[worker_i * detector_count];
+        states[worker_i].tops = tops ? &tops[worker_i] : NULL;
+        states[worker_i].top_stride = thread_count;
+        states[worker_i].detector_states = &detector_states[worker_i * detector_count];
+        if (init_shards(states[worker_i].shards) != 0
+                || init_detector_states(states[worker_i].detector_states) != 0) {
+            result = -1;
+        }
+    }
+
+    if (result == 0) {
+        // the calling thread is worker 0, only additional workers get their own thread
+        size_t started = 1;
+        for (; started < thread_count; ++started) {
+            if (pthread_create(&threads[started], NULL, run_worker, &states[started]) != 0) {
+                fprintf(stderr, "Failed to start analysis thread, continuing with %zu threads.\n", started);
+                break;
+            }
+        }
+        run_worker(&states[0]);
+        for (size_t worker_i = 1; worker_i < started; ++worker_i) {
+            pthread_join(threads[worker_i], NULL);
+        }
+
+        *total_LOC = 0;
+        for (size_t worker_i = 0; worker_i < thread_count; ++worker_i) {
+            *total_LOC += states[worker_i].total_LOC;
+            if (states[worker_i].failed) result = -1;
+        }
+        if (recording_file_LOCs && collect_file_LOCs(states, thread_count) != 0) result = -1;
+
+        for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+            if (tops) {
+                int merged = merge_top_candidates(&tops[detector_i * thread_count], thread_count,
+                                                  detectors[detector_i]);
+                if (merged < 0) result = -1;
+                if (merged == 0) bounded->complete = 0;
+            } else if (merge_shards(states, thread_count, detector_i, detectors[detector_i]->smell_list) != 0) {
+                result = -1;
+            }
+        }
+    }
+
+    for (size_t worker_i = 0; worker_i < thread_count; ++worker_i) {
+        free_shards(states[worker_i].shards);
+        free_detector_states(states[worker_i].detector_states);
+    }
+    if (tops) {
+        free_tops(tops, thread_count);
+        free(tops);
+    }
+    free(shards);
+    free(detector_states);
+    free(states);
+    free(threads);
+    free_tree_visitor(visitor);
+    if (source->detector_visitors) free_single_detector_visitors(detector_visitors);
+    return result;
+}
+
+// the next pass knows the totals, so its prefilters keep exactly the share and it is complete
+static void prepare_second_pass(Bounded_pass *pass, size_t *known_totals) {
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        known_totals[detector_i] = detectors[detector_i]->candidate_count;
+        detectors[detector_i]->smell_list->count = 0;
+    }
+    pass->known_totals = known_totals;
+    pass->complete = 1;
+}
+
+int analyze_files(File_list *list, size_t thread_count, int bounded, uint32_t *total_LOC) {
+    if (thread_count == 0) thread_count = 1;
+    if (thread_count > list->count && list->count > 0) thread_count = list->count;
+
+    Work_source source = { .files = list, .queue = NULL, .visitor = NULL };
+    atomic_init(&source.next_file, 0);
+    if (!bounded) return run_workers(&source, thread_count, NULL, total_LOC);
+
+    Bounded_pass pass = { .known_totals = NULL, .complete = 1 };
+    int result = run_workers(&source, thread_count, &pass, total_LOC);
+    if (result != 0 || pass.complete) return result;
+
+    size_t known_totals[detector_count];
+    prepare_second_pass(&pass, known_totals);
+    atomic_store(&source.next_file, 0);
+    return run_workers(&source, thread_count, &pass, total_LOC);
+}
+
+typedef struct {
+    const char *path;
+    const Walk_options *walk;
+    Work_queue *path_queue;
+} Discovery_state;
+
+typedef struct {
+    Work_queue *path_queue;
+    Work_queue *file_queue;
+    size_t file_count;
+} Reader_state;
+
+static int queue_path(const char *file_path, void *context) {
+    Work_queue *path_queue = context;
+    size_t length = strlen(file_path);
+    char *copy = malloc(length + 1);
+    if (!copy) {
+        fprintf(stderr, "Failed to allocate memory for path %s.\n", file_path);
+        return -1;
+    }
+    memcpy(copy, file_path, length + 1);
+    if (work_queue_push(path_queue, copy) != 0) {
+        free(copy);
+        return -1;
+    }
+    return 0;
+}
+
+static void *run_discovery(void *argument) {
+    Discovery_state *state = argument;
+    int scoped = scopes_enabled();
+    Scope_start scope;
+    if (scoped) begin_scope(&scope);
+    walk_matlab_files(state->path, state->walk, queue_path, state->path_queue);
+    if (scoped) end_scope(&scope, PHASE_DISCOVERY, NULL, NULL);
+    work_queue_close(state->path_queue);
+    return NULL;
+}
+
+static void *run_reader(void *argument) {
+    Reader_state *state = argument;
+    void *item;
+    while (work_queue_pop(state->path_queue, &item)) {
+        char *file_path = item;
+        Matlab_file *file = read_file(file_path);
+        if (!file) {
+            fprintf(stderr, "Failed to read file %s.\n", file_path);
+        } else {
+            // a single reader thread, so the index follows discovery order
+            file->index = state->file_count++;
+            if (work_queue_push(state->file_queue, file) != 0) {
+                free_matlab_file(file);
+            }
+        }
+        free(file_path);
+    }
+    work_queue_close(state->file_queue);
+    return NULL;
+}
+
+static int run_pipeline(const char *path, const Walk_options *walk, size_t thread_count, size_t queue_capacity,
+                        Bounded_pass *bounded, size_t *file_count, uint32_t *total_LOC) {
+    Work_queue path_queue;
+    Work_queue file_queue;
+    if (init_work_queue(&path_queue, queue_capacity) != 0) {
+        fprintf(stderr, "Failed to allocate memory for path queue.\n");
+        return -1;
+    }
+    if (init_work_queue(&file_queue, queue_capacity) != 0) {
+        fprintf(stderr, "Failed to allocate memory for file queue.\n");
+        free_work_queue(&path_queue);
+        return -1;
+    }
+
+    Discovery_state discovery = { .path = path, .walk = walk, .path_queue = &path_queue };
+    Reader_state reader = { .path_queue = &path_queue, .file_queue = &file_queue, .file_count = 0 };
+    pthread_t discovery_thread;
+    pthread_t reader_thread;
+
+    if (pthread_create(&discovery_thread, NULL, run_discovery, &discovery) != 0) {
+        fprintf(stderr, "Failed to start discovery thread.\n");
+        free_work_queue(&file_queue);
+        free_work_queue(&path_queue);
+        return -1;
+    }
+    if (pthread_create(&reader_thread, NULL, run_reader, &reader) != 0) {
+        fprintf(stderr, "Failed to start reader thread.\n");
+        work_queue_close(&path_queue);
+        pthread_join(discovery_thread, NULL);
+        free_work_queue(&file_queue);
+        free_work_queue(&path_queue);
+        return -1;
+    }
+
+    Work_source source = { .files = NULL, .queue = &file_queue, .visitor = NULL };
+    atomic_init(&source.next_file, 0);
+    int result = run_workers(&source, thread_count, bounded, total_LOC);
+
+    // unblock the earlier stages if the workers stopped early
+    work_queue_close(&file_queue);
+    work_queue_close(&path_queue);
+    pthread_join(reader_thread, NULL);
+    pthread_join(discovery_thread, NULL);
+
+    // files that were read but never analyzed
+    void *item;
+    while (work_queue_pop(&file_queue, &item)) {
+        free_matlab_file(item);
+    }
+    while (work_queue_pop(&path_queue, &item)) {
+        free(item);
+    }
+
+    *file_count = reader.file_count;
+    free_work_queue(&file_queue);
+    free_work_queue(&path_queue);
+    return result;
+}
+
+int analyze_path_pipelined(const char *path, const Walk_options *walk, size_t thread_count, size_t queue_capacity,
+                           int bounded, size_t *file_count, uint32_t *total_LOC) {
+    if (thread_count == 0) thread_count = 1;
+    if (!bounded) return run_pipeline(path, walk, thread_count, queue_capacity, NULL, file_count, total_LOC);
+
+    Bounded_pass pass = { .known_totals = NULL, .complete = 1 };
+    int result = run_pipeline(path, walk, thread_count, queue_capacity, &pass, file_count, total_LOC);
+    if (result != 0 || pass.complete) return result;
+
+    // the files were freed after the first pass, they are discovered and read again
+    size_t known_totals[detector_count];
+    prepare_second_pass(&pass, known_totals);
+    return run_pipeline(path, walk, thread_count, queue_capacity, &pass, file_count, total_LOC);
+}
@@ -0,0 +1,67 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "directory_walker.h"
+#include "matlab_file_list.h"
+#include "smell_list.h"
+#include "tree_visitor.h"
+
+/*
+runs all detectors on all files of the list using thread_count
+worker threads. every worker owns its own parser and its own
+smell list shard per detector, the shards are merged into
+detectors[i]->smell_list in file list order, so the result is
+the same as a single threaded run.
+smell lists of the detectors have to be initialized before.
+in bounded mode the candidates of every file are passed to a
+prefilter per worker and detector (Top_candidates, filter_utils.h)
+instead of the shards, so the smell lists only grow with the
+filtered result. the lists are no longer in file order and
+candidate_count of every detector is set to the number of all
+candidates. if a prefilter dropped a candidate that could be
+part of a percentage share, the files are analyzed once more
+with the totals known from the first pass.
+*/
+int analyze_files(File_list *list, size_t thread_count, int bounded, uint32_t *total_LOC);
+
+/*
+streaming variant: a discovery thread walks the path as
+configured by walk (directory_walker.h), a reader thread
+loads the files and the workers parse them. the stages
+are connected by queues of queue_capacity entries, so at most
+about 2 * queue_capacity + thread_count files are held in memory.
+a file's content is freed as soon as all detectors ran on it.
+*/
+int analyze_path_pipelined(const char *path, const Walk_options *walk, size_t thread_count, size_t queue_capacity,
+                           int bounded, size_t *file_count, uint32_t *total_LOC);
+
+/*
+while recording, every run of the workers replaces the recorded
+table with the LOC of each file it was given, 0 for files that
+couldn't be parsed (--save-baseline, baseline.h).
+recorded_file_LOCs returns the table in walk order
+(directory_walker.h), add_file_LOC appends to it and returns -1
+if it couldn't be enlarged.
+*/
+void record_file_LOCs(int enabled);
+int add_file_LOC(const char *file_name, uint32_t LOC);
+const File_LOC *recorded_file_LOCs(size_t *count);
+void free_recorded_file_LOCs(void);
+
+/*
+building blocks for callers that keep the syntax trees
+themselves (watch.h): one visitor over the hooks of all
+detectors, one state per detector (detector_count entries)
+and a single pass of all detectors over a parsed file.
+run_detectors appends to lists[i] and returns the LOC.
+*/
+Tree_visitor *create_detector_visitor(void);
+int init_detector_states(void **detector_states);
+void free_detector_states(void **detector_states);
+uint32_t run_detectors(const Tree_visitor *visitor, void *const *detector_states, TSNode root_node,
+                       const Matlab_file *file, Smell_list *const *lists);
+
+#endif
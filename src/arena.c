@@ -0,0 +1,85 @@
+#include "arena.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT _Alignof(max_align_t)
+
+struct Arena_block {
+    Arena_block *next;
+    size_t used;
+    size_t capacity;
+    _Alignas(max_align_t) char data[];
+};
+
+static Arena_block *new_block(size_t min_size, Arena_block *next) {
+    size_t capacity = min_size > ARENA_BLOCK_SIZE ? min_size : ARENA_BLOCK_SIZE;
+    Arena_block *block = malloc(sizeof(Arena_block) + capacity);
+    if (!block) return NULL;
+    block->next = next;
+    block->used = 0;
+    block->capacity = capacity;
+    return block;
+}
+
+void init_arena(Arena *arena) {
+    arena->first = NULL;
+    arena->current = NULL;
+}
+
+void free_arena(Arena *arena) {
+    while (arena->first) {
+        Arena_block *next = arena->first->next;
+        free(arena->first);
+        arena->first = next;
+    }
+    arena->current = NULL;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    Arena_block *block = arena->current;
+    while (block && block->capacity - block->used < size) {
+        // blocks after current are left over from before the last reset
+        block = block->next;
+        if (block) block->used = 0;
+    }
+    if (!block) {
+        block = new_block(size, arena->current ? arena->current->next : NULL);
+        if (!block) {
+            fprintf(stderr, "Failed to allocate memory for arena block.\n");
+            return NULL;
+        }
+        if (arena->current) {
+            arena->current->next = block;
+        } else {
+            arena->first = block;
+        }
+    }
+    arena->current = block;
+
+    void *allocation = block->data + block->used;
+    block->used += size;
+    return allocation;
+}
+
+void *arena_grow(Arena *arena, const void *items, size_t old_size, size_t new_size) {
+    void *larger = arena_alloc(arena, new_size);
+    if (larger && old_size > 0) memcpy(larger, items, old_size);
+    return larger;
+}
+
+void reset_arena(Arena *arena) {
+    arena->current = arena->first;
+    if (arena->first) arena->first->used = 0;
+}
+
+size_t arena_block_count(const Arena *arena) {
+    size_t count = 0;
+    for (const Arena_block *block = arena->first; block; block = block->next) ++count;
+    return count;
+}
@@ -0,0 +1,32 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+bump allocator for short lived data, e.g. everything a
+detector needs while it visits one file. allocations are
+never freed one by one, reset_arena releases all of them
+at once but keeps the blocks for the next file.
+not synchronized, every worker owns its own arena.
+*/
+
+typedef struct Arena_block Arena_block;
+
+typedef struct {
+    Arena_block *first;
+    Arena_block *current;
+} Arena;
+
+void init_arena(Arena *arena);
+void free_arena(Arena *arena);
+
+// returns NULL if no memory could be allocated
+void *arena_alloc(Arena *arena, size_t size);
+// copies old_size bytes of items into a new allocation of new_size bytes
+void *arena_grow(Arena *arena, const void *items, size_t old_size, size_t new_size);
+void reset_arena(Arena *arena);
+// blocks allocated so far, they are kept by reset_arena
+size_t arena_block_count(const Arena *arena);
+
+#endif
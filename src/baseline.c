@@ -0,0 +1,319 @@
+#include "baseline.h"
+#include "analysis.h"
+#include "binary_report.h"
+#include "detector_registry.h"
+#include "file_utils.h"
+#include "hash.h"
+#include "path_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CHANGED_CAPACITY 64
+
+/*
+the changed paths, normalized (normalize_path) so "./a//b.m" and
+"a/b.m" are the same file, in an open addressing hash set
+*/
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t capacity; // power of 2, at most half full
+} Changed_files;
+
+// drops empty and "." components, normalized may be path itself, the result is never longer
+static size_t normalize_path(const char *path, size_t length, char *normalized) {
+    size_t normalized_length = 0;
+    size_t position = 0;
+    if (length > 0 && path[0] == '/') normalized[normalized_length++] = '/';
+    while (position < length) {
+        size_t end = position;
+        while (end < length && path[end] != '/') ++end;
+        size_t component_length = end - position;
+        int skipped = component_length == 0 || (component_length == 1 && path[position] == '.');
+        if (!skipped) {
+            if (normalized_length > 0 && normalized[normalized_length - 1] != '/') {
+                normalized[normalized_length++] = '/';
+            }
+            memmove(normalized + normalized_length, path + position, component_length);
+            normalized_length += component_length;
+        }
+        position = end + 1;
+    }
+    return normalized_length;
+}
+
+static size_t find_slot(const Changed_files *changed, const char *path, size_t length) {
+    size_t slot = hash_bytes(path, length, 0) & (changed->capacity - 1);
+    while (changed->paths[slot]) {
+        if (strlen(changed->paths[slot]) == length && memcmp(changed->paths[slot], path, length) == 0) break;
+        slot = (slot + 1) & (changed->capacity - 1);
+    }
+    return slot;
+}
+
+static int grow_changed_files(Changed_files *changed) {
+    size_t new_capacity = changed->capacity ? changed->capacity * 2 : INITIAL_CHANGED_CAPACITY;
+    Changed_files larger = { calloc(new_capacity, sizeof(char *)), changed->count, new_capacity };
+    if (!larger.paths) return -1;
+    for (size_t slot = 0; slot < changed->capacity; ++slot) {
+        char *path = changed->paths[slot];
+        if (path) larger.paths[find_slot(&larger, path, strlen(path))] = path;
+    }
+    free(changed->paths);
+    *changed = larger;
+    return 0;
+}
+
+static int add_changed_file(Changed_files *changed, const char *path, size_t length) {
+    if ((changed->count + 1) * 2 > changed->capacity && grow_changed_files(changed) != 0) return -1;
+    size_t slot = find_slot(changed, path, length);
+    if (changed->paths[slot]) return 0;
+    char *copy = malloc(length + 1);
+    if (!copy) return -1;
+    memcpy(copy, path, length);
+    copy[length] = '\0';
+    changed->paths[slot] = copy;
+    ++changed->count;
+    return 0;
+}
+
+static void free_changed_files(Changed_files *changed) {
+    for (size_t slot = 0; slot < changed->capacity; ++slot) {
+        free(changed->paths[slot]);
+    }
+    free(changed->paths);
+}
+
+// buffer has to hold length bytes
+static int is_changed(const Changed_files *changed, const char *path, size_t length, char *buffer) {
+    if (changed->count == 0) return 0;
+    size_t normalized_length = normalize_path(path, length, buffer);
+    return changed->paths[find_slot(changed, buffer, normalized_length)] != NULL;
+}
+
+static int read_changed_files(const char *list_path, Changed_files *changed) {
+    FILE *file = strcmp(list_path, "-") == 0 ? stdin : fopen(list_path, "r");
+    if (!file) {
+        perror(list_path);
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t line_length;
+    int result = 0;
+    while (result == 0 && (line_length = getline(&line, &line_capacity, file)) >= 0) {
+        size_t length = (size_t)line_length;
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) --length;
+        // only .m files can have candidates
+        if (length < 2 || memcmp(line + length - 2, ".m", 2) != 0) continue;
+        length = normalize_path(line, length, line);
+        if (add_changed_file(changed, line, length) != 0) {
+            fprintf(stderr, "Failed to allocate memory for the changed files.\n");
+            result = -1;
+        }
+    }
+    if (result == 0 && ferror(file)) {
+        fprintf(stderr, "Failed to read %s.\n", list_path);
+        result = -1;
+    }
+    free(line);
+    if (file != stdin) fclose(file);
+    return result;
+}
+
+typedef struct {
+    const Changed_files *changed;
+    char *buffer;
+    size_t capacity;
+} Selection;
+
+static int select_changed_file(const char *file_path, void *context) {
+    Selection *selection = context;
+    size_t length = strlen(file_path);
+    if (length + 1 > selection->capacity) {
+        char *larger = realloc(selection->buffer, length + 1);
+        // not selecting the file would drop its candidates, read_file reports the missing memory instead
+        if (!larger) return 1;
+        selection->buffer = larger;
+        selection->capacity = length + 1;
+    }
+    return is_changed(selection->changed, file_path, length, selection->buffer);
+}
+
+typedef struct {
+    Binary_results results;
+    const char **interned; // path table entry of every string id, NULL until it is used
+    unsigned char *replaced; // 1 for the string ids of changed files
+} Baseline;
+
+static int open_baseline(const char *baseline_path, const Changed_files *changed, Baseline *baseline) {
+    if (open_binary_results(baseline_path, &baseline->results) != 0) return -1;
+
+    const Binary_run_info *info = &baseline->results.info;
+    if (!(info->flags & BINARY_FLAG_UNFILTERED) || info->shard_count != 1) {
+        fprintf(stderr, "%s is not a baseline, it has to hold the unfiltered candidates of a whole run"
+                        " (--save-baseline).\n", baseline_path);
+        return -1;
+    }
+    if (info->file_LOC_count != info->file_count) {
+        fprintf(stderr, "%s doesn't list the LOC of all its %llu files, save the baseline again.\n",
+                baseline_path, (unsigned long long)info->file_count);
+        return -1;
+    }
+
+    uint32_t string_count = baseline->results.string_count;
+    baseline->interned = calloc(string_count ? string_count : 1, sizeof(const char *));
+    baseline->replaced = calloc(string_count ? string_count : 1, 1);
+    int failed = !baseline->interned || !baseline->replaced;
+    char *buffer = NULL;
+    size_t capacity = 0;
+    for (uint32_t string_i = 0; !failed && string_i < string_count; ++string_i) {
+        size_t length;
+        const char *string = binary_string(&baseline->results, string_i, &length);
+        if (length + 1 > capacity) {
+            char *larger = realloc(buffer, length + 1);
+            failed = !larger;
+            if (failed) break;
+            buffer = larger;
+            capacity = length + 1;
+        }
+        baseline->replaced[string_i] = (unsigned char)is_changed(changed, string, length, buffer);
+    }
+    free(buffer);
+    if (failed) {
+        fprintf(stderr, "Failed to allocate memory for %s.\n", baseline_path);
+        return -1;
+    }
+    return 0;
+}
+
+static void close_baseline(Baseline *baseline) {
+    if (baseline->results.data) close_binary_results(&baseline->results);
+    free(baseline->interned);
+    free(baseline->replaced);
+}
+
+/*
+merges the candidates of the unchanged baseline files with the ones
+of the analyzed files, which are already in the list, in walk order
+*/
+static int splice_detector(Baseline *baseline, Smell_detector *detector) {
+    Binary_detector found;
+    uint32_t *metric_columns = malloc((detector->metric_count ? detector->metric_count : 1) * sizeof(uint32_t));
+    Smell_list fresh;
+    if (!metric_columns || init_smell_list(&fresh, detector->metrics, detector->metric_count) != 0) {
+        fprintf(stderr, "Failed to allocate memory for the baseline of %s.\n", detector->name);
+        free(metric_columns);
+        return -1;
+    }
+
+    Smell_list *list = detector->smell_list;
+    int result = find_binary_detector(&baseline->results, detector, &found, metric_columns);
+    if (result == 0) result = copy_smell_list(&fresh, list);
+    list->count = 0;
+
+    size_t fresh_i = 0;
+    uint64_t smell_i = 0;
+    while (result == 0 && smell_i < found.smell_count) {
+        uint32_t file = found.files[smell_i];
+        uint64_t file_end = smell_i + 1;
+        while (file_end < found.smell_count && found.files[file_end] == file) ++file_end;
+        if (baseline->replaced[file]) {
+            smell_i = file_end;
+            continue;
+        }
+
+        size_t length;
+        const char *name = binary_string(&baseline->results, file, &length);
+        while (result == 0 && fresh_i < fresh.count) {
+            const char *fresh_name = fresh.locations[fresh_i].file_name;
+            if (compare_walk_order(fresh_name, strlen(fresh_name), name, length) >= 0) break;
+            result = append_smells(list, &fresh, fresh_i++, 1);
+        }
+
+        if (result == 0 && !baseline->interned[file]) {
+            baseline->interned[file] = path_table_add_length(name, length);
+            if (!baseline->interned[file]) result = -1;
+        }
+        for (; result == 0 && smell_i < file_end; ++smell_i) {
+            if (add_binary_smell(list, &found, metric_columns, (size_t)smell_i, baseline->interned[file])
+                    == SMELL_NOT_ADDED) {
+                result = -1;
+            }
+        }
+    }
+    if (result == 0 && fresh_i < fresh.count) {
+        result = append_smells(list, &fresh, fresh_i, fresh.count - fresh_i);
+    }
+    if (result != 0) {
+        fprintf(stderr, "Failed to merge the baseline of %s.\n", detector->name);
+    }
+    // percentage steps refer to all candidates
+    detector->candidate_count = list->count;
+
+    free_smell_list(&fresh);
+    free(metric_columns);
+    return result;
+}
+
+/*
+adds the files of the baseline that weren't replaced to the totals
+and to the recorded file LOCs (analysis.h), so a baseline saved
+from the result describes the whole run again
+*/
+static int add_kept_files(Baseline *baseline, size_t *file_count, uint32_t *total_LOC, int recording) {
+    const uint32_t *file_table = binary_file_table(&baseline->results);
+    for (uint64_t file_i = 0; file_i < baseline->results.info.file_LOC_count; ++file_i) {
+        uint32_t file = file_table[2 * file_i];
+        if (baseline->replaced[file]) continue;
+        ++*file_count;
+        *total_LOC += file_table[2 * file_i + 1];
+        if (!recording) continue;
+
+        if (!baseline->interned[file]) {
+            size_t length;
+            const char *name = binary_string(&baseline->results, file, &length);
+            baseline->interned[file] = path_table_add_length(name, length);
+            if (!baseline->interned[file]) return -1;
+        }
+        if (add_file_LOC(baseline->interned[file], file_table[2 * file_i + 1]) != 0) return -1;
+    }
+    return 0;
+}
+
+int analyze_changed_files(const char *path, const Walk_options *options, const char *changed_list_path,
+                          const char *baseline_path, size_t thread_count, int recording, size_t *changed_count,
+                          size_t *file_count, uint32_t *total_LOC) {
+    Changed_files changed = { NULL, 0, 0 };
+    Baseline baseline = { 0 };
+    if (read_changed_files(changed_list_path, &changed) != 0
+            || open_baseline(baseline_path, &changed, &baseline) != 0) {
+        close_baseline(&baseline);
+        free_changed_files(&changed);
+        return -1;
+    }
+
+    File_list file_list;
+    init_file_list(&file_list);
+    Selection selection = { &changed, NULL, 0 };
+    int result = load_selected_files(path, options, select_changed_file, &selection, &file_list) == 0 ? 0 : 1;
+    free(selection.buffer);
+    *changed_count = file_list.count;
+    *file_count = file_list.count;
+    if (analyze_files(&file_list, thread_count, 0, total_LOC) != 0) result = 1;
+    free_file_list(&file_list);
+    if (add_kept_files(&baseline, file_count, total_LOC, recording) != 0) {
+        fprintf(stderr, "Failed to allocate memory for the files of %s.\n", baseline_path);
+        result = -1;
+    }
+
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        if (splice_detector(&baseline, detectors[detector_i]) != 0) result = -1;
+    }
+    close_baseline(&baseline);
+    free_changed_files(&changed);
+    return result;
+}
@@ -0,0 +1,36 @@
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "directory_walker.h"
+
+/*
+changed files mode (--changed, --baseline). a baseline is the
+binary file (binary_report.h) written with --save-baseline, it
+holds the unfiltered candidates of every file of a run. only the
+changed files are analyzed, their candidates replace the ones of
+the baseline and the filters run over all of them, so the result
+equals a full run as long as no other file changed since the
+baseline was saved.
+*/
+
+/*
+the changed list has one path per line ("-" reads stdin), relative
+to the working directory like git diff --name-only prints them.
+the path is walked as configured by options (directory_walker.h)
+and the visited files that are on the list are analyzed, listed
+files that don't exist anymore only lose their candidates.
+changed_count is the number of analyzed files, file_count and
+total_LOC count them together with the unchanged files of the
+baseline, like a full run. while the file LOCs are recorded
+(recording, analysis.h) the unchanged files are recorded too.
+returns -1 if the list or the baseline can't be used and 1 if
+some of the changed files couldn't be analyzed.
+*/
+int analyze_changed_files(const char *path, const Walk_options *options, const char *changed_list_path,
+                          const char *baseline_path, size_t thread_count, int recording, size_t *changed_count,
+                          size_t *file_count, uint32_t *total_LOC);
+
+#endif
@@ -0,0 +1,447 @@
+#include "binary_report.h"
+#include "report_writer.h"
+#include "detector_registry.h"
+#include "hash.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BINARY_MAGIC "MSDR"
+// increase when the layout changes
+#define BINARY_FORMAT_VERSION 3
+#define BINARY_BYTE_ORDER 0x01020304u
+#define HEADER_SIZE 80
+#define DETECTOR_ENTRY_SIZE 24
+#define INITIAL_STRING_CAPACITY 64
+
+/*
+all strings of the file, paths are deduplicated by content
+(the same file can have several path table entries)
+*/
+typedef struct {
+    const char **strings;
+    size_t count;
+    size_t capacity;
+    uint32_t *slots; // string id + 1, 0 is empty
+    size_t slot_capacity;
+} String_pool;
+
+static int grow_slots(String_pool *pool) {
+    size_t new_capacity = pool->slot_capacity ? pool->slot_capacity * 2 : 2 * INITIAL_STRING_CAPACITY;
+    uint32_t *slots = calloc(new_capacity, sizeof(uint32_t));
+    if (!slots) return -1;
+    for (size_t string_i = 0; string_i < pool->count; ++string_i) {
+        const char *string = pool->strings[string_i];
+        size_t slot = hash_bytes(string, strlen(string), 0) & (new_capacity - 1);
+        while (slots[slot]) slot = (slot + 1) & (new_capacity - 1);
+        slots[slot] = (uint32_t)string_i + 1;
+    }
+    free(pool->slots);
+    pool->slots = slots;
+    pool->slot_capacity = new_capacity;
+    return 0;
+}
+
+// returns the id of the string, adds it if it isn't part of the pool yet, UINT32_MAX on errors
+static uint32_t intern_string(String_pool *pool, const char *string) {
+    if ((pool->count + 1) * 2 > pool->slot_capacity && grow_slots(pool) != 0) return UINT32_MAX;
+
+    size_t length = strlen(string);
+    size_t slot = hash_bytes(string, length, 0) & (pool->slot_capacity - 1);
+    while (pool->slots[slot]) {
+        uint32_t string_id = pool->slots[slot] - 1;
+        if (strcmp(pool->strings[string_id], string) == 0) return string_id;
+        slot = (slot + 1) & (pool->slot_capacity - 1);
+    }
+
+    if (pool->count >= pool->capacity) {
+        size_t new_capacity = pool->capacity ? pool->capacity * 2 : INITIAL_STRING_CAPACITY;
+        const char **larger = realloc(pool->strings, new_capacity * sizeof(const char *));
+        if (!larger) return UINT32_MAX;
+        pool->strings = larger;
+        pool->capacity = new_capacity;
+    }
+    uint32_t string_id = (uint32_t)pool->count++;
+    pool->strings[string_id] = string;
+    pool->slots[slot] = string_id + 1;
+    return string_id;
+}
+
+static uint64_t padded(uint64_t size) {
+    return (size + 7) & ~(uint64_t)7;
+}
+
+static void append_u32(Report_buffer *buffer, uint32_t value) {
+    append_bytes(buffer, (const char *)&value, sizeof(value));
+}
+
+static void append_u64(Report_buffer *buffer, uint64_t value) {
+    append_bytes(buffer, (const char *)&value, sizeof(value));
+}
+
+static void append_padding(Report_buffer *buffer, uint64_t size) {
+    static const char zeros[8] = {0};
+    append_bytes(buffer, zeros, (size_t)(padded(size) - size));
+}
+
+static uint64_t detector_data_size(const Smell_detector *detector) {
+    uint64_t column_size = padded((uint64_t)detector->smell_list->count * sizeof(uint32_t));
+    return padded((uint64_t)detector->metric_count * 2 * sizeof(uint32_t))
+         + column_size * (2 + detector->metric_count);
+}
+
+// string ids of the detector and metric names, and of the file of every smell
+typedef struct {
+    uint32_t name;
+    uint32_t *metric_names;
+    uint32_t *files;
+} Detector_strings;
+
+// string ids of the file table, file_ids has one entry per file of info
+static int collect_file_table_strings(String_pool *pool, const Binary_run_info *info, uint32_t *file_ids) {
+    for (uint64_t file_i = 0; file_i < info->file_LOC_count; ++file_i) {
+        file_ids[file_i] = intern_string(pool, info->file_LOCs[file_i].file_name);
+        if (file_ids[file_i] == UINT32_MAX) return -1;
+    }
+    return 0;
+}
+
+static int collect_strings(String_pool *pool, Detector_strings *strings) {
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        const Smell_detector *detector = detectors[detector_i];
+        const Smell_list *list = detector->smell_list;
+        Detector_strings *entry = &strings[detector_i];
+        entry->metric_names = malloc((detector->metric_count ? detector->metric_count : 1) * sizeof(uint32_t));
+        entry->files = malloc((list->count ? list->count : 1) * sizeof(uint32_t));
+        if (!entry->metric_names || !entry->files) return -1;
+
+        entry->name = intern_string(pool, detector->name);
+        if (entry->name == UINT32_MAX) return -1;
+        for (size_t metric_i = 0; metric_i < detector->metric_count; ++metric_i) {
+            entry->metric_names[metric_i] = intern_string(pool, detector->metrics[metric_i].name);
+            if (entry->metric_names[metric_i] == UINT32_MAX) return -1;
+        }
+        for (size_t smell_i = 0; smell_i < list->count; ++smell_i) {
+            entry->files[smell_i] = intern_string(pool, list->locations[smell_i].file_name);
+            if (entry->files[smell_i] == UINT32_MAX) return -1;
+        }
+    }
+    return 0;
+}
+
+static void write_detector_data(Report_buffer *buffer, const Smell_detector *detector,
+                                const Detector_strings *strings) {
+    const Smell_list *list = detector->smell_list;
+    for (size_t metric_i = 0; metric_i < detector->metric_count; ++metric_i) {
+        append_u32(buffer, strings->metric_names[metric_i]);
+        append_u32(buffer, detector->metrics[metric_i].is_float ? 1 : 0);
+    }
+    append_padding(buffer, (uint64_t)detector->metric_count * 2 * sizeof(uint32_t));
+
+    uint64_t column_size = (uint64_t)list->count * sizeof(uint32_t);
+    append_bytes(buffer, (const char *)strings->files, (size_t)column_size);
+    append_padding(buffer, column_size);
+    for (size_t smell_i = 0; smell_i < list->count; ++smell_i) {
+        append_u32(buffer, list->locations[smell_i].line);
+    }
+    append_padding(buffer, column_size);
+    for (size_t metric_i = 0; metric_i < list->metric_count; ++metric_i) {
+        append_bytes(buffer, (const char *)list->columns[metric_i], (size_t)column_size);
+        append_padding(buffer, column_size);
+    }
+}
+
+static int write_binary(FILE *file, const Binary_run_info *info, const String_pool *pool,
+                        const Detector_strings *strings, const uint32_t *file_ids) {
+    Report_buffer buffer;
+    init_report_buffer(&buffer, file);
+
+    uint64_t position = HEADER_SIZE + (uint64_t)detector_count * DETECTOR_ENTRY_SIZE;
+    uint64_t data_at[detector_count];
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        data_at[detector_i] = position;
+        position += detector_data_size(detectors[detector_i]);
+    }
+    uint64_t file_table_at = position;
+    position += info->file_LOC_count * 2 * sizeof(uint32_t);
+    uint64_t string_offsets_at = position;
+    uint64_t string_data_at = string_offsets_at + ((uint64_t)pool->count + 1) * sizeof(uint64_t);
+
+    append_bytes(&buffer, BINARY_MAGIC, 4);
+    append_u32(&buffer, BINARY_FORMAT_VERSION);
+    append_u32(&buffer, BINARY_BYTE_ORDER);
+    append_u32(&buffer, (uint32_t)detector_count);
+    append_u32(&buffer, (uint32_t)pool->count);
+    append_u32(&buffer, info->flags);
+    append_u64(&buffer, string_offsets_at);
+    append_u64(&buffer, string_data_at);
+    append_u64(&buffer, info->file_count);
+    append_u64(&buffer, info->total_LOC);
+    append_u32(&buffer, info->shard_index);
+    append_u32(&buffer, info->shard_count);
+    append_u64(&buffer, file_table_at);
+    append_u64(&buffer, info->file_LOC_count);
+
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        append_u32(&buffer, strings[detector_i].name);
+        append_u32(&buffer, (uint32_t)detectors[detector_i]->metric_count);
+        append_u64(&buffer, detectors[detector_i]->smell_list->count);
+        append_u64(&buffer, data_at[detector_i]);
+    }
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        write_detector_data(&buffer, detectors[detector_i], &strings[detector_i]);
+    }
+    for (uint64_t file_i = 0; file_i < info->file_LOC_count; ++file_i) {
+        append_u32(&buffer, file_ids[file_i]);
+        append_u32(&buffer, info->file_LOCs[file_i].LOC);
+    }
+
+    uint64_t string_offset = 0;
+    for (size_t string_i = 0; string_i < pool->count; ++string_i) {
+        append_u64(&buffer, string_offset);
+        string_offset += strlen(pool->strings[string_i]);
+    }
+    append_u64(&buffer, string_offset);
+    for (size_t string_i = 0; string_i < pool->count; ++string_i) {
+        append_text(&buffer, pool->strings[string_i]);
+    }
+
+    int result = flush_report_buffer(&buffer, file);
+    free_report_buffer(&buffer);
+    return result;
+}
+
+int smell_lists_to_binary(const char *path, const Binary_run_info *info) {
+    String_pool pool = {0};
+    Detector_strings *strings = calloc(detector_count, sizeof(Detector_strings));
+    uint32_t *file_ids = malloc((info->file_LOC_count ? info->file_LOC_count : 1) * sizeof(uint32_t));
+    int result = -1;
+    if (!strings || !file_ids || collect_strings(&pool, strings) != 0
+            || collect_file_table_strings(&pool, info, file_ids) != 0) {
+        fprintf(stderr, "Failed to allocate memory for %s.\n", path);
+    } else if (pool.count >= UINT32_MAX) {
+        fprintf(stderr, "Too many strings for %s.\n", path);
+    } else {
+        FILE *file = fopen(path, "wb");
+        if (!file) {
+            perror(path);
+        } else {
+            result = write_binary(file, info, &pool, strings, file_ids);
+            if (fclose(file) != 0) result = -1;
+            if (result != 0) fprintf(stderr, "Failed to write %s.\n", path);
+        }
+    }
+
+    for (size_t detector_i = 0; strings && detector_i < detector_count; ++detector_i) {
+        free(strings[detector_i].metric_names);
+        free(strings[detector_i].files);
+    }
+    free(strings);
+    free(file_ids);
+    free(pool.strings);
+    free(pool.slots);
+    return result;
+}
+
+static uint32_t read_u32(const char *data, uint64_t at) {
+    uint32_t value;
+    memcpy(&value, data + at, sizeof(value));
+    return value;
+}
+
+static uint64_t read_u64(const char *data, uint64_t at) {
+    uint64_t value;
+    memcpy(&value, data + at, sizeof(value));
+    return value;
+}
+
+// 1 if count elements of element_size bytes at offset lie inside the file and are aligned to 8 bytes
+static int inside(const Binary_results *results, uint64_t offset, uint64_t count, uint64_t element_size) {
+    if (offset % 8 != 0 || offset > results->size) return 0;
+    return count <= (results->size - offset) / element_size;
+}
+
+// checks that every offset and string id of the file is valid, so reading it can't fail later
+static int check_tables(const Binary_results *results) {
+    const char *data = results->data;
+    uint64_t string_offsets_at = read_u64(data, 24);
+    uint64_t string_data_at = read_u64(data, 32);
+    if (!inside(results, HEADER_SIZE, results->detector_count, DETECTOR_ENTRY_SIZE)
+            || !inside(results, string_offsets_at, (uint64_t)results->string_count + 1, sizeof(uint64_t))
+            || string_data_at > results->size) {
+        return -1;
+    }
+    const uint64_t *offsets = (const uint64_t *)(data + string_offsets_at);
+    for (uint32_t string_i = 0; string_i < results->string_count; ++string_i) {
+        if (offsets[string_i] > offsets[string_i + 1]) return -1;
+    }
+    if (offsets[results->string_count] > results->size - string_data_at) return -1;
+
+    uint64_t file_table_at = read_u64(data, 64);
+    if (!inside(results, file_table_at, results->info.file_LOC_count, 2 * sizeof(uint32_t))) return -1;
+    const uint32_t *file_table = (const uint32_t *)(data + file_table_at);
+    for (uint64_t file_i = 0; file_i < results->info.file_LOC_count; ++file_i) {
+        if (file_table[2 * file_i] >= results->string_count) return -1;
+    }
+
+    for (uint32_t detector_i = 0; detector_i < results->detector_count; ++detector_i) {
+        uint64_t entry_at = HEADER_SIZE + (uint64_t)detector_i * DETECTOR_ENTRY_SIZE;
+        uint64_t metric_count = read_u32(data, entry_at + 4);
+        uint64_t smell_count = read_u64(data, entry_at + 8);
+        uint64_t data_at = read_u64(data, entry_at + 16);
+        if (read_u32(data, entry_at) >= results->string_count
+                || !inside(results, data_at, metric_count, 2 * sizeof(uint32_t))) {
+            return -1;
+        }
+        const uint32_t *definitions = (const uint32_t *)(data + data_at);
+        for (uint64_t metric_i = 0; metric_i < metric_count; ++metric_i) {
+            if (definitions[2 * metric_i] >= results->string_count || definitions[2 * metric_i + 1] > 1) return -1;
+        }
+
+        uint64_t columns_at = data_at + padded(metric_count * 2 * sizeof(uint32_t));
+        if (!inside(results, columns_at, smell_count, sizeof(uint32_t))) return -1;
+        uint64_t column_size = padded(smell_count * sizeof(uint32_t));
+        if (column_size != 0 && 2 + metric_count > (results->size - columns_at) / column_size) return -1;
+        const uint32_t *files = (const uint32_t *)(data + columns_at);
+        for (uint64_t smell_i = 0; smell_i < smell_count; ++smell_i) {
+            if (files[smell_i] >= results->string_count) return -1;
+        }
+    }
+    return 0;
+}
+
+int open_binary_results(const char *path, Binary_results *results) {
+    results->path = path;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    if ((uint64_t)file_stat.st_size < HEADER_SIZE) {
+        fprintf(stderr, "%s is not a smell results file.\n", path);
+        close(fd);
+        return -1;
+    }
+    results->size = (size_t)file_stat.st_size;
+    void *mapping = mmap(NULL, results->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    results->data = mapping;
+
+    const char *data = results->data;
+    uint32_t version = read_u32(data, 4);
+    if (memcmp(data, BINARY_MAGIC, 4) != 0) {
+        fprintf(stderr, "%s is not a smell results file.\n", path);
+    } else if (read_u32(data, 8) != BINARY_BYTE_ORDER) {
+        fprintf(stderr, "%s was written on a machine with a different byte order.\n", path);
+    } else if (version != BINARY_FORMAT_VERSION) {
+        fprintf(stderr, "%s has format version %u, expected %u.\n", path, version, BINARY_FORMAT_VERSION);
+    } else {
+        results->detector_count = read_u32(data, 12);
+        results->string_count = read_u32(data, 16);
+        results->info.flags = read_u32(data, 20);
+        results->info.file_count = read_u64(data, 40);
+        results->info.total_LOC = read_u64(data, 48);
+        results->info.shard_index = read_u32(data, 56);
+        results->info.shard_count = read_u32(data, 60);
+        results->info.file_LOCs = NULL;
+        results->info.file_LOC_count = read_u64(data, 72);
+        if (check_tables(results) == 0) return 0;
+        fprintf(stderr, "%s is damaged, a table lies outside of the file.\n", path);
+    }
+    close_binary_results(results);
+    return -1;
+}
+
+void close_binary_results(Binary_results *results) {
+    munmap((void *)results->data, results->size);
+    results->data = NULL;
+    results->size = 0;
+}
+
+const char *binary_string(const Binary_results *results, uint32_t string_id, size_t *length) {
+    const uint64_t *offsets = (const uint64_t *)(results->data + read_u64(results->data, 24));
+    *length = (size_t)(offsets[string_id + 1] - offsets[string_id]);
+    return results->data + read_u64(results->data, 32) + offsets[string_id];
+}
+
+void get_binary_detector(const Binary_results *results, uint32_t detector_i, Binary_detector *detector) {
+    uint64_t entry_at = HEADER_SIZE + (uint64_t)detector_i * DETECTOR_ENTRY_SIZE;
+    uint64_t data_at = read_u64(results->data, entry_at + 16);
+    detector->name = read_u32(results->data, entry_at);
+    detector->metric_count = read_u32(results->data, entry_at + 4);
+    detector->smell_count = read_u64(results->data, entry_at + 8);
+    detector->metric_definitions = (const uint32_t *)(results->data + data_at);
+
+    const char *columns = results->data + data_at + padded((uint64_t)detector->metric_count * 2 * sizeof(uint32_t));
+    detector->column_stride = (size_t)padded(detector->smell_count * sizeof(uint32_t));
+    detector->files = (const uint32_t *)columns;
+    detector->lines = (const uint32_t *)(columns + detector->column_stride);
+    detector->columns = columns + 2 * detector->column_stride;
+}
+
+const uint32_t *binary_file_table(const Binary_results *results) {
+    return (const uint32_t *)(results->data + read_u64(results->data, 64));
+}
+
+static int equals_string(const char *string, size_t length, const char *expected) {
+    return strlen(expected) == length && memcmp(string, expected, length) == 0;
+}
+
+int find_binary_detector(const Binary_results *results, const Smell_detector *detector,
+                         Binary_detector *found, uint32_t *metric_columns) {
+    size_t length;
+    uint32_t detector_i = 0;
+    for (; detector_i < results->detector_count; ++detector_i) {
+        get_binary_detector(results, detector_i, found);
+        const char *name = binary_string(results, found->name, &length);
+        if (equals_string(name, length, detector->name)) break;
+    }
+    if (detector_i == results->detector_count) {
+        fprintf(stderr, "%s has no candidates of %s, it was written by a different version.\n",
+                results->path, detector->name);
+        return -1;
+    }
+
+    for (size_t metric_i = 0; metric_i < detector->metric_count; ++metric_i) {
+        const Metric_definition *metric = &detector->metrics[metric_i];
+        uint32_t column = 0;
+        for (; column < found->metric_count; ++column) {
+            const uint32_t *definition = &found->metric_definitions[2 * column];
+            const char *name = binary_string(results, definition[0], &length);
+            if (equals_string(name, length, metric->name) && definition[1] == (metric->is_float ? 1u : 0u)) break;
+        }
+        if (column == found->metric_count) {
+            fprintf(stderr, "%s has no metric %s of %s, it was written by a different version.\n",
+                    results->path, metric->name, detector->name);
+            return -1;
+        }
+        metric_columns[metric_i] = column;
+    }
+    return 0;
+}
+
+size_t add_binary_smell(Smell_list *list, const Binary_detector *found, const uint32_t *metric_columns,
+                        size_t smell_i, const char *file_name) {
+    size_t added = add_smell(list, create_location(file_name, found->lines[smell_i]));
+    if (added == SMELL_NOT_ADDED) return added;
+    for (size_t metric_i = 0; metric_i < list->metric_count; ++metric_i) {
+        list->columns[metric_i][added] = binary_metric(found, metric_columns[metric_i], smell_i);
+    }
+    return added;
+}
@@ -0,0 +1,107 @@
+#ifndef BINARY_REPORT_H
+#define BINARY_REPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "smell_list.h"
+#include "detector.h"
+
+/*
+writes the smell lists of all detectors as columnar binary file
+(see smell_results.py for the loader). every value is stored in
+the byte order of the machine, all arrays are aligned to 8 bytes
+so they can be mapped without copies.
+
+header (80 bytes):
+    char magic[4] "MSDR", u32 version, u32 byte_order 0x01020304,
+    u32 detector_count, u32 string_count, u32 flags,
+    u64 string_offsets_at, u64 string_data_at,
+    u64 file_count, u64 total_loc, u32 shard_index, u32 shard_count,
+    u64 file_table_at, u64 file_table_count
+    flags bit 0: the lists hold the unfiltered candidates of a shard
+file table at file_table_at (baselines only, else 0 entries):
+    u32 file (string id), u32 loc of every analyzed file
+strings: u64 offsets[string_count + 1] into the utf-8 string data,
+    string i is data[offsets[i], offsets[i + 1])
+detectors (directly after the header, 24 bytes each):
+    u32 name (string id), u32 metric_count, u64 smell_count,
+    u64 data_at
+detector data at data_at:
+    metric_count times u32 name (string id), u32 type (0 int32,
+    1 float32), padded to 8 bytes, then the columns, each padded
+    to 8 bytes: u32 file (string id, dictionary encoded path),
+    u32 line and one column per metric
+*/
+
+#define BINARY_FLAG_UNFILTERED 1u
+
+/*
+what the run that wrote the file analyzed, shard_count is 1
+without --shard. file_LOCs is only written, a read file has
+file_LOC_count entries in its file table (binary_file_table).
+*/
+typedef struct {
+    uint32_t flags;
+    uint32_t shard_index;
+    uint32_t shard_count;
+    uint64_t file_count;
+    uint64_t total_LOC;
+    const File_LOC *file_LOCs;
+    uint64_t file_LOC_count;
+} Binary_run_info;
+
+int smell_lists_to_binary(const char *path, const Binary_run_info *info);
+
+/*
+a results file mapped for reading. open_binary_results checks the
+header and that every table lies inside the file, errors are printed.
+*/
+typedef struct {
+    const char *path;
+    const char *data;
+    size_t size;
+    Binary_run_info info;
+    uint32_t detector_count;
+    uint32_t string_count;
+} Binary_results;
+
+typedef struct {
+    uint32_t name; // string id
+    uint32_t metric_count;
+    uint64_t smell_count;
+    const uint32_t *metric_definitions; // name string id and type of every metric
+    const uint32_t *files; // string ids
+    const uint32_t *lines;
+    const char *columns; // metric_count columns of smell_count values, column_stride bytes apart
+    size_t column_stride;
+} Binary_detector;
+
+int open_binary_results(const char *path, Binary_results *results);
+void close_binary_results(Binary_results *results);
+// the strings are not null terminated
+const char *binary_string(const Binary_results *results, uint32_t string_id, size_t *length);
+void get_binary_detector(const Binary_results *results, uint32_t detector_i, Binary_detector *detector);
+// file string id and LOC of every entry of the file table, info.file_LOC_count pairs
+const uint32_t *binary_file_table(const Binary_results *results);
+
+/*
+finds the candidates of detector in results and the column in the
+file of each of its metrics (metric_columns has one entry per
+metric). detectors and metrics are matched by name and type, an
+error is printed if one is missing.
+*/
+int find_binary_detector(const Binary_results *results, const Smell_detector *detector,
+                         Binary_detector *found, uint32_t *metric_columns);
+// appends smell smell_i of found to list, returns SMELL_NOT_ADDED if the list couldn't grow
+size_t add_binary_smell(Smell_list *list, const Binary_detector *found, const uint32_t *metric_columns,
+                        size_t smell_i, const char *file_name);
+
+static inline Metric_value binary_metric(const Binary_detector *detector, size_t metric_i, size_t smell_i) {
+    Metric_value value;
+    const char *column = detector->columns + metric_i * detector->column_stride;
+    value.int_value = ((const int32_t *)column)[smell_i];
+    return value;
+}
+
+#endif
@@ -0,0 +1,302 @@
+#include "candidate_cache.h"
+#include "detector_registry.h"
+#include "hash.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC "MSDC"
+// increase when the entry layout changes
+#define CACHE_FORMAT_VERSION 2
+#define MAX_CACHE_PATH 4096
+
+extern TSLanguage *tree_sitter_matlab(void);
+
+// set once by init_candidate_cache, read only while the workers run
+static char cache_directory[MAX_CACHE_PATH];
+static uint64_t environment_hash;
+static int cache_enabled = 0;
+static atomic_ulong temporary_counter;
+
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+    int failed;
+} Entry_writer;
+
+typedef struct {
+    const char *data;
+    size_t size;
+    size_t offset;
+} Entry_reader;
+
+static void write_bytes(Entry_writer *writer, const void *bytes, size_t size) {
+    if (writer->failed) return;
+    if (writer->size + size > writer->capacity) {
+        size_t new_capacity = writer->capacity ? writer->capacity * 2 : 256;
+        while (new_capacity < writer->size + size) new_capacity *= 2;
+        char *larger = realloc(writer->data, new_capacity);
+        if (!larger) {
+            writer->failed = 1;
+            return;
+        }
+        writer->data = larger;
+        writer->capacity = new_capacity;
+    }
+    memcpy(writer->data + writer->size, bytes, size);
+    writer->size += size;
+}
+
+static void write_u32(Entry_writer *writer, uint32_t value) {
+    write_bytes(writer, &value, sizeof(value));
+}
+
+static void write_u64(Entry_writer *writer, uint64_t value) {
+    write_bytes(writer, &value, sizeof(value));
+}
+
+static int read_bytes(Entry_reader *reader, void *bytes, size_t size) {
+    if (reader->size - reader->offset < size) return -1;
+    memcpy(bytes, reader->data + reader->offset, size);
+    reader->offset += size;
+    return 0;
+}
+
+static int read_u32(Entry_reader *reader, uint32_t *value) {
+    return read_bytes(reader, value, sizeof(*value));
+}
+
+static int read_u64(Entry_reader *reader, uint64_t *value) {
+    return read_bytes(reader, value, sizeof(*value));
+}
+
+// everything except the file content that changes the candidates of a file
+static uint64_t compute_environment_hash(void) {
+    const TSLanguage *language = tree_sitter_matlab();
+    char description[256];
+    int length = snprintf(description, sizeof(description), "format=%d;abi=%u;symbols=%u;fields=%u;",
+                          CACHE_FORMAT_VERSION, ts_language_abi_version(language),
+                          ts_language_symbol_count(language), ts_language_field_count(language));
+    uint64_t hash = hash_bytes(description, (size_t)length, 0);
+
+    const TSLanguageMetadata *metadata = ts_language_metadata(language);
+    if (metadata) {
+        length = snprintf(description, sizeof(description), "grammar=%u.%u.%u;",
+                          metadata->major_version, metadata->minor_version, metadata->patch_version);
+        hash = hash_bytes(description, (size_t)length, hash);
+    }
+
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        const Smell_detector *detector = detectors[detector_i];
+        length = snprintf(description, sizeof(description), "%s:%d;", detector->name, detector->version);
+        hash = hash_bytes(description, (size_t)length, hash);
+        for (size_t metric_i = 0; metric_i < detector->metric_count; ++metric_i) {
+            length = snprintf(description, sizeof(description), "%s:%d;",
+                              detector->metrics[metric_i].name, detector->metrics[metric_i].is_float);
+            hash = hash_bytes(description, (size_t)length, hash);
+        }
+    }
+    return hash;
+}
+
+int init_candidate_cache(const char *directory) {
+    size_t length = strlen(directory);
+    if (length == 0 || length + 64 >= MAX_CACHE_PATH) {
+        fprintf(stderr, "Error: Invalid cache directory %s.\n", directory);
+        return -1;
+    }
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        perror(directory);
+        return -1;
+    }
+    memcpy(cache_directory, directory, length + 1);
+    environment_hash = compute_environment_hash();
+    atomic_init(&temporary_counter, 0);
+    cache_enabled = 1;
+    return 0;
+}
+
+int candidate_cache_enabled(void) {
+    return cache_enabled;
+}
+
+Cache_key candidate_cache_key(const Matlab_file *file) {
+    Cache_key key;
+    key.high = hash_bytes(file->content, file->length, environment_hash);
+    key.low = hash_bytes(file->content, file->length, ~environment_hash);
+    return key;
+}
+
+// returns -1 if the path doesn't fit into size bytes, the entry is then neither loaded nor stored
+static int entry_path(Cache_key key, char *path, size_t size) {
+    int length = snprintf(path, size, "%s/%016llx%016llx.cand", cache_directory,
+                          (unsigned long long)key.high, (unsigned long long)key.low);
+    return length >= 0 && (size_t)length < size ? 0 : -1;
+}
+
+void store_cached_candidates(Cache_key key, uint32_t LOC,
+                             Smell_list *const *lists, const size_t *starts) {
+    if (!cache_enabled) return;
+
+    Entry_writer writer = {0};
+    write_bytes(&writer, CACHE_MAGIC, 4);
+    write_u32(&writer, CACHE_FORMAT_VERSION);
+    write_u64(&writer, environment_hash);
+    write_u64(&writer, key.high);
+    write_u64(&writer, key.low);
+    write_u32(&writer, LOC);
+    write_u32(&writer, (uint32_t)detector_count);
+
+    // per detector the lines of all candidates, then one column of values per metric
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        const Smell_list *list = lists[detector_i];
+        size_t start = starts[detector_i];
+        size_t count = list->count - start;
+        write_u32(&writer, (uint32_t)count);
+        write_u32(&writer, (uint32_t)list->metric_count);
+        for (size_t smell_i = start; smell_i < list->count; ++smell_i) {
+            write_u32(&writer, list->locations[smell_i].line);
+        }
+        for (size_t metric_i = 0; metric_i < list->metric_count; ++metric_i) {
+            write_bytes(&writer, &list->columns[metric_i][start], count * sizeof(Metric_value));
+        }
+    }
+
+    if (!writer.failed) {
+        char path[MAX_CACHE_PATH];
+        char temporary_path[MAX_CACHE_PATH + 64];
+        int has_path = entry_path(key, path, sizeof(path)) == 0;
+        int length = snprintf(temporary_path, sizeof(temporary_path), "%s.%ld.%lu.tmp", path, (long)getpid(),
+                              atomic_fetch_add(&temporary_counter, 1));
+        has_path = has_path && length >= 0 && (size_t)length < sizeof(temporary_path);
+
+        FILE *file = has_path ? fopen(temporary_path, "wb") : NULL;
+        if (file) {
+            int written = fwrite(writer.data, 1, writer.size, file) == writer.size;
+            if (fclose(file) != 0) written = 0;
+            if (!written || rename(temporary_path, path) != 0) {
+                remove(temporary_path);
+            }
+        }
+    }
+    free(writer.data);
+}
+
+// where the candidates of one detector are stored in an entry, the metric columns follow the lines
+typedef struct {
+    uint32_t smell_count;
+    size_t lines_offset;
+} Entry_section;
+
+/*
+checks the entry and finds the candidates of every detector
+before anything is added to the lists, sections has one entry
+per detector
+*/
+static int validate_entry(Entry_reader reader, Cache_key key, uint32_t *LOC, Entry_section *sections) {
+    char magic[4];
+    uint32_t format_version, stored_detector_count;
+    uint64_t stored_environment, key_high, key_low;
+    if (read_bytes(&reader, magic, 4) != 0 || memcmp(magic, CACHE_MAGIC, 4) != 0) return -1;
+    if (read_u32(&reader, &format_version) != 0 || format_version != CACHE_FORMAT_VERSION) return -1;
+    if (read_u64(&reader, &stored_environment) != 0 || stored_environment != environment_hash) return -1;
+    if (read_u64(&reader, &key_high) != 0 || read_u64(&reader, &key_low) != 0) return -1;
+    if (key_high != key.high || key_low != key.low) return -1;
+    if (read_u32(&reader, LOC) != 0) return -1;
+    if (read_u32(&reader, &stored_detector_count) != 0 || stored_detector_count != detector_count) return -1;
+
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        uint32_t metric_count;
+        if (read_u32(&reader, &sections[detector_i].smell_count) != 0 || read_u32(&reader, &metric_count) != 0) {
+            return -1;
+        }
+        if (metric_count != detectors[detector_i]->metric_count) return -1;
+        size_t column_size = (size_t)sections[detector_i].smell_count * sizeof(uint32_t);
+        size_t entry_size = column_size * (1 + (size_t)metric_count);
+        if (reader.size - reader.offset < entry_size) return -1;
+        sections[detector_i].lines_offset = reader.offset;
+        reader.offset += entry_size;
+    }
+    return reader.offset == reader.size ? 0 : -1;
+}
+
+static char *read_entry(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    char *data = NULL;
+    size_t capacity = 0;
+    *size = 0;
+    for (;;) {
+        if (*size == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            char *larger = realloc(data, capacity);
+            if (!larger) {
+                free(data);
+                fclose(file);
+                return NULL;
+            }
+            data = larger;
+        }
+        size_t bytes_read = fread(data + *size, 1, capacity - *size, file);
+        if (bytes_read == 0) break;
+        *size += bytes_read;
+    }
+    fclose(file);
+    return data;
+}
+
+int load_cached_candidates(Cache_key key, const Matlab_file *file,
+                           Smell_list *const *lists, uint32_t *LOC) {
+    if (!cache_enabled) return 0;
+
+    char path[MAX_CACHE_PATH];
+    if (entry_path(key, path, sizeof(path)) != 0) return 0;
+    size_t size;
+    char *data = read_entry(path, &size);
+    if (!data) return 0;
+
+    Entry_reader reader = { data, size, 0 };
+    Entry_section sections[detector_count];
+    if (validate_entry(reader, key, LOC, sections) != 0) {
+        free(data);
+        return 0;
+    }
+
+    size_t starts[detector_count];
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        starts[detector_i] = lists[detector_i]->count;
+    }
+
+    int loaded = 1;
+    for (size_t detector_i = 0; detector_i < detector_count && loaded; ++detector_i) {
+        Smell_list *list = lists[detector_i];
+        uint32_t smell_count = sections[detector_i].smell_count;
+        reader.offset = sections[detector_i].lines_offset;
+
+        for (uint32_t smell_i = 0; smell_i < smell_count && loaded; ++smell_i) {
+            uint32_t line;
+            loaded = read_u32(&reader, &line) == 0
+                  && add_smell(list, create_location(file->file_name, line)) != SMELL_NOT_ADDED;
+        }
+        for (size_t metric_i = 0; metric_i < list->metric_count && loaded; ++metric_i) {
+            loaded = read_bytes(&reader, &list->columns[metric_i][starts[detector_i]],
+                                smell_count * sizeof(Metric_value)) == 0;
+        }
+    }
+
+    if (!loaded) {
+        // the caller parses the file instead, nothing of the entry may stay in the lists
+        for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+            lists[detector_i]->count = starts[detector_i];
+        }
+    }
+    free(data);
+    return loaded;
+}
@@ -0,0 +1,43 @@
+#ifndef CANDIDATE_CACHE_H
+#define CANDIDATE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "matlab_file_list.h"
+#include "smell_list.h"
+
+/*
+on disk cache of the unfiltered candidates of every file.
+an entry is keyed by a hash of the file content, the grammar
+version and the name, version and metrics of every detector,
+so files with unchanged content skip tree-sitter entirely on
+the next run. thresholds are not part of the key, filtering
+always runs on the candidates of the current run.
+one file per entry, written to a temporary name and renamed,
+so concurrent workers and processes never see partial entries.
+*/
+
+typedef struct {
+    uint64_t high;
+    uint64_t low;
+} Cache_key;
+
+// creates the directory if needed, has to be called before any worker starts
+int init_candidate_cache(const char *directory);
+int candidate_cache_enabled(void);
+
+Cache_key candidate_cache_key(const Matlab_file *file);
+
+/*
+on a hit the cached candidates of detector i are appended to
+lists[i] with locations in file, returns 1 on a hit, 0 otherwise
+*/
+int load_cached_candidates(Cache_key key, const Matlab_file *file,
+                           Smell_list *const *lists, uint32_t *LOC);
+
+// stores the smells of every lists[i] from starts[i] up to the end of the list
+void store_cached_candidates(Cache_key key, uint32_t LOC,
+                             Smell_list *const *lists, const size_t *starts);
+
+#endif
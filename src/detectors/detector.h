@@ -3,14 +3,12 @@
 
 #include "smell_list.h"
 #include "matlab_file_list.h"
+#include "tree_visitor.h"
 
 #include <stddef.h>
 
 #define MAX_CONFIGS 3
 
-typedef struct TSNode TSNode;
-
-
 typedef struct {
     // these are defined when implementing a detector
     const char *name;
@@ -28,13 +26,61 @@ typedef struct {
     int use_percentage;
 } Configuration;
 
+/*
+one step of a detector's filter chain (filter_utils.h). the
+config with the name of the metric decides whether the step
+keeps a percentage of all candidates or those reaching an
+absolute threshold. ascending steps keep the smallest values
+(upper bound), the others keep the largest values (lower bound).
+*/
+typedef struct {
+    size_t metric_id;
+    int ascending;
+} Filter_step;
+
 typedef struct Smell_detector Smell_detector;
 
+/*
+candidates are detected during the shared single pass over
+each syntax tree (tree_visitor.h). every worker owns one
+state of state_size bytes per detector (zero initialized),
+begin_file prepares it for the next file, the hooks receive
+it for every node of their type and end_file runs after the
+whole tree was visited. free_state releases memory the
+state kept between files and may be NULL.
+version has to be increased whenever the detection changes
+the candidates or their metrics, it invalidates cached
+candidates (candidate_cache.h).
+metrics are declared once, a metric id is the index of its
+definition in metrics and every smell list of the detector
+has one column per metric (smell_list.h).
+the first step of every filter ranks the candidates by
+metric 0 in descending order, watch mode (watch.h) keeps
+the unfiltered candidates in that order.
+candidate_count is the number of candidates found in all
+files, percentage steps refer to it. it can be larger than
+the smell list when candidates were prefiltered while they
+were found (bounded mode, analysis.h).
+keywords is a NULL terminated list of words that occur in every
+file where the hooks can find a candidate, files without any
+keyword of any detector aren't parsed (prefilter.h). NULL means
+the detector has to see every file.
+*/
 struct Smell_detector {
     const char *name;
+    int version;
     Smell_list *smell_list;
-    void (*detect_candidates)(TSNode, Matlab_file*, Smell_list*);
-    void (*filter)(Smell_detector*);
+    const Metric_definition *metrics;
+    size_t metric_count;
+    const Visitor_hook *hooks;
+    const char *const *keywords;
+    size_t state_size;
+    void (*begin_file)(void *state, const Matlab_file *file, Smell_list *list);
+    void (*end_file)(void *state);
+    void (*free_state)(void *state);
+    const Filter_step *filter_steps;
+    size_t filter_step_count;
+    size_t candidate_count;
     Configuration configs[MAX_CONFIGS];
     size_t config_count;
 };
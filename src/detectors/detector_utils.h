@@ -3,24 +3,27 @@
 
 #include "tree_sitter/api.h"
 
+#include <stdint.h>
+
 extern TSLanguage *tree_sitter_matlab(void);
 
+/*
+text of a node as a range of the source code, nothing is
+copied. it is not null terminated and only valid as long
+as the source code is, text is NULL for missing nodes.
+*/
 typedef struct {
-    char **items;
-    int count;
-    int capacity;
-} StringList;
+    const char *text;
+    uint32_t length;
+} String_view;
 
-StringList* create_string_list(void);
-void add_to_string_list(StringList *list, const char *str);
-int string_list_contains(StringList *list, const char *str);
-int string_list_index_of(StringList *list, const char *str);
-void free_string_list(StringList *list);
+String_view get_node_view(TSNode node, const char *source_code);
+int views_equal(String_view a, String_view b);
+int view_equals_string(String_view view, const char *string);
 
-char* extract_first_parameter(TSNode method_node, const char* source_code);
-char* extract_class_name(TSNode class_node, const char* source_code);
+String_view extract_first_parameter(TSNode method_node, const char* source_code);
+String_view extract_class_name(TSNode class_node, const char* source_code);
 int is_static_methods_block(TSNode methods_node, const char* source_code);
-char* get_node_text(TSNode node, const char *source_code);
 int count_methods(TSNode node);
 
-#endif
\ No newline at end of file
+#endif
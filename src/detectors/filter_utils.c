@@ -3,115 +3,439 @@
 #include <string.h>
 #include <stdlib.h>
 
+// ranges this short are sorted by insertion
+#define INSERTION_SORT_LIMIT 16
+// candidates a growing heap keeps on top of twice the share
+#define HEAP_SLACK 64
 
-// global variable to pass context to compare function
-static size_t current_metric_index = 0;
+struct Resolved_step {
+    size_t metric_id;
+    int ascending;
+    int use_percentage;
+    float percentage;
+    double threshold;
+};
 
-// finds index and stores in *index
-static int find_metric_index(const Smell *smell, const char *metric_name, size_t *index) {
-    for (size_t metric_i = 0; metric_i < smell->metric_count; metric_i++) {
-        if (strcmp(smell->metrics[metric_i].name, metric_name) == 0) {
-            *index = metric_i;
-            return 1;
+// comparator context, passed explicitly instead of through a global
+typedef struct {
+    const Smell_list *list;
+    const Metric_value *values; // column of the ranked metric
+    int is_float;
+    int ascending;
+} Rank_order;
+
+static Rank_order rank_order(const Smell_list *list, size_t metric_id, int ascending) {
+    Rank_order order = { list, list->columns[metric_id], list->metrics[metric_id].is_float, ascending };
+    return order;
+}
+
+static int compare_locations(const Smell_location *a, const Smell_location *b) {
+    if (a->file_name != b->file_name) {
+        int file_order = strcmp(a->file_name, b->file_name);
+        if (file_order != 0) return file_order;
+    }
+    if (a->line < b->line) return -1;
+    if (a->line > b->line) return 1;
+    return 0;
+}
+
+static int compare_values(double value_a, double value_b, int ascending) {
+    if (value_a == value_b) return 0;
+    int a_is_larger = value_a > value_b;
+    return a_is_larger != ascending ? -1 : 1;
+}
+
+int compare_smells_by_metric(const Smell_list *list_a, size_t smell_a, const Smell_list *list_b, size_t smell_b,
+                             size_t metric_id, int ascending) {
+    int order = compare_values(get_metric(list_a, smell_a, metric_id), get_metric(list_b, smell_b, metric_id),
+                               ascending);
+    if (order != 0) return order;
+    return compare_locations(&list_a->locations[smell_a], &list_b->locations[smell_b]);
+}
+
+static int ranks_before(const Rank_order *order, size_t item_a, size_t item_b) {
+    Metric_value value_a = order->values[item_a];
+    Metric_value value_b = order->values[item_b];
+    int value_order = order->is_float
+        ? compare_values(value_a.float_value, value_b.float_value, order->ascending)
+        : compare_values(value_a.int_value, value_b.int_value, order->ascending);
+    if (value_order != 0) return value_order < 0;
+    return compare_locations(&order->list->locations[item_a], &order->list->locations[item_b]) < 0;
+}
+
+static void swap_items(size_t *items, size_t i, size_t j) {
+    size_t item = items[i];
+    items[i] = items[j];
+    items[j] = item;
+}
+
+// partitions items[low, high) around a median of three pivot, returns the pivot's position
+static size_t partition(const Rank_order *order, size_t *items, size_t low, size_t high) {
+    size_t middle = low + (high - low) / 2;
+    size_t last = high - 1;
+    if (ranks_before(order, items[middle], items[low])) swap_items(items, middle, low);
+    if (ranks_before(order, items[last], items[low])) swap_items(items, last, low);
+    if (ranks_before(order, items[middle], items[last])) swap_items(items, middle, last);
+    // items[last] is now the median
+
+    size_t store = low;
+    for (size_t item_i = low; item_i < last; ++item_i) {
+        if (ranks_before(order, items[item_i], items[last])) {
+            swap_items(items, item_i, store++);
+        }
+    }
+    swap_items(items, store, last);
+    return store;
+}
+
+static void insertion_sort(const Rank_order *order, size_t *items, size_t low, size_t high) {
+    for (size_t item_i = low + 1; item_i < high; ++item_i) {
+        size_t item = items[item_i];
+        size_t position = item_i;
+        while (position > low && ranks_before(order, item, items[position - 1])) {
+            items[position] = items[position - 1];
+            position--;
+        }
+        items[position] = item;
+    }
+}
+
+static void sort_items(const Rank_order *order, size_t *items, size_t low, size_t high) {
+    while (high - low > INSERTION_SORT_LIMIT) {
+        size_t pivot = partition(order, items, low, high);
+        // recursion on the smaller side keeps the stack depth logarithmic
+        if (pivot - low < high - pivot) {
+            sort_items(order, items, low, pivot);
+            low = pivot + 1;
+        } else {
+            sort_items(order, items, pivot + 1, high);
+            high = pivot;
+        }
+    }
+    insertion_sort(order, items, low, high);
+}
+
+static int is_ranked(const Rank_order *order, const size_t *items, size_t count) {
+    for (size_t item_i = 1; item_i < count; ++item_i) {
+        if (ranks_before(order, items[item_i], items[item_i - 1])) return 0;
+    }
+    return 1;
+}
+
+// moves the best keep_count items to the front, in no particular order
+static void select_best(const Rank_order *order, size_t *items, size_t count, size_t keep_count) {
+    if (keep_count == 0 || keep_count >= count) return;
+    // lists that are already in order need no selection
+    if (is_ranked(order, items, count)) return;
+
+    size_t low = 0;
+    size_t high = count;
+    while (high - low > 1) {
+        size_t pivot = partition(order, items, low, high);
+        if (pivot == keep_count) return;
+        if (pivot < keep_count) {
+            low = pivot + 1;
+        } else {
+            high = pivot;
+        }
+    }
+}
+
+static int passes_absolute_steps(const Smell_list *list, size_t smell_i,
+                                 const Resolved_step *steps, size_t step_count) {
+    for (size_t step_i = 0; step_i < step_count; ++step_i) {
+        double value = get_metric(list, smell_i, steps[step_i].metric_id);
+        int passes = steps[step_i].ascending ? value <= steps[step_i].threshold
+                                             : value >= steps[step_i].threshold;
+        if (!passes) return 0;
+    }
+    return 1;
+}
+
+// keeps the items that pass all absolute steps, in their current order
+static size_t keep_passing(const Smell_list *list, size_t *items, size_t count,
+                           const Resolved_step *steps, size_t step_count) {
+    size_t kept = 0;
+    for (size_t item_i = 0; item_i < count; ++item_i) {
+        if (passes_absolute_steps(list, items[item_i], steps, step_count)) {
+            items[kept++] = items[item_i];
         }
     }
+    return kept;
+}
+
+Configuration *get_config_by_name(Smell_detector *detector, const char *name) {
+    for (size_t config_i = 0; config_i < detector->config_count; ++config_i) {
+        if (detector->configs[config_i].name && strcmp(detector->configs[config_i].name, name) == 0) {
+            return &detector->configs[config_i];
+        }
+    }
+    return NULL;
+}
+
+static int resolve_step(Smell_detector *detector, const Filter_step *step, Resolved_step *resolved) {
+    if (step->metric_id >= detector->metric_count) {
+        fprintf(stderr, "filter_%s: Metric %zu doesn't exist.\n", detector->name, step->metric_id);
+        return -1;
+    }
+    const char *metric_name = detector->metrics[step->metric_id].name;
+    Configuration *config = get_config_by_name(detector, metric_name);
+    if (!config) {
+        fprintf(stderr, "filter_%s: Config with given name %s doesn't exist.\n", detector->name, metric_name);
+        return -1;
+    }
+
+    resolved->metric_id = step->metric_id;
+    resolved->ascending = step->ascending;
+    resolved->use_percentage = config->use_percentage;
+    resolved->percentage = config->percentage_value;
+    resolved->threshold = config->absolute_is_float ? config->absolute_value.float_absolute
+                                                    : config->absolute_value.int_absolute;
     return 0;
 }
 
-static int compare_ascending(const void *a, const void *b) {
-    const Smell *smell_a = (const Smell *)a;
-    const Smell *smell_b = (const Smell *)b;
-    
-    const Metric *metric_a = &smell_a->metrics[current_metric_index];
-    const Metric *metric_b = &smell_b->metrics[current_metric_index];
-    
-    if (metric_a->is_float) {
-        float value_a = metric_a->measured_value.float_value;
-        float value_b = metric_b->measured_value.float_value;
-        
-        if (value_a < value_b) return -1;
-        if (value_a > value_b) return 1;
-        return 0;
-    } else {
-        int value_a = metric_a->measured_value.int_value;
-        int value_b = metric_b->measured_value.int_value;
-        
-        if (value_a < value_b) return -1;
-        if (value_a > value_b) return 1;
-        return 0;
+int filter_smell_list(Smell_detector *detector) {
+    const Filter_step *steps = detector->filter_steps;
+    size_t step_count = detector->filter_step_count;
+    Smell_list *list = detector->smell_list;
+    // prefiltered lists hold less than all candidates
+    size_t total_count = detector->candidate_count > list->count ? detector->candidate_count : list->count;
+    if (list->count == 0 || step_count == 0) return 0;
+
+    Resolved_step resolved[step_count];
+    for (size_t step_i = 0; step_i < step_count; ++step_i) {
+        if (resolve_step(detector, &steps[step_i], &resolved[step_i]) != 0) return -1;
+    }
+
+    size_t count = list->count;
+    size_t *items = malloc(count * sizeof(size_t));
+    if (!items) {
+        fprintf(stderr, "Failed to allocate memory for filtering %s.\n", detector->name);
+        return -1;
     }
+    for (size_t item_i = 0; item_i < count; ++item_i) {
+        items[item_i] = item_i;
+    }
+
+    for (size_t step_i = 0; step_i < step_count; ++step_i) {
+        const Resolved_step *step = &resolved[step_i];
+        if (!step->use_percentage) {
+            size_t run_end = step_i + 1;
+            while (run_end < step_count && !resolved[run_end].use_percentage) run_end++;
+            count = keep_passing(list, items, count, step, run_end - step_i);
+            step_i = run_end - 1;
+            continue;
+        }
+
+        // the share always refers to all candidates
+        if (step->percentage < 0.0f || step->percentage > 1.0f) continue;
+        size_t keep_count = (size_t)(total_count * step->percentage);
+        if (keep_count > count) keep_count = count;
+        Rank_order order = rank_order(list, step->metric_id, step->ascending);
+        select_best(&order, items, count, keep_count);
+        count = keep_count;
+    }
+
+    const Resolved_step *last_step = &resolved[step_count - 1];
+    Rank_order order = rank_order(list, last_step->metric_id, last_step->ascending);
+    sort_items(&order, items, 0, count);
+
+    int result = gather_smells(list, items, count);
+    free(items);
+    return result;
 }
 
-static int compare_descending(const void *a, const void *b) {
-    return -compare_ascending(a, b);
+int sort_smell_list(Smell_list *list, size_t metric_id, int ascending) {
+    size_t *items = malloc((list->count ? list->count : 1) * sizeof(size_t));
+    if (!items) {
+        fprintf(stderr, "Failed to allocate memory for sorting smells.\n");
+        return -1;
+    }
+    for (size_t item_i = 0; item_i < list->count; ++item_i) {
+        items[item_i] = item_i;
+    }
+    Rank_order order = rank_order(list, metric_id, ascending);
+    sort_items(&order, items, 0, list->count);
+    int result = gather_smells(list, items, list->count);
+    free(items);
+    return result;
 }
 
-void sort_smell_list_by_metric(Smell_list *list, const char *metric_name, int ascending) {
-    if (!metric_name || !list || list->count == 0) return;
-    
-    size_t metric_index;
-    if (!find_metric_index(&list->smells[0], metric_name, &metric_index)) {
-        fprintf(stderr, "Metric doesn't exist in smell list.\n");
-        return;
+size_t count_first_step_survivors(Smell_detector *detector, const Smell_list *ranked) {
+    Resolved_step step;
+    if (detector->filter_step_count == 0 || resolve_step(detector, &detector->filter_steps[0], &step) != 0) {
+        return ranked->count;
     }
-    
-    // set global variable, not thread safe
-    current_metric_index = metric_index;
-    
-    if (ascending) {
-        qsort(list->smells, list->count, sizeof(Smell), compare_ascending);
-    } else {
-        qsort(list->smells, list->count, sizeof(Smell), compare_descending);
+    if (step.use_percentage) {
+        // filter_smell_list skips invalid shares as well
+        if (step.percentage < 0.0f || step.percentage > 1.0f) return ranked->count;
+        return (size_t)(ranked->count * step.percentage);
+    }
+
+    size_t low = 0;
+    size_t high = ranked->count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (passes_absolute_steps(ranked, middle, &step, 1)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+int init_top_candidates(Top_candidates *top, Smell_detector *detector, const size_t *known_total) {
+    memset(top, 0, sizeof(Top_candidates));
+    if (init_smell_list(&top->heap, detector->metrics, detector->metric_count) != 0
+            || init_smell_list(&top->evicted, detector->metrics, detector->metric_count) != 0
+            || (detector->filter_step_count > 0
+                && !(top->steps = malloc(detector->filter_step_count * sizeof(Resolved_step))))) {
+        fprintf(stderr, "Failed to allocate memory for filtering %s.\n", detector->name);
+        free_top_candidates(top);
+        return -1;
+    }
+
+    for (size_t step_i = 0; step_i < detector->filter_step_count; ++step_i) {
+        Resolved_step step;
+        if (resolve_step(detector, &detector->filter_steps[step_i], &step) != 0) {
+            free_top_candidates(top);
+            return -1;
+        }
+        if (!step.use_percentage) {
+            top->steps[top->step_count++] = step;
+            continue;
+        }
+        // filter_smell_list skips invalid shares as well
+        if (step.percentage < 0.0f || step.percentage > 1.0f) continue;
+
+        top->has_share = 1;
+        top->metric_id = step.metric_id;
+        top->ascending = step.ascending;
+        top->percentage = step.percentage;
+        if (known_total) {
+            top->has_fixed_capacity = 1;
+            top->fixed_capacity = (size_t)(*known_total * step.percentage);
+        }
+        break;
+    }
+    return 0;
+}
+
+void free_top_candidates(Top_candidates *top) {
+    free(top->steps);
+    free_smell_list(&top->heap);
+    free_smell_list(&top->evicted);
+    top->steps = NULL;
+}
+
+static int ranks_worse(const Top_candidates *top, const Smell_list *list_a, size_t smell_a,
+                       const Smell_list *list_b, size_t smell_b) {
+    return compare_smells_by_metric(list_a, smell_a, list_b, smell_b, top->metric_id, top->ascending) > 0;
+}
+
+// evicted holds the best candidate that was dropped after it passed the absolute steps
+static void note_evicted(Top_candidates *top, const Smell_list *list, size_t smell_i) {
+    if (top->evicted.count == 0) {
+        append_smells(&top->evicted, list, smell_i, 1);
+    } else if (ranks_worse(top, &top->evicted, 0, list, smell_i)) {
+        copy_smell(&top->evicted, 0, list, smell_i);
+    }
+}
+
+static void sift_down(Top_candidates *top, size_t position) {
+    Smell_list *heap = &top->heap;
+    for (;;) {
+        size_t worst = position;
+        size_t left = 2 * position + 1;
+        size_t right = left + 1;
+        if (left < heap->count && ranks_worse(top, heap, left, heap, worst)) worst = left;
+        if (right < heap->count && ranks_worse(top, heap, right, heap, worst)) worst = right;
+        if (worst == position) return;
+        swap_smells(heap, position, worst);
+        position = worst;
     }
 }
 
-void cut_smell_list_relative(Smell_list *list, size_t total_count, float percentage) {
-    if (!list || percentage < 0.0f || percentage > 1.0f) return;
-    size_t new_count = (size_t)(total_count * percentage);
-    list->count = new_count;
+static int push_candidate(Top_candidates *top, const Smell_list *list, size_t smell_i) {
+    Smell_list *heap = &top->heap;
+    if (append_smells(heap, list, smell_i, 1) != 0) return -1;
+
+    size_t position = heap->count - 1;
+    // only shares are kept as heap, other candidates just pass the absolute steps
+    while (top->has_share && position > 0) {
+        size_t parent = (position - 1) / 2;
+        if (!ranks_worse(top, heap, position, heap, parent)) break;
+        swap_smells(heap, position, parent);
+        position = parent;
+    }
+    return 0;
 }
 
-// sorting asc. vs desc. is directly related to is_upper_bound
-// -> would be good to wrap into one function call
-void cut_smell_list_absolute(Smell_list *list, const char *metric_name,
-                            threshold_value threshold, int is_upper_bound) {
-    if (!list || !metric_name || list->count == 0) return;
-    
-    size_t metric_index;
-    if (!find_metric_index(&list->smells[0], metric_name, &metric_index)) {
-        fprintf(stderr, "Metric doesn't exist in smell list.\n");
+void offer_candidate(Top_candidates *top, const Smell_list *list, size_t smell_i) {
+    top->seen++;
+    if (!passes_absolute_steps(list, smell_i, top->steps, top->step_count)) return;
+    if (!top->has_share) {
+        push_candidate(top, list, smell_i);
         return;
     }
-    
-    int is_float = list->smells[0].metrics[metric_index].is_float;
-
-    for (size_t smell_i = 0; smell_i < list->count; ++smell_i) {
-        const Metric *metric = &list->smells[smell_i].metrics[metric_index];
-        
-        if (is_float) {
-            if (is_upper_bound) {
-                if (metric->measured_value.float_value > threshold.float_value) {
-                    list->count = smell_i;
-                    break;
-                }
-            } else {
-                if (metric->measured_value.float_value < threshold.float_value) {
-                    list->count = smell_i;
-                    break;
-                }
-            }
-        } else {
-            if (is_upper_bound) {
-                if (metric->measured_value.int_value > threshold.int_value) {
-                    list->count = smell_i;
-                    break;
-                }
-            } else {
-                if (metric->measured_value.int_value < threshold.int_value) {
-                    list->count = smell_i;
-                    break;
-                }
-            }
+
+    size_t limit = top->fixed_capacity;
+    if (!top->has_fixed_capacity) {
+        // the share still grows with every candidate, keep twice of it so later ones rarely need dropped ones
+        limit = 2 * ((size_t)(top->seen * top->percentage) + 1) + HEAP_SLACK;
+    }
+
+    Smell_list *heap = &top->heap;
+    if (heap->count < limit) {
+        if (push_candidate(top, list, smell_i) != 0) note_evicted(top, list, smell_i);
+        return;
+    }
+    if (heap->count > 0 && ranks_worse(top, heap, 0, list, smell_i)) {
+        note_evicted(top, heap, 0);
+        copy_smell(heap, 0, list, smell_i);
+        sift_down(top, 0);
+    } else {
+        note_evicted(top, list, smell_i);
+    }
+}
+
+int merge_top_candidates(Top_candidates *parts, size_t part_count, Smell_detector *detector) {
+    Smell_list *list = detector->smell_list;
+    size_t total_count = 0;
+    const Smell_list *best_evicted = NULL;
+    for (size_t part_i = 0; part_i < part_count; ++part_i) {
+        Top_candidates *part = &parts[part_i];
+        total_count += part->seen;
+        if (append_smells(list, &part->heap, 0, part->heap.count) != 0) return -1;
+        if (part->evicted.count > 0
+                && (!best_evicted || ranks_worse(part, best_evicted, 0, &part->evicted, 0))) {
+            best_evicted = &part->evicted;
         }
     }
-}
\ No newline at end of file
+    detector->candidate_count = total_count;
+    if (!best_evicted) return 1;
+
+    size_t keep_count = (size_t)(total_count * parts[0].percentage);
+    if (keep_count == 0) return 1;
+    if (list->count < keep_count) return 0;
+
+    // the worst candidate of the share has to rank before every dropped one
+    size_t *items = malloc(list->count * sizeof(size_t));
+    if (!items) {
+        fprintf(stderr, "Failed to allocate memory for filtering %s.\n", detector->name);
+        return -1;
+    }
+    for (size_t item_i = 0; item_i < list->count; ++item_i) {
+        items[item_i] = item_i;
+    }
+    Rank_order order = rank_order(list, parts[0].metric_id, parts[0].ascending);
+    select_best(&order, items, list->count, keep_count);
+    size_t worst_kept = items[0];
+    for (size_t item_i = 1; item_i < keep_count; ++item_i) {
+        if (ranks_before(&order, worst_kept, items[item_i])) worst_kept = items[item_i];
+    }
+    int is_exact = ranks_worse(&parts[0], best_evicted, 0, list, worst_kept);
+    free(items);
+    return is_exact;
+}
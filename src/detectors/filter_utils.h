@@ -2,24 +2,76 @@
 #define FILTER_UTILS_H
 
 #include "smell_list.h"
+#include "detector.h"
 
-typedef union {
-    float float_value;
-    int int_value;
-} threshold_value;
+/*
+applies the filter steps of the detector in order to its smell list.
+consecutive absolute steps are checked together in a single
+partition pass, percentage steps select their share with a
+quickselect instead of sorting. only the remaining smells are
+sorted, by the metric of the last step.
+no global state, lists can be filtered concurrently.
+*/
+int filter_smell_list(Smell_detector *detector);
 
-// ! ASSUMPTION: all smells have the same metric at the same index in a smell list
-// ! this function is not thread safe
-void sort_smell_list_by_metric(Smell_list *list, const char *metric_name, int ascending);
+/*
+total order used to rank smells: by the metric (largest first
+unless ascending), then by file name and line, so the result
+doesn't depend on the order candidates were found in. both
+lists need the same metric definitions.
+*/
+int compare_smells_by_metric(const Smell_list *list_a, size_t smell_a, const Smell_list *list_b, size_t smell_b,
+                             size_t metric_id, int ascending);
 
-// ASSUMPTION for both cut functions: list is sorted
-// always keeps the left side of the list, behavior changes depending on sort type (asc./desc.)
+// sorts the whole list in the order of compare_smells_by_metric
+int sort_smell_list(Smell_list *list, size_t metric_id, int ascending);
 
-void cut_smell_list_relative(Smell_list *list, size_t total_count, float percentage);
+/*
+number of smells that pass the first filter step, for a list of
+all candidates sorted by the metric of that step. they are always
+the first ones: the share of a percentage step or the smells that
+reach the threshold. filtering only them with candidate_count set
+to all candidates gives the result of filtering the whole list.
+*/
+size_t count_first_step_survivors(Smell_detector *detector, const Smell_list *ranked);
 
-// threshold value is chosen based on metric.is_float
-// ? -> this could be changed so that not the metric type decides but rather the
-// detector.config
-void cut_smell_list_absolute(Smell_list *list, const char *metric_name, threshold_value threshold, int is_upper_bound);
+Configuration *get_config_by_name(Smell_detector *detector, const char *name);
 
-#endif
\ No newline at end of file
+typedef struct Resolved_step Resolved_step;
+
+/*
+prefilter for candidates while they are found (bounded mode).
+candidates failing the absolute steps in front of the first
+percentage step can never become smells and are dropped right
+away. if there is such a percentage step, only the best
+candidates by its metric are kept in a heap: about twice the
+share the step keeps of the candidates seen so far, or exactly
+the share of the known total.
+merge_top_candidates moves the candidates of all parts (one per
+worker) into the smell list of the detector and checks that no
+dropped candidate could have been part of the share. if one
+could, it returns 0 and the candidates have to be found again
+with the total known from this run.
+*/
+typedef struct {
+    Resolved_step *steps; // absolute steps in front of the share step
+    size_t step_count;
+    int has_share;
+    size_t metric_id; // of the share step
+    int ascending;
+    float percentage;
+    int has_fixed_capacity; // 0 if the heap grows with the candidates seen
+    size_t fixed_capacity;
+    Smell_list heap; // the worst kept candidate first
+    size_t seen;
+    Smell_list evicted; // the best dropped candidate, if any
+} Top_candidates;
+
+// known_total is NULL if the number of candidates isn't known yet
+int init_top_candidates(Top_candidates *top, Smell_detector *detector, const size_t *known_total);
+void free_top_candidates(Top_candidates *top);
+void offer_candidate(Top_candidates *top, const Smell_list *list, size_t smell_i);
+// returns 1 if the smell list holds every candidate that can pass the filter, 0 if not, -1 on errors
+int merge_top_candidates(Top_candidates *parts, size_t part_count, Smell_detector *detector);
+
+#endif
@@ -5,4 +5,4 @@
 
 int compute_atfd(TSNode class_node, const char* source_code);
 
-#endif
\ No newline at end of file
+#endif
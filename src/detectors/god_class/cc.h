@@ -5,4 +5,18 @@
 
 int count_binary_splits(TSNode node);
 
-#endif
\ No newline at end of file
+/*
+visitor hooks (tree_visitor.h) calling callback on entering
+every node that splits the control flow, has to list the
+same node types as QUERY_BINARY_SPLITS in query_registry.c
+*/
+#define BINARY_SPLIT_HOOKS(callback) \
+    {"if_statement", callback, NULL}, \
+    {"elseif_clause", callback, NULL}, \
+    {"while_statement", callback, NULL}, \
+    {"for_statement", callback, NULL}, \
+    {"switch_statement", callback, NULL}, \
+    {"case_clause", callback, NULL}, \
+    {"try_statement", callback, NULL}
+
+#endif
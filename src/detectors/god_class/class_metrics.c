@@ -0,0 +1,355 @@
+#include "class_metrics.h"
+#include "cc.h"
+#include "tcc.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_FRAME_CAPACITY 4
+
+extern TSLanguage *tree_sitter_matlab(void);
+
+/*
+a function definition inside a class. self_parameter is
+INTERN_FAILED for methods that are not counted for ATFD and
+TCC (constructor, no parameters), tcc_row is -1 for methods
+outside of non static method blocks
+*/
+typedef struct {
+    uint32_t self_parameter;
+    int tcc_row;
+} Method_frame;
+
+// names are ids of the intern table, all pointers point into the arena of the state
+struct Class_frame {
+    uint32_t class_name; // INTERN_FAILED if the name couldn't be extracted
+    int binary_splits;
+    int method_count;
+    int foreign_accesses;
+    int methods_block_depth;
+    int static_block_depth;
+    Id_set properties;
+    // names accessed through self, one list per TCC method
+    Id_list *accessed_properties;
+    int tcc_method_count;
+    int tcc_method_capacity;
+    Method_frame *methods;
+    size_t method_depth;
+    size_t method_capacity;
+    // methods entered without a frame, also the ones inside them, keeps enter/leave balanced
+    size_t lost_methods;
+};
+
+// grows an arena array of element_size sized items to hold at least one more item
+static int reserve_one(Arena *arena, void **items, size_t count, size_t *capacity, size_t element_size) {
+    if (count < *capacity) return 0;
+    size_t new_capacity = *capacity ? *capacity * 2 : INITIAL_FRAME_CAPACITY;
+    void *larger = arena_grow(arena, *items, count * element_size, new_capacity * element_size);
+    if (!larger) {
+        fprintf(stderr, "Failed to allocate memory for class metrics.\n");
+        return -1;
+    }
+    *items = larger;
+    *capacity = new_capacity;
+    return 0;
+}
+
+void begin_class_metrics(Class_metrics_state *state, const char *source_code,
+                         Class_callback on_class, void *context) {
+    // also drops frames left over from an unbalanced previous file
+    state->frame_count = 0;
+    state->lost_frames = 0;
+    reset_arena(&state->arena);
+    reset_intern_table(&state->names);
+    const TSLanguage *language = tree_sitter_matlab();
+    state->source_code = source_code;
+    state->on_class = on_class;
+    state->context = context;
+    state->object_field = ts_language_field_id_for_name(language, "object", strlen("object"));
+    state->field_field = ts_language_field_id_for_name(language, "field", strlen("field"));
+    state->name_field = ts_language_field_id_for_name(language, "name", strlen("name"));
+}
+
+void end_class_metrics(Class_metrics_state *state) {
+    if (state->has_child_cursor) {
+        ts_tree_cursor_delete(&state->child_cursor);
+        state->has_child_cursor = 0;
+    }
+}
+
+void free_class_metrics_state(Class_metrics_state *state) {
+    state->frame_count = 0;
+    state->lost_frames = 0;
+    free_arena(&state->arena);
+    free_intern_table(&state->names);
+    free(state->frames);
+    state->frames = NULL;
+    state->frame_capacity = 0;
+    end_class_metrics(state);
+}
+
+static void enter_class(void *metrics_state, TSNode class_node) {
+    Class_metrics_state *state = metrics_state;
+    // a frame pushed inside a lost class would be popped in its place
+    if (state->lost_frames > 0) {
+        state->lost_frames++;
+        return;
+    }
+    // frames are reused by every file, so they don't live in the arena
+    if (state->frame_count >= state->frame_capacity) {
+        size_t new_capacity = state->frame_capacity ? state->frame_capacity * 2 : INITIAL_FRAME_CAPACITY;
+        Class_frame *larger = realloc(state->frames, new_capacity * sizeof(Class_frame));
+        if (!larger) {
+            fprintf(stderr, "Failed to allocate memory for class metrics.\n");
+            state->lost_frames++;
+            return;
+        }
+        state->frames = larger;
+        state->frame_capacity = new_capacity;
+    }
+    Class_frame *frame = &state->frames[state->frame_count++];
+    memset(frame, 0, sizeof(Class_frame));
+    frame->class_name = INTERN_FAILED;
+    String_view class_name = extract_class_name(class_node, state->source_code);
+    if (class_name.text) {
+        frame->class_name = intern_name(&state->names, class_name);
+    }
+    init_id_set(&frame->properties);
+}
+
+static float tcc_of_frame(Class_metrics_state *state, const Class_frame *frame) {
+    if (frame->properties.count == 0 || frame->method_count == 0) {
+        return 0.0f;
+    }
+    return compute_tcc_from_accesses(&frame->properties, frame->accessed_properties,
+                                     frame->tcc_method_count, &state->arena);
+}
+
+static void leave_class(void *metrics_state, TSNode class_node) {
+    Class_metrics_state *state = metrics_state;
+    if (state->lost_frames > 0) {
+        state->lost_frames--;
+        return;
+    }
+    if (state->frame_count == 0) return;
+    Class_frame *frame = &state->frames[state->frame_count - 1];
+
+    if (frame->class_name == INTERN_FAILED) {
+        fprintf(stderr, "Could not extract class name.\n");
+    } else if (state->on_class) {
+        Class_metrics metrics;
+        metrics.wmc = frame->binary_splits + frame->method_count;
+        metrics.atfd = frame->foreign_accesses;
+        metrics.tcc = tcc_of_frame(state, frame);
+        state->on_class(state->context, class_node,
+                        interned_name(&state->names, frame->class_name), &metrics);
+    }
+    state->frame_count--;
+}
+
+static void enter_binary_split(void *metrics_state, TSNode node) {
+    (void)node;
+    Class_metrics_state *state = metrics_state;
+    for (size_t frame_i = 0; frame_i < state->frame_count; ++frame_i) {
+        state->frames[frame_i].binary_splits++;
+    }
+}
+
+static void enter_methods_block(void *metrics_state, TSNode methods_node) {
+    Class_metrics_state *state = metrics_state;
+    if (state->frame_count == 0) return;
+    int is_static = is_static_methods_block(methods_node, state->source_code);
+    for (size_t frame_i = 0; frame_i < state->frame_count; ++frame_i) {
+        state->frames[frame_i].methods_block_depth++;
+        state->frames[frame_i].static_block_depth += is_static;
+    }
+}
+
+static void leave_methods_block(void *metrics_state, TSNode methods_node) {
+    Class_metrics_state *state = metrics_state;
+    if (state->frame_count == 0) return;
+    int is_static = is_static_methods_block(methods_node, state->source_code);
+    for (size_t frame_i = 0; frame_i < state->frame_count; ++frame_i) {
+        state->frames[frame_i].methods_block_depth--;
+        state->frames[frame_i].static_block_depth -= is_static;
+    }
+}
+
+// returns the id of the first parameter if the method is counted for ATFD and TCC
+static uint32_t counted_self_parameter(Class_metrics_state *state, const Class_frame *frame,
+                                       TSNode method_node) {
+    if (frame->class_name == INTERN_FAILED) return INTERN_FAILED;
+
+    // skip constructor
+    TSNode name_node = ts_node_child_by_field_id(method_node, state->name_field);
+    if (ts_node_is_null(name_node)) return INTERN_FAILED;
+    uint32_t method_name = intern_name(&state->names, get_node_view(name_node, state->source_code));
+    if (method_name == frame->class_name) return INTERN_FAILED;
+
+    String_view self_parameter = extract_first_parameter(method_node, state->source_code);
+    if (!self_parameter.text) return INTERN_FAILED;
+    return intern_name(&state->names, self_parameter);
+}
+
+static void enter_method(void *metrics_state, TSNode method_node) {
+    Class_metrics_state *state = metrics_state;
+    for (size_t frame_i = 0; frame_i < state->frame_count; ++frame_i) {
+        Class_frame *frame = &state->frames[frame_i];
+        frame->method_count++;
+
+        // a frame pushed inside a lost method would be popped in its place
+        if (frame->lost_methods > 0 ||
+            reserve_one(&state->arena, (void **)&frame->methods, frame->method_depth,
+                        &frame->method_capacity, sizeof(Method_frame)) != 0) {
+            frame->lost_methods++;
+            continue;
+        }
+        Method_frame *method = &frame->methods[frame->method_depth++];
+        method->self_parameter = counted_self_parameter(state, frame, method_node);
+        method->tcc_row = -1;
+
+        // only methods of non static method blocks are part of TCC
+        int in_instance_block = frame->methods_block_depth - frame->static_block_depth > 0;
+        if (method->self_parameter == INTERN_FAILED || !in_instance_block) continue;
+
+        size_t capacity = (size_t)frame->tcc_method_capacity;
+        if (reserve_one(&state->arena, (void **)&frame->accessed_properties, (size_t)frame->tcc_method_count,
+                        &capacity, sizeof(Id_list)) != 0) {
+            continue;
+        }
+        frame->tcc_method_capacity = (int)capacity;
+        init_id_list(&frame->accessed_properties[frame->tcc_method_count]);
+        method->tcc_row = frame->tcc_method_count++;
+    }
+}
+
+static void leave_method(void *metrics_state, TSNode method_node) {
+    (void)method_node;
+    Class_metrics_state *state = metrics_state;
+    for (size_t frame_i = 0; frame_i < state->frame_count; ++frame_i) {
+        Class_frame *frame = &state->frames[frame_i];
+        if (frame->lost_methods > 0) {
+            frame->lost_methods--;
+            continue;
+        }
+        if (frame->method_depth == 0) continue;
+        frame->method_depth--;
+    }
+}
+
+static void enter_properties(void *metrics_state, TSNode properties_node) {
+    Class_metrics_state *state = metrics_state;
+    if (state->frame_count == 0) return;
+
+    uint32_t child_count = ts_node_named_child_count(properties_node);
+    for (uint32_t child_i = 0; child_i < child_count; ++child_i) {
+        TSNode property_node = ts_node_named_child(properties_node, child_i);
+        if (strcmp(ts_node_type(property_node), "property") != 0) continue;
+
+        TSNode name_node = ts_node_child_by_field_id(property_node, state->name_field);
+        if (ts_node_is_null(name_node) || strcmp(ts_node_type(name_node), "identifier") != 0) continue;
+
+        uint32_t property = intern_name(&state->names, get_node_view(name_node, state->source_code));
+        if (property == INTERN_FAILED) continue;
+        for (size_t frame_i = 0; frame_i < state->frame_count; ++frame_i) {
+            add_to_id_set(&state->frames[frame_i].properties, property, &state->arena);
+        }
+    }
+}
+
+// one access per identifier field of an identifier object, like the former query
+// (field_expression object: (identifier) field: (identifier))
+static void count_field_access(Class_metrics_state *state, uint32_t object, uint32_t field) {
+    for (size_t frame_i = 0; frame_i < state->frame_count; ++frame_i) {
+        Class_frame *frame = &state->frames[frame_i];
+        for (size_t method_i = 0; method_i < frame->method_depth; ++method_i) {
+            const Method_frame *method = &frame->methods[method_i];
+            if (method->self_parameter == INTERN_FAILED) continue;
+
+            int is_self = object == method->self_parameter;
+            // count as foreign if: object != self AND object != class_name
+            if (!is_self && object != frame->class_name) {
+                frame->foreign_accesses++;
+            }
+            if (is_self && method->tcc_row >= 0) {
+                add_to_id_list(&frame->accessed_properties[method->tcc_row], field, &state->arena);
+            }
+        }
+    }
+}
+
+static void enter_field_expression(void *metrics_state, TSNode node) {
+    Class_metrics_state *state = metrics_state;
+    if (state->frame_count == 0) return;
+
+    TSNode object_node = ts_node_child_by_field_id(node, state->object_field);
+    if (ts_node_is_null(object_node) || strcmp(ts_node_type(object_node), "identifier") != 0) return;
+
+    if (state->has_child_cursor) {
+        ts_tree_cursor_reset(&state->child_cursor, node);
+    } else {
+        state->child_cursor = ts_tree_cursor_new(node);
+        state->has_child_cursor = 1;
+    }
+    if (!ts_tree_cursor_goto_first_child(&state->child_cursor)) return;
+
+    uint32_t object = intern_name(&state->names, get_node_view(object_node, state->source_code));
+    if (object == INTERN_FAILED) return;
+    do {
+        if (ts_tree_cursor_current_field_id(&state->child_cursor) != state->field_field) continue;
+        TSNode field_node = ts_tree_cursor_current_node(&state->child_cursor);
+        if (strcmp(ts_node_type(field_node), "identifier") != 0) continue;
+
+        uint32_t field = intern_name(&state->names, get_node_view(field_node, state->source_code));
+        if (field != INTERN_FAILED) {
+            count_field_access(state, object, field);
+        }
+    } while (ts_tree_cursor_goto_next_sibling(&state->child_cursor));
+}
+
+const Visitor_hook class_metrics_hooks[] = {
+    {"class_definition", enter_class, leave_class},
+    {"methods", enter_methods_block, leave_methods_block},
+    {"function_definition", enter_method, leave_method},
+    {"properties", enter_properties, NULL},
+    {"field_expression", enter_field_expression, NULL},
+    BINARY_SPLIT_HOOKS(enter_binary_split),
+    END_OF_HOOKS
+};
+
+static Tree_visitor *class_visitor = NULL;
+static pthread_once_t class_visitor_once = PTHREAD_ONCE_INIT;
+
+static void create_class_visitor(void) {
+    const Visitor_hook *hook_lists[1] = { class_metrics_hooks };
+    class_visitor = create_tree_visitor(hook_lists, 1);
+}
+
+static void store_metrics(void *context, TSNode class_node, String_view class_name,
+                          const Class_metrics *metrics) {
+    (void)class_node;
+    (void)class_name;
+    Class_metrics *target = context;
+    // the outermost class is left last
+    *target = *metrics;
+}
+
+int compute_class_metrics(TSNode class_node, const char *source_code, Class_metrics *metrics) {
+    pthread_once(&class_visitor_once, create_class_visitor);
+    if (!class_visitor) return -1;
+
+    Class_metrics_state state;
+    memset(&state, 0, sizeof(state));
+    metrics->wmc = 0;
+    metrics->atfd = 0;
+    metrics->tcc = 0.0f;
+
+    begin_class_metrics(&state, source_code, store_metrics, metrics);
+    // walk_tree starts at class_node itself, so the class frame is opened first
+    void *states[1] = { &state };
+    walk_tree(class_visitor, class_node, states);
+    free_class_metrics_state(&state);
+    return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef CLASS_METRICS_H
+#define CLASS_METRICS_H
+
+#include "tree_sitter/api.h"
+#include "tree_visitor.h"
+#include "detector_utils.h"
+#include "arena.h"
+#include "intern_table.h"
+
+#include <stddef.h>
+
+typedef struct {
+    int wmc;
+    int atfd;
+    float tcc;
+} Class_metrics;
+
+// called when a class is left, with all metrics of the class
+typedef void (*Class_callback)(void *context, TSNode class_node,
+                               String_view class_name, const Class_metrics *metrics);
+
+typedef struct Class_frame Class_frame;
+
+/*
+accumulates WMC, ATFD and TCC of every class while the class
+is visited once by the tree visitor. the hooks expect a
+pointer to this state, it can be the first member of a
+bigger detector state.
+names are interned per file and compared by id, everything
+the classes of one file need besides the frames comes from
+the arena. both are reset when the next file begins.
+*/
+typedef struct {
+    const char *source_code;
+    Class_callback on_class;
+    void *context;
+    Class_frame *frames; // classes currently being visited
+    size_t frame_count;
+    size_t frame_capacity;
+    // classes entered without a frame, also the ones inside them, keeps enter/leave balanced
+    size_t lost_frames;
+    TSTreeCursor child_cursor; // reused to iterate children of field expressions of one file
+    int has_child_cursor;
+    TSFieldId object_field;
+    TSFieldId field_field;
+    TSFieldId name_field;
+    Arena arena;
+    Intern_table names;
+} Class_metrics_state;
+
+extern const Visitor_hook class_metrics_hooks[];
+
+// prepares the state for the next file, keeps allocated memory
+// the state has to be zero initialized before the first file
+void begin_class_metrics(Class_metrics_state *state, const char *source_code,
+                         Class_callback on_class, void *context);
+// releases the tree-sitter memory of the file, it may live in the file's tree arena (tree_allocator.h)
+void end_class_metrics(Class_metrics_state *state);
+void free_class_metrics_state(Class_metrics_state *state);
+
+// visits only the subtree of class_node, returns -1 if no metrics could be computed
+int compute_class_metrics(TSNode class_node, const char *source_code, Class_metrics *metrics);
+
+#endif
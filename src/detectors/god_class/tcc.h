@@ -2,7 +2,15 @@
 #define TCC_H
 
 #include "tree_sitter/api.h"
+#include "detector_utils.h"
+#include "arena.h"
+#include "intern_table.h"
 
 float compute_tcc(TSNode class_node, const char *source_code);
 
-#endif
\ No newline at end of file
+// accessed_properties holds the names every counted method accesses through self,
+// names that are no properties are ignored. the access matrix is allocated from the arena
+float compute_tcc_from_accesses(const Id_set *properties, const Id_list *accessed_properties,
+                                int method_count, Arena *arena);
+
+#endif
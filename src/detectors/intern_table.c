@@ -0,0 +1,140 @@
+#include "intern_table.h"
+#include "hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_SLOT_CAPACITY 256
+#define INITIAL_LIST_CAPACITY 8
+
+void init_intern_table(Intern_table *table) {
+    memset(table, 0, sizeof(Intern_table));
+}
+
+void free_intern_table(Intern_table *table) {
+    free(table->slots);
+    free(table->names);
+    free(table->hashes);
+    init_intern_table(table);
+}
+
+void reset_intern_table(Intern_table *table) {
+    if (table->count > 0) {
+        memset(table->slots, 0, table->slot_capacity * sizeof(uint32_t));
+    }
+    table->count = 0;
+}
+
+static uint32_t hash_name(String_view name) {
+    return (uint32_t)hash_bytes(name.text, name.length, 0);
+}
+
+static int grow_slots(Intern_table *table) {
+    uint32_t new_capacity = table->slot_capacity ? table->slot_capacity * 2 : INITIAL_SLOT_CAPACITY;
+    uint32_t *slots = calloc(new_capacity, sizeof(uint32_t));
+    if (!slots) return -1;
+
+    uint32_t mask = new_capacity - 1;
+    for (uint32_t id = 0; id < table->count; ++id) {
+        uint32_t slot_i = table->hashes[id] & mask;
+        while (slots[slot_i]) slot_i = (slot_i + 1) & mask;
+        slots[slot_i] = id + 1;
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->slot_capacity = new_capacity;
+    return 0;
+}
+
+static int grow_names(Intern_table *table) {
+    uint32_t new_capacity = table->name_capacity ? table->name_capacity * 2 : INITIAL_SLOT_CAPACITY / 2;
+    String_view *names = realloc(table->names, new_capacity * sizeof(String_view));
+    if (!names) return -1;
+    table->names = names;
+    uint32_t *hashes = realloc(table->hashes, new_capacity * sizeof(uint32_t));
+    if (!hashes) return -1;
+    table->hashes = hashes;
+    table->name_capacity = new_capacity;
+    return 0;
+}
+
+uint32_t intern_name(Intern_table *table, String_view name) {
+    // keeps the load factor at or below one half
+    if ((table->count + 1) * 2 > table->slot_capacity && grow_slots(table) != 0) {
+        fprintf(stderr, "Failed to allocate memory for intern table.\n");
+        return INTERN_FAILED;
+    }
+
+    uint32_t hash = hash_name(name);
+    uint32_t mask = table->slot_capacity - 1;
+    uint32_t slot_i = hash & mask;
+    while (table->slots[slot_i]) {
+        uint32_t id = table->slots[slot_i] - 1;
+        if (table->hashes[id] == hash && views_equal(table->names[id], name)) return id;
+        slot_i = (slot_i + 1) & mask;
+    }
+
+    if (table->count >= table->name_capacity && grow_names(table) != 0) {
+        fprintf(stderr, "Failed to allocate memory for intern table.\n");
+        return INTERN_FAILED;
+    }
+    uint32_t id = table->count++;
+    table->names[id] = name;
+    table->hashes[id] = hash;
+    table->slots[slot_i] = id + 1;
+    return id;
+}
+
+String_view interned_name(const Intern_table *table, uint32_t id) {
+    return table->names[id];
+}
+
+void init_id_set(Id_set *set) {
+    set->position_of_id = NULL;
+    set->id_capacity = 0;
+    set->count = 0;
+}
+
+int add_to_id_set(Id_set *set, uint32_t id, Arena *arena) {
+    if (id >= set->id_capacity) {
+        uint32_t new_capacity = set->id_capacity ? set->id_capacity : INITIAL_LIST_CAPACITY;
+        while (new_capacity <= id) new_capacity *= 2;
+        int32_t *larger = arena_grow(arena, set->position_of_id, set->id_capacity * sizeof(int32_t),
+                                     new_capacity * sizeof(int32_t));
+        if (!larger) return -1;
+        for (uint32_t id_i = set->id_capacity; id_i < new_capacity; ++id_i) {
+            larger[id_i] = -1;
+        }
+        set->position_of_id = larger;
+        set->id_capacity = new_capacity;
+    }
+    if (set->position_of_id[id] < 0) {
+        set->position_of_id[id] = set->count++;
+    }
+    return set->position_of_id[id];
+}
+
+int id_set_position(const Id_set *set, uint32_t id) {
+    if (id >= set->id_capacity) return -1;
+    return set->position_of_id[id];
+}
+
+void init_id_list(Id_list *list) {
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+int add_to_id_list(Id_list *list, uint32_t id, Arena *arena) {
+    if (list->count >= list->capacity) {
+        int new_capacity = list->capacity ? list->capacity * 2 : INITIAL_LIST_CAPACITY;
+        uint32_t *larger = arena_grow(arena, list->items, list->count * sizeof(uint32_t),
+                                      new_capacity * sizeof(uint32_t));
+        if (!larger) return -1;
+        list->items = larger;
+        list->capacity = new_capacity;
+    }
+    list->items[list->count++] = id;
+    return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef INTERN_TABLE_H
+#define INTERN_TABLE_H
+
+#include "detector_utils.h"
+#include "arena.h"
+
+#include <stdint.h>
+
+/*
+maps identifiers to dense integer ids (0, 1, 2, ...) with an
+open addressing hash table, equal names get equal ids. names
+are views into the source code, so ids are only meaningful
+within one file, reset_intern_table prepares the table for
+the next one and keeps its memory.
+not synchronized, every worker owns its own table.
+*/
+
+#define INTERN_FAILED UINT32_MAX
+
+typedef struct {
+    uint32_t *slots; // id + 1 of the name in this slot, 0 if empty
+    uint32_t slot_capacity;
+    String_view *names; // indexed by id
+    uint32_t *hashes; // indexed by id, reused when the slots grow
+    uint32_t count;
+    uint32_t name_capacity;
+} Intern_table;
+
+void init_intern_table(Intern_table *table);
+void free_intern_table(Intern_table *table);
+void reset_intern_table(Intern_table *table);
+
+// returns INTERN_FAILED if the table couldn't grow
+uint32_t intern_name(Intern_table *table, String_view name);
+String_view interned_name(const Intern_table *table, uint32_t id);
+
+/*
+set of ids that remembers the order they were added in,
+lookups index an array by id, so they cost the same no
+matter how large the set is. the arrays live in the arena
+passed to add_to_id_set.
+*/
+typedef struct {
+    int32_t *position_of_id; // -1 if the id is not in the set
+    uint32_t id_capacity;
+    int count;
+} Id_set;
+
+void init_id_set(Id_set *set);
+// returns the position of the id in the set, -1 if the arena is out of memory
+int add_to_id_set(Id_set *set, uint32_t id, Arena *arena);
+int id_set_position(const Id_set *set, uint32_t id);
+
+typedef struct {
+    uint32_t *items;
+    int count;
+    int capacity;
+} Id_list;
+
+void init_id_list(Id_list *list);
+// returns -1 if the arena is out of memory
+int add_to_id_list(Id_list *list, uint32_t id, Arena *arena);
+
+#endif
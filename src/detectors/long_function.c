@@ -3,9 +3,11 @@
 #include "detector_utils.h"
 #include "filter_utils.h"
 #include "cc.h"
+#include "line_index.h"
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 uint32_t count_LOC(TSNode node) {
     if (ts_node_is_null(node)) return 0;
@@ -15,91 +17,172 @@ uint32_t count_LOC(TSNode node) {
     return LOC;
 }
 
-void detect_long_function_candidates(TSNode root_node, Matlab_file *file, Smell_list *list) {
-    char *file_name = file->file_name;
-
-    const char* query_string = "(function_definition) @function";
-    
-    uint32_t error_offset;
-    TSQueryError error_type;
-    
-    TSQuery* query = ts_query_new(tree_sitter_matlab(), query_string, strlen(query_string),
-                                  &error_offset, &error_type);
-    if (!query) {
-        fprintf(stderr, "find_long_function_candidates: TSQuery error: %d at offset %u\n",
-                error_type, error_offset);
-        return;
-    }
-
-    TSQueryCursor* cursor = ts_query_cursor_new();
-    ts_query_cursor_exec(cursor, query, root_node);
+/*
+metric ids, LOC ranks the candidates first. SLOC counts the lines
+of the function with code, COMMENT_DENSITY is the share of comment
+lines among the lines that aren't blank (line_index.h)
+*/
+enum {
+    LOC_METRIC,
+    CC_METRIC,
+    SLOC_METRIC,
+    COMMENT_DENSITY_METRIC,
+    LONG_FUNCTION_METRIC_COUNT
+};
+
+static const Metric_definition long_function_metrics[LONG_FUNCTION_METRIC_COUNT] = {
+    [LOC_METRIC] = {"LOC", 0},
+    [CC_METRIC] = {"CC", 0},
+    [SLOC_METRIC] = {"SLOC", 0},
+    [COMMENT_DENSITY_METRIC] = {"COMMENT_DENSITY", 1}
+};
+
+#define INITIAL_FRAME_CAPACITY 8
+
+/*
+a function that is currently being visited, its candidate is
+added when entering the function so candidates keep the order
+of the function definitions, CC is filled in when leaving it
+*/
+typedef struct {
+    size_t smell_index;
+    int has_smell;
+    int binary_splits;
+} Function_frame;
+
+typedef struct {
+    const Matlab_file *file;
+    Smell_list *list;
+    Function_frame *frames;
+    size_t frame_count;
+    size_t frame_capacity;
+    // functions entered while no frame could be allocated, keeps enter/leave balanced
+    size_t lost_frames;
+    // built for the first function of a file, files without functions never scan their lines
+    Line_index lines;
+    int lines_indexed; // 1 once built for the current file, -1 if building failed
+} Long_function_state;
+
+static void begin_long_function_file(void *state, const Matlab_file *file, Smell_list *list) {
+    Long_function_state *function_state = state;
+    function_state->file = file;
+    function_state->list = list;
+    function_state->frame_count = 0;
+    function_state->lost_frames = 0;
+    function_state->lines_indexed = 0;
+}
 
-    TSQueryMatch match;
+static void set_line_metrics(Long_function_state *function_state, size_t candidate, TSNode function_node) {
+    if (function_state->lines_indexed == 0) {
+        const Matlab_file *file = function_state->file;
+        int built = build_line_index(&function_state->lines, file->content, file->length) == 0;
+        if (!built) fprintf(stderr, "Failed to index the lines of %s.\n", file->file_name);
+        function_state->lines_indexed = built ? 1 : -1;
+    }
+    if (function_state->lines_indexed < 0) return;
+
+    uint32_t first_row = ts_node_start_point(function_node).row;
+    uint32_t last_row = ts_node_end_point(function_node).row;
+    uint32_t code_lines = count_code_lines(&function_state->lines, first_row, last_row);
+    uint32_t comment_lines = count_comment_lines(&function_state->lines, first_row, last_row);
+    Smell_list *list = function_state->list;
+    set_int_metric(list, candidate, SLOC_METRIC, (int32_t)code_lines);
+    if (code_lines + comment_lines > 0) {
+        set_float_metric(list, candidate, COMMENT_DENSITY_METRIC,
+                         (float)comment_lines / (float)(code_lines + comment_lines));
+    }
+}
 
-    while (ts_query_cursor_next_match(cursor, &match)) {
-        TSNode function_node = match.captures[0].node;
+static void enter_function(void *state, TSNode function_node) {
+    Long_function_state *function_state = state;
+    Smell_list *list = function_state->list;
+
+    if (function_state->frame_count >= function_state->frame_capacity) {
+        size_t new_capacity = function_state->frame_capacity ? function_state->frame_capacity * 2
+                                                             : INITIAL_FRAME_CAPACITY;
+        Function_frame *larger = realloc(function_state->frames, new_capacity * sizeof(Function_frame));
+        if (!larger) {
+            fprintf(stderr, "Failed to allocate memory for function frames.\n");
+            function_state->lost_frames++;
+            return;
+        }
+        function_state->frames = larger;
+        function_state->frame_capacity = new_capacity;
+    }
 
-        
-        TSPoint start = ts_node_start_point(function_node);
+    Function_frame *frame = &function_state->frames[function_state->frame_count++];
+    frame->has_smell = 0;
+    frame->binary_splits = 0;
 
-        Smell_location location = create_location(file_name, start.row + 1);
-        Smell *candidate = create_smell(location);
-        if (!candidate) continue;
+    TSPoint start = ts_node_start_point(function_node);
+    Smell_location location = create_location(function_state->file->file_name, start.row + 1);
+    size_t candidate = add_smell(list, location);
+    if (candidate == SMELL_NOT_ADDED) return;
 
-        uint32_t LOC = count_LOC(function_node);
-        Metric LOC_metric = create_int_metric("LOC", LOC);
-        add_metric(candidate, LOC_metric);
+    set_int_metric(list, candidate, LOC_METRIC, count_LOC(function_node));
+    // binary splits are counted while the function body is visited
+    set_int_metric(list, candidate, CC_METRIC, 1);
+    set_line_metrics(function_state, candidate, function_node);
 
-        int CC = count_binary_splits(function_node) + 1;
-        Metric CC_metric = create_int_metric("CC", CC);
-        add_metric(candidate, CC_metric);
+    frame->smell_index = candidate;
+    frame->has_smell = 1;
+}
 
-        add_smell_to_list(list, *candidate);
-        free(candidate);
+static void leave_function(void *state, TSNode function_node) {
+    (void)function_node;
+    Long_function_state *function_state = state;
+    if (function_state->lost_frames > 0) {
+        function_state->lost_frames--;
+        return;
     }
+    if (function_state->frame_count == 0) return;
 
-    ts_query_cursor_delete(cursor);
-    ts_query_delete(query);
+    Function_frame *frame = &function_state->frames[--function_state->frame_count];
+    if (!frame->has_smell) return;
+    set_int_metric(function_state->list, frame->smell_index, CC_METRIC, frame->binary_splits + 1);
 }
 
-// don't know where this function belongs best
-// exists here and in god_class.c
-// TODO: find common place
-static Configuration* get_config_by_name(Smell_detector *detector, const char *name) {
-    for (size_t config_i = 0; config_i < detector->config_count; ++config_i) {
-        if (strcmp(detector->configs[config_i].name, name) == 0) {
-            return &detector->configs[config_i];
-        }
+static void enter_binary_split(void *state, TSNode node) {
+    (void)node;
+    Long_function_state *function_state = state;
+    // splits of nested functions also count for the enclosing ones
+    for (size_t frame_i = 0; frame_i < function_state->frame_count; ++frame_i) {
+        function_state->frames[frame_i].binary_splits++;
     }
-    return NULL;
 }
 
-void filter_long_function_candidates(Smell_detector *detector) {
-    size_t total_count = detector->smell_list->count;
-    
-    Configuration *LOC_config = get_config_by_name(detector, "LOC");
-    sort_smell_list_by_metric(detector->smell_list, "LOC", 0);
-    if (LOC_config->use_percentage) { 
-        cut_smell_list_relative(detector->smell_list, total_count, LOC_config->percentage_value);
-    } else {
-        threshold_value threshold = {.int_value = LOC_config->absolute_value.int_absolute};
-        cut_smell_list_absolute(detector->smell_list, "LOC", threshold, 0);
-    }
-    
-    Configuration *CC_config = get_config_by_name(detector, "CC");
-    sort_smell_list_by_metric(detector->smell_list, "CC", 0);
-    if (CC_config->use_percentage) { 
-        cut_smell_list_relative(detector->smell_list, total_count, CC_config->percentage_value);
-    } else {
-        threshold_value threshold = {.int_value = CC_config->absolute_value.int_absolute};
-        cut_smell_list_absolute(detector->smell_list, "CC", threshold, 0);
-    }
+static void free_long_function_state(void *state) {
+    Long_function_state *function_state = state;
+    free(function_state->frames);
+    free_line_index(&function_state->lines);
 }
 
+static const Visitor_hook long_function_hooks[] = {
+    {"function_definition", enter_function, leave_function},
+    BINARY_SPLIT_HOOKS(enter_binary_split),
+    END_OF_HOOKS
+};
+
+static const Filter_step long_function_filter[] = {
+    {LOC_METRIC, 0},
+    {CC_METRIC, 0}
+};
+
+// every function_definition starts with the keyword
+static const char *const long_function_keywords[] = { "function", NULL };
+
 Smell_detector long_function_detector = {
     .name = "long_function",
-    .detect_candidates = detect_long_function_candidates,
-    .filter = filter_long_function_candidates,
+    .version = 2,
+    .metrics = long_function_metrics,
+    .metric_count = LONG_FUNCTION_METRIC_COUNT,
+    .hooks = long_function_hooks,
+    .keywords = long_function_keywords,
+    .state_size = sizeof(Long_function_state),
+    .begin_file = begin_long_function_file,
+    .free_state = free_long_function_state,
+    .filter_steps = long_function_filter,
+    .filter_step_count = sizeof(long_function_filter) / sizeof(Filter_step),
     .configs = {
         {
         .name = "LOC",
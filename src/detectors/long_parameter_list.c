@@ -5,67 +5,66 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
+// metric ids
+enum {
+    NUMBER_PARAMETER_METRIC,
+    LONG_PARAMETER_LIST_METRIC_COUNT
+};
 
-void find_long_parameter_list_candidates(TSNode root_node, Matlab_file *file, Smell_list *list) {
+static const Metric_definition long_parameter_list_metrics[LONG_PARAMETER_LIST_METRIC_COUNT] = {
+    [NUMBER_PARAMETER_METRIC] = {"NUMBER_PARAMETER", 0}
+};
 
-    char *file_name = file->file_name;
+typedef struct {
+    const Matlab_file *file;
+    Smell_list *list;
+} Long_parameter_list_state;
 
-    const char *query_string = "(function_arguments) @params";
-
-    TSQueryError error_type;
-    uint32_t error_offset;
-
-    TSQuery *query = ts_query_new(tree_sitter_matlab(), query_string, strlen(query_string),
-                                  &error_offset, &error_type);
-    if (!query) {
-        fprintf(stderr, "find_long_parameter_list_candidates: TSQuery error: %d at offset %u\n",
-                error_type, error_offset);
-        return;
-    }
-
-    TSQueryCursor *query_cursor = ts_query_cursor_new();
-    ts_query_cursor_exec(query_cursor, query, root_node);
+static void begin_long_parameter_list_file(void *state, const Matlab_file *file, Smell_list *list) {
+    Long_parameter_list_state *parameter_state = state;
+    parameter_state->file = file;
+    parameter_state->list = list;
+}
 
-    TSQueryMatch match;
+static void enter_function_arguments(void *state, TSNode params) {
+    Long_parameter_list_state *parameter_state = state;
 
-    while (ts_query_cursor_next_match(query_cursor, &match)) {
-        TSNode params = match.captures[0].node;
+    uint32_t parameter_count = ts_node_named_child_count(params);
+    Smell_location location = create_location(parameter_state->file->file_name,
+                                                ts_node_start_point(params).row + 1);
+    size_t candidate = add_smell(parameter_state->list, location);
+    if (candidate == SMELL_NOT_ADDED) return;
 
-        uint32_t parameter_count = ts_node_named_child_count(params);
-        Smell_location location = create_location(file_name,
-                                                    ts_node_start_point(params).row + 1);
-        Smell *candidate = create_smell(location);
-        if (!candidate) continue;
+    set_int_metric(parameter_state->list, candidate, NUMBER_PARAMETER_METRIC, parameter_count);
+}
 
-        Metric metric = create_int_metric("NUMBER_PARAMETER", parameter_count);
-        add_metric(candidate, metric);
-        add_smell_to_list(list, *candidate);
-        free(candidate);
-    }
+static const Visitor_hook long_parameter_list_hooks[] = {
+    {"function_arguments", enter_function_arguments, NULL},
+    END_OF_HOOKS
+};
 
-    ts_query_cursor_delete(query_cursor);
-    ts_query_delete(query);
-}
+static const Filter_step long_parameter_list_filter[] = {
+    {NUMBER_PARAMETER_METRIC, 0}
+};
 
-void filter_long_parameter_list_candidates(Smell_detector *detector) {
-    size_t total_count = detector->smell_list->count;
-    Configuration config = detector->configs[0];
-    
-    sort_smell_list_by_metric(detector->smell_list, "NUMBER_PARAMETER", 0);
-    if (config.use_percentage) { 
-        cut_smell_list_relative(detector->smell_list, total_count, config.percentage_value);
-    } else {
-        threshold_value threshold = {.int_value = config.absolute_value.int_absolute};
-        cut_smell_list_absolute(detector->smell_list, "NUMBER_PARAMETER", threshold, 0);
-    }
-}
+// parameter lists belong to functions, "@" keeps the files with anonymous functions as well
+static const char *const long_parameter_list_keywords[] = { "function", "@", NULL };
 
 Smell_detector long_parameter_list_detector = {
     .name = "long_parameter_list",
-    .detect_candidates = find_long_parameter_list_candidates,
-    .filter = filter_long_parameter_list_candidates,
+    .version = 1,
+    .metrics = long_parameter_list_metrics,
+    .metric_count = LONG_PARAMETER_LIST_METRIC_COUNT,
+    .hooks = long_parameter_list_hooks,
+    .keywords = long_parameter_list_keywords,
+    .state_size = sizeof(Long_parameter_list_state),
+    .begin_file = begin_long_parameter_list_file,
+    .filter_steps = long_parameter_list_filter,
+    .filter_step_count = sizeof(long_parameter_list_filter) / sizeof(Filter_step),
     .configs[0] = {
+        .name = "NUMBER_PARAMETER",
         .key_absolute = "absolute_param_count",
         .key_percentage = "top_percentage_param_count",
         .key_use_percentage = "use_percentage",
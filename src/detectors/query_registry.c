@@ -0,0 +1,59 @@
+#include "query_registry.h"
+
+#include <stdio.h>
+#include <string.h>
+
+extern TSLanguage *tree_sitter_matlab(void);
+
+typedef struct {
+    const char *name;
+    const char *source;
+} Query_source;
+
+// indexed by Query_id
+static const Query_source query_sources[QUERY_COUNT] = {
+    [QUERY_FUNCTION_DEFINITION] = {"function_definition", "(function_definition) @function"},
+    [QUERY_BINARY_SPLITS] = {"binary_splits",
+        "["
+        "  (if_statement)"
+        "  (elseif_clause)"
+        "  (while_statement)"
+        "  (for_statement)"
+        "  (switch_statement)"
+        "  (case_clause)"
+        "  (try_statement)"
+        "] @split"}
+};
+
+static TSQuery *queries[QUERY_COUNT];
+
+int compile_queries(void) {
+    for (int query_i = 0; query_i < QUERY_COUNT; ++query_i) {
+        const Query_source *query_source = &query_sources[query_i];
+        uint32_t error_offset;
+        TSQueryError error_type;
+
+        queries[query_i] = ts_query_new(tree_sitter_matlab(), query_source->source,
+                                        strlen(query_source->source), &error_offset, &error_type);
+        if (!queries[query_i]) {
+            fprintf(stderr, "Query %s: TSQuery error: %d at offset %u\n",
+                    query_source->name, error_type, error_offset);
+            free_queries();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+const TSQuery *get_query(Query_id id) {
+    return queries[id];
+}
+
+void free_queries(void) {
+    for (int query_i = 0; query_i < QUERY_COUNT; ++query_i) {
+        if (queries[query_i]) {
+            ts_query_delete(queries[query_i]);
+            queries[query_i] = NULL;
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef QUERY_REGISTRY_H
+#define QUERY_REGISTRY_H
+
+#include "tree_sitter/api.h"
+
+/*
+queries used by the subtree utilities (count_methods,
+count_binary_splits), the detectors themselves run on the
+tree visitor. they are compiled once by compile_queries() at
+startup and are immutable afterwards, so the handles can be
+shared between worker threads (every thread still needs its
+own TSQueryCursor).
+*/
+typedef enum {
+    QUERY_FUNCTION_DEFINITION,
+    QUERY_BINARY_SPLITS,
+    QUERY_COUNT
+} Query_id;
+
+// returns -1 if any query fails to compile, the error is printed
+int compile_queries(void);
+const TSQuery *get_query(Query_id id);
+void free_queries(void);
+
+#endif
@@ -0,0 +1,151 @@
+#include "tree_visitor.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern TSLanguage *tree_sitter_matlab(void);
+
+typedef struct {
+    const Visitor_hook *hook;
+    size_t list_i;
+} Hook_binding;
+
+struct Tree_visitor {
+    uint32_t symbol_count;
+    // bindings of symbol s are bindings[first_binding[s]] up to bindings[first_binding[s + 1]]
+    uint32_t *first_binding;
+    Hook_binding *bindings;
+};
+
+// a node type can belong to several symbols (aliases), every named one gets the hook
+static int symbol_matches(const TSLanguage *language, TSSymbol symbol, const char *node_type) {
+    if (ts_language_symbol_type(language, symbol) != TSSymbolTypeRegular) return 0;
+    const char *name = ts_language_symbol_name(language, symbol);
+    return name && strcmp(name, node_type) == 0;
+}
+
+Tree_visitor *create_tree_visitor(const Visitor_hook *const *hook_lists, size_t list_count) {
+    const TSLanguage *language = tree_sitter_matlab();
+    uint32_t symbol_count = ts_language_symbol_count(language);
+
+    Tree_visitor *visitor = malloc(sizeof(Tree_visitor));
+    if (!visitor) return NULL;
+    visitor->symbol_count = symbol_count;
+    visitor->first_binding = calloc(symbol_count + 1, sizeof(uint32_t));
+    visitor->bindings = NULL;
+    if (!visitor->first_binding) {
+        free(visitor);
+        return NULL;
+    }
+
+    // first pass counts the bindings per symbol, second pass fills them in
+    for (TSSymbol symbol = 0; symbol < symbol_count; ++symbol) {
+        for (size_t list_i = 0; list_i < list_count; ++list_i) {
+            for (const Visitor_hook *hook = hook_lists[list_i]; hook->node_type; ++hook) {
+                if (symbol_matches(language, symbol, hook->node_type)) {
+                    visitor->first_binding[symbol + 1]++;
+                }
+            }
+        }
+    }
+    for (uint32_t symbol = 0; symbol < symbol_count; ++symbol) {
+        visitor->first_binding[symbol + 1] += visitor->first_binding[symbol];
+    }
+
+    uint32_t binding_count = visitor->first_binding[symbol_count];
+    if (binding_count > 0) {
+        visitor->bindings = malloc(binding_count * sizeof(Hook_binding));
+        if (!visitor->bindings) {
+            free_tree_visitor(visitor);
+            return NULL;
+        }
+    }
+
+    for (TSSymbol symbol = 0; symbol < symbol_count; ++symbol) {
+        uint32_t binding_i = visitor->first_binding[symbol];
+        for (size_t list_i = 0; list_i < list_count; ++list_i) {
+            for (const Visitor_hook *hook = hook_lists[list_i]; hook->node_type; ++hook) {
+                if (symbol_matches(language, symbol, hook->node_type)) {
+                    visitor->bindings[binding_i].hook = hook;
+                    visitor->bindings[binding_i].list_i = list_i;
+                    binding_i++;
+                }
+            }
+        }
+    }
+
+    // every hook should match at least one symbol, otherwise the node type is misspelled
+    for (size_t list_i = 0; list_i < list_count; ++list_i) {
+        for (const Visitor_hook *hook = hook_lists[list_i]; hook->node_type; ++hook) {
+            const char *node_type = hook->node_type;
+            int found = 0;
+            for (TSSymbol symbol = 0; symbol < symbol_count && !found; ++symbol) {
+                found = symbol_matches(language, symbol, node_type);
+            }
+            if (!found) {
+                fprintf(stderr, "Tree visitor: unknown node type %s.\n", node_type);
+                free_tree_visitor(visitor);
+                return NULL;
+            }
+        }
+    }
+    return visitor;
+}
+
+void free_tree_visitor(Tree_visitor *visitor) {
+    if (!visitor) return;
+    free(visitor->bindings);
+    free(visitor->first_binding);
+    free(visitor);
+}
+
+// list_times is NULL unless the callbacks are timed (walk_tree_timed)
+static void dispatch(const Tree_visitor *visitor, TSNode node, void *const *states, int is_enter,
+                     uint64_t *list_times) {
+    TSSymbol symbol = ts_node_symbol(node);
+    if (symbol >= visitor->symbol_count) return;
+
+    uint32_t end = visitor->first_binding[symbol + 1];
+    for (uint32_t binding_i = visitor->first_binding[symbol]; binding_i < end; ++binding_i) {
+        const Hook_binding *binding = &visitor->bindings[binding_i];
+        Visit_callback callback = is_enter ? binding->hook->enter : binding->hook->leave;
+        if (!callback) continue;
+        if (list_times) {
+            uint64_t begin = trace_now();
+            callback(states[binding->list_i], node);
+            list_times[binding->list_i] += trace_now() - begin;
+        } else {
+            callback(states[binding->list_i], node);
+        }
+    }
+}
+
+static void walk(const Tree_visitor *visitor, TSNode root, void *const *states, uint64_t *list_times) {
+    if (ts_node_is_null(root)) return;
+
+    TSTreeCursor cursor = ts_tree_cursor_new(root);
+    for (;;) {
+        dispatch(visitor, ts_tree_cursor_current_node(&cursor), states, 1, list_times);
+        if (ts_tree_cursor_goto_first_child(&cursor)) continue;
+
+        // no children left: leave nodes until one has a next sibling
+        for (;;) {
+            dispatch(visitor, ts_tree_cursor_current_node(&cursor), states, 0, list_times);
+            if (ts_tree_cursor_goto_next_sibling(&cursor)) break;
+            if (!ts_tree_cursor_goto_parent(&cursor)) {
+                ts_tree_cursor_delete(&cursor);
+                return;
+            }
+        }
+    }
+}
+
+void walk_tree(const Tree_visitor *visitor, TSNode root, void *const *states) {
+    walk(visitor, root, states, NULL);
+}
+
+void walk_tree_timed(const Tree_visitor *visitor, TSNode root, void *const *states, uint64_t *list_times) {
+    walk(visitor, root, states, list_times);
+}
@@ -0,0 +1,42 @@
+#ifndef TREE_VISITOR_H
+#define TREE_VISITOR_H
+
+#include "tree_sitter/api.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+single pass traversal of a syntax tree. a visitor is built
+once from several hook lists (one per detector), every hook
+is keyed by a node type and gets enter/leave events for all
+nodes of that type. walk_tree visits every node exactly once
+with a TSTreeCursor and dispatches through a table indexed by
+the node symbol, so the cost per file is O(nodes) no matter
+how many detectors are registered.
+a built visitor is immutable and can be shared between threads.
+*/
+
+typedef void (*Visit_callback)(void *state, TSNode node);
+
+// hook lists end with an entry whose node_type is NULL
+typedef struct {
+    const char *node_type;
+    Visit_callback enter; // may be NULL
+    Visit_callback leave; // may be NULL
+} Visitor_hook;
+
+#define END_OF_HOOKS {NULL, NULL, NULL}
+
+typedef struct Tree_visitor Tree_visitor;
+
+Tree_visitor *create_tree_visitor(const Visitor_hook *const *hook_lists, size_t list_count);
+void free_tree_visitor(Tree_visitor *visitor);
+
+// states[i] is passed to the callbacks of hook_lists[i]
+void walk_tree(const Tree_visitor *visitor, TSNode root, void *const *states);
+
+// like walk_tree, adds the nanoseconds spent in the callbacks of hook_lists[i] to list_times[i]
+void walk_tree_timed(const Tree_visitor *visitor, TSNode root, void *const *states, uint64_t *list_times);
+
+#endif
@@ -0,0 +1,506 @@
+// syscall() is not part of POSIX
+#define _DEFAULT_SOURCE
+#include "directory_walker.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "hash.h"
+
+// bytes of directory entries fetched per getdents64 call
+#define DIRENT_BUFFER_SIZE (64 * 1024)
+#define INITIAL_ENTRY_CAPACITY 16
+#define INITIAL_NAMES_CAPACITY 256
+
+// the record getdents64 fills in, glibc doesn't declare it
+typedef struct {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} Linux_dirent64;
+
+typedef struct Directory Directory;
+
+typedef struct {
+    size_t name_offset;
+    Directory *directory; // NULL for .m files
+    int is_directory;
+} Entry;
+
+/*
+a directory below the walked path. it is owned by the entry of
+its parent, the walker threads fill it in and the calling thread
+frees it once its files were passed to the callback.
+*/
+struct Directory {
+    Directory *parent;
+    Directory *next_pending;
+    char *path; // relative to the walked path
+    size_t path_length;
+    size_t depth;
+    Pattern_set *gitignore; // NULL if the filter doesn't read .gitignore files or there is none
+    dev_t device;
+    ino_t inode;
+    int listed;
+    Entry *entries;
+    size_t entry_count;
+    size_t entry_capacity;
+    char *names;
+    size_t names_length;
+    size_t names_capacity;
+};
+
+typedef struct {
+    const char *root_path;
+    int root_fd;
+    size_t max_depth;
+    const Path_filter *filter; // NULL if nothing is excluded
+    size_t shard_index;
+    size_t shard_count; // 1 if every file is visited
+    pthread_mutex_t mutex;
+    pthread_cond_t changed; // a directory was listed or the walk stopped
+    Directory *pending; // stack, so the threads stay close to the order of the callbacks
+    size_t unlisted_count; // pending or being listed
+    int stopped;
+} Walker;
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} Path_buffer;
+
+static int has_m_extension(const char *file_name) {
+    const char *file_extension = strrchr(file_name, '.');
+    return file_extension && strcmp(file_extension, ".m") == 0;
+}
+
+static int is_dot_entry(const char *name) {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+static Directory *create_directory(Directory *parent, const char *path) {
+    Directory *directory = calloc(1, sizeof(Directory));
+    if (!directory) return NULL;
+    size_t length = strlen(path);
+    directory->path = malloc(length + 1);
+    if (!directory->path) {
+        free(directory);
+        return NULL;
+    }
+    memcpy(directory->path, path, length + 1);
+    directory->path_length = length;
+    directory->parent = parent;
+    directory->depth = parent ? parent->depth + 1 : 0;
+    return directory;
+}
+
+static void free_directory(Directory *directory) {
+    if (!directory) return;
+    for (size_t entry_i = 0; entry_i < directory->entry_count; ++entry_i) {
+        free_directory(directory->entries[entry_i].directory);
+    }
+    if (directory->gitignore) {
+        free_pattern_set(directory->gitignore);
+        free(directory->gitignore);
+    }
+    free(directory->entries);
+    free(directory->names);
+    free(directory->path);
+    free(directory);
+}
+
+static int add_entry(Directory *directory, const char *name, int is_directory) {
+    if (directory->entry_count >= directory->entry_capacity) {
+        size_t new_capacity = directory->entry_capacity ? directory->entry_capacity * 2 : INITIAL_ENTRY_CAPACITY;
+        Entry *larger = realloc(directory->entries, new_capacity * sizeof(Entry));
+        if (!larger) return -1;
+        directory->entries = larger;
+        directory->entry_capacity = new_capacity;
+    }
+    size_t length = strlen(name) + 1;
+    if (directory->names_length + length > directory->names_capacity) {
+        size_t new_capacity = directory->names_capacity ? directory->names_capacity : INITIAL_NAMES_CAPACITY;
+        while (new_capacity < directory->names_length + length) new_capacity *= 2;
+        char *larger = realloc(directory->names, new_capacity);
+        if (!larger) return -1;
+        directory->names = larger;
+        directory->names_capacity = new_capacity;
+    }
+    memcpy(directory->names + directory->names_length, name, length);
+    directory->entries[directory->entry_count++] = (Entry){ directory->names_length, NULL, is_directory };
+    directory->names_length += length;
+    return 0;
+}
+
+// path of an entry relative to the walked path, the root is "." but its entries have no "./" prefix
+static int set_entry_path(Path_buffer *path, const Directory *directory, const char *name) {
+    size_t parent_length = directory->parent ? directory->path_length + 1 : 0;
+    size_t name_length = strlen(name);
+    if (parent_length + name_length + 1 > path->capacity) {
+        size_t new_capacity = path->capacity ? path->capacity : INITIAL_NAMES_CAPACITY;
+        while (new_capacity < parent_length + name_length + 1) new_capacity *= 2;
+        char *larger = realloc(path->data, new_capacity);
+        if (!larger) return -1;
+        path->data = larger;
+        path->capacity = new_capacity;
+    }
+    if (parent_length) {
+        memcpy(path->data, directory->path, parent_length - 1);
+        path->data[parent_length - 1] = '/';
+    }
+    memcpy(path->data + parent_length, name, name_length + 1);
+    path->length = parent_length + name_length;
+    return 0;
+}
+
+// --exclude first, then the .gitignore files from the innermost directory outwards, then --include
+static int is_excluded(const Walker *walker, const Directory *directory, const char *path,
+                       const char *name, int is_directory) {
+    const Path_filter *filter = walker->filter;
+    int match = match_pattern_set(&filter->excludes, path, name, is_directory);
+    for (const Directory *owner = directory; !match && owner; owner = owner->parent) {
+        if (!owner->gitignore) continue;
+        const char *owner_path = owner->parent ? path + owner->path_length + 1 : path;
+        match = match_pattern_set(owner->gitignore, owner_path, name, is_directory);
+    }
+    if (match) return match > 0;
+    if (is_directory || filter->includes.count == 0) return 0;
+    return match_pattern_set(&filter->includes, path, name, 0) <= 0;
+}
+
+// the shard of a file only depends on its path relative to the walked path, so every run assigns it the same way
+static int in_shard(const Walker *walker, const char *path, size_t length) {
+    return hash_bytes(path, length, 0) % walker->shard_count == walker->shard_index;
+}
+
+static Pattern_set *read_gitignore(const Walker *walker, const Directory *directory, int directory_fd) {
+    int fd = openat(directory_fd, ".gitignore", O_RDONLY | O_CLOEXEC);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+
+    size_t length = (size_t)file_stat.st_size;
+    char *content = malloc(length ? length : 1);
+    Pattern_set *set = malloc(sizeof(Pattern_set));
+    size_t offset = 0;
+    while (content && offset < length) {
+        ssize_t bytes_read = read(fd, content + offset, length - offset);
+        if (bytes_read < 0 && errno == EINTR) continue;
+        if (bytes_read <= 0) break;
+        offset += (size_t)bytes_read;
+    }
+    close(fd);
+
+    if (set) init_pattern_set(set);
+    if (!content || !set || add_pattern_lines(set, content, offset) != 0) {
+        fprintf(stderr, "Failed to read %s/%s/.gitignore.\n", walker->root_path, directory->path);
+        if (set) free_pattern_set(set);
+        free(set);
+        set = NULL;
+    }
+    free(content);
+    return set;
+}
+
+/*
+drops the excluded entries and creates the subdirectories of the
+rest. runs after the whole directory was read, so its own .gitignore
+applies to all of its entries.
+*/
+static int filter_entries(Walker *walker, Directory *directory) {
+    Path_buffer path = { NULL, 0, 0 };
+    size_t kept_count = 0;
+    int result = 0;
+    for (size_t entry_i = 0; entry_i < directory->entry_count; ++entry_i) {
+        Entry entry = directory->entries[entry_i];
+        const char *name = directory->names + entry.name_offset;
+        if (walker->filter || walker->shard_count > 1 || entry.is_directory) {
+            if (set_entry_path(&path, directory, name) != 0) {
+                result = -1;
+                break;
+            }
+        }
+        if (walker->filter && is_excluded(walker, directory, path.data, name, entry.is_directory)) continue;
+        if (!entry.is_directory && walker->shard_count > 1 && !in_shard(walker, path.data, path.length)) continue;
+        if (entry.is_directory) {
+            entry.directory = create_directory(directory, path.data);
+            if (!entry.directory) {
+                result = -1;
+                break;
+            }
+        }
+        directory->entries[kept_count++] = entry;
+    }
+    directory->entry_count = kept_count;
+    free(path.data);
+    return result;
+}
+
+// qsort has no context argument, so the names are compared through this thread's directory
+static _Thread_local const char *sorted_names;
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(sorted_names + ((const Entry *)a)->name_offset,
+                  sorted_names + ((const Entry *)b)->name_offset);
+}
+
+// adds the .m files and subdirectories of directory, errors only skip (part of) the directory
+static void list_directory(Walker *walker, Directory *directory, char *buffer) {
+    int fd = openat(walker->root_fd, directory->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open directory %s/%s: %s\n", walker->root_path, directory->path, strerror(errno));
+        return;
+    }
+
+    struct stat directory_stat;
+    if (fstat(fd, &directory_stat) != 0) {
+        fprintf(stderr, "Failed to stat directory %s/%s: %s\n", walker->root_path, directory->path, strerror(errno));
+        close(fd);
+        return;
+    }
+    // the parents stay alive until all their subdirectories are listed
+    for (const Directory *parent = directory->parent; parent; parent = parent->parent) {
+        if (parent->device == directory_stat.st_dev && parent->inode == directory_stat.st_ino) {
+            fprintf(stderr, "Skipping directory %s/%s, it links back to %s%s%s.\n",
+                    walker->root_path, directory->path, walker->root_path,
+                    parent->parent ? "/" : "", parent->parent ? parent->path : "");
+            close(fd);
+            return;
+        }
+    }
+    directory->device = directory_stat.st_dev;
+    directory->inode = directory_stat.st_ino;
+    int enter_subdirectories = directory->depth < walker->max_depth;
+    int has_gitignore = 0;
+
+    while (1) {
+        long bytes_read = syscall(SYS_getdents64, fd, buffer, DIRENT_BUFFER_SIZE);
+        if (bytes_read < 0 && errno == EINTR) continue;
+        if (bytes_read < 0) {
+            fprintf(stderr, "Failed to read directory %s/%s: %s\n", walker->root_path, directory->path, strerror(errno));
+            break;
+        }
+        if (bytes_read == 0) break;
+
+        for (long offset = 0; offset < bytes_read;) {
+            const Linux_dirent64 *dirent = (const Linux_dirent64 *)(buffer + offset);
+            offset += dirent->d_reclen;
+            const char *name = dirent->d_name;
+            if (is_dot_entry(name)) continue;
+
+            unsigned char type = dirent->d_type;
+            if (type == DT_LNK || type == DT_UNKNOWN) {
+                // links are followed, some file systems (e.g. older NFS servers) report no type at all
+                struct stat entry_stat;
+                if (fstatat(fd, name, &entry_stat, 0) != 0) continue;
+                type = S_ISDIR(entry_stat.st_mode) ? DT_DIR : S_ISREG(entry_stat.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+
+            if (type == DT_REG && strcmp(name, ".gitignore") == 0) has_gitignore = 1;
+
+            int result = 0;
+            if (type == DT_DIR && enter_subdirectories) {
+                result = add_entry(directory, name, 1);
+            } else if (type == DT_REG && has_m_extension(name)) {
+                result = add_entry(directory, name, 0);
+            }
+            if (result != 0) {
+                fprintf(stderr, "Failed to allocate memory for directory %s/%s.\n", walker->root_path, directory->path);
+                directory->entry_count = 0;
+                close(fd);
+                return;
+            }
+        }
+    }
+
+    if (has_gitignore && walker->filter && walker->filter->read_gitignore) {
+        directory->gitignore = read_gitignore(walker, directory, fd);
+    }
+    close(fd);
+    if (filter_entries(walker, directory) != 0) {
+        fprintf(stderr, "Failed to allocate memory for directory %s/%s.\n", walker->root_path, directory->path);
+    }
+
+    if (directory->entry_count > 1) {
+        sorted_names = directory->names;
+        qsort(directory->entries, directory->entry_count, sizeof(Entry), compare_entries);
+    }
+}
+
+static void *run_walker(void *argument) {
+    Walker *walker = argument;
+    // getdents64 records are 8 byte aligned
+    _Alignas(uint64_t) char buffer[DIRENT_BUFFER_SIZE];
+
+    pthread_mutex_lock(&walker->mutex);
+    while (1) {
+        while (!walker->pending && walker->unlisted_count > 0) {
+            pthread_cond_wait(&walker->changed, &walker->mutex);
+        }
+        Directory *directory = walker->pending;
+        if (!directory) break;
+        walker->pending = directory->next_pending;
+        int stopped = walker->stopped;
+        pthread_mutex_unlock(&walker->mutex);
+
+        if (!stopped) list_directory(walker, directory, buffer);
+
+        pthread_mutex_lock(&walker->mutex);
+        // pushed in reverse, so the first subdirectory is listed next
+        for (size_t entry_i = directory->entry_count; entry_i-- > 0;) {
+            Directory *subdirectory = directory->entries[entry_i].directory;
+            if (!subdirectory) continue;
+            subdirectory->next_pending = walker->pending;
+            walker->pending = subdirectory;
+            ++walker->unlisted_count;
+        }
+        // the calling thread may free the directory from here on
+        directory->listed = 1;
+        --walker->unlisted_count;
+        pthread_cond_broadcast(&walker->changed);
+    }
+    pthread_mutex_unlock(&walker->mutex);
+    return NULL;
+}
+
+static int append_to_path(Path_buffer *path, const char *name) {
+    size_t length = strlen(name);
+    if (path->length + length + 2 > path->capacity) {
+        size_t new_capacity = path->capacity ? path->capacity : INITIAL_NAMES_CAPACITY;
+        while (new_capacity < path->length + length + 2) new_capacity *= 2;
+        char *larger = realloc(path->data, new_capacity);
+        if (!larger) return -1;
+        path->data = larger;
+        path->capacity = new_capacity;
+    }
+    path->data[path->length++] = '/';
+    memcpy(path->data + path->length, name, length + 1);
+    path->length += length;
+    return 0;
+}
+
+/*
+passes the files of directory and its subdirectories to callback in
+order, waiting for each directory to be listed. finished subdirectories
+are freed, the rest is freed by the caller.
+*/
+static int emit_files(Walker *walker, Directory *directory, Path_buffer *path,
+                      File_callback callback, void *context) {
+    pthread_mutex_lock(&walker->mutex);
+    while (!directory->listed) {
+        pthread_cond_wait(&walker->changed, &walker->mutex);
+    }
+    pthread_mutex_unlock(&walker->mutex);
+
+    size_t path_length = path->length;
+    for (size_t entry_i = 0; entry_i < directory->entry_count; ++entry_i) {
+        Entry *entry = &directory->entries[entry_i];
+        if (append_to_path(path, directory->names + entry->name_offset) != 0) {
+            fprintf(stderr, "Failed to allocate memory for path %s.\n", path->data);
+            return -1;
+        }
+
+        if (entry->directory) {
+            if (emit_files(walker, entry->directory, path, callback, context) != 0) return -1;
+            free_directory(entry->directory);
+            entry->directory = NULL;
+        } else if (callback(path->data, context) != 0) {
+            return -1;
+        }
+        path->length = path_length;
+        path->data[path_length] = '\0';
+    }
+    return 0;
+}
+
+int walk_matlab_files(const char *path, const Walk_options *options, File_callback callback, void *context) {
+    int root_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    size_t shard_count = options->shard_count ? options->shard_count : 1;
+    if (root_fd < 0) {
+        if (errno == ENOTDIR) {
+            // a single file is assigned like an entry with an empty relative path
+            int selected = shard_count == 1 || hash_bytes("", 0, 0) % shard_count == options->shard_index;
+            return selected && has_m_extension(path) ? callback(path, context) : 0;
+        }
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    Walker walker = {
+        .root_path = path,
+        .root_fd = root_fd,
+        .max_depth = options->max_depth,
+        .filter = options->filter && path_filter_active(options->filter) ? options->filter : NULL,
+        .shard_index = options->shard_index,
+        .shard_count = shard_count,
+        .pending = NULL,
+        .unlisted_count = 1,
+        .stopped = 0
+    };
+    // the files are reported as path/name, like the path was given
+    size_t path_length = strlen(path);
+    Path_buffer path_buffer = { malloc(path_length + 1), path_length, path_length + 1 };
+    Directory *root = create_directory(NULL, ".");
+    if (!root || !path_buffer.data) {
+        fprintf(stderr, "Failed to allocate memory for directory %s.\n", path);
+        free_directory(root);
+        free(path_buffer.data);
+        close(root_fd);
+        return -1;
+    }
+    memcpy(path_buffer.data, path, path_length + 1);
+
+    walker.pending = root;
+    pthread_mutex_init(&walker.mutex, NULL);
+    pthread_cond_init(&walker.changed, NULL);
+
+    size_t thread_count = options->thread_count ? options->thread_count : 1;
+    pthread_t threads[thread_count];
+    size_t started_count = 0;
+    for (size_t thread_i = 0; thread_i < thread_count; ++thread_i) {
+        if (pthread_create(&threads[thread_i], NULL, run_walker, &walker) != 0) break;
+        ++started_count;
+    }
+    if (started_count == 0) {
+        // the calling thread lists everything before the first callback
+        run_walker(&walker);
+    }
+
+    int result = emit_files(&walker, root, &path_buffer, callback, context);
+
+    // after a failed callback the threads drain the stack without listing
+    pthread_mutex_lock(&walker.mutex);
+    walker.stopped = 1;
+    pthread_mutex_unlock(&walker.mutex);
+    for (size_t thread_i = 0; thread_i < started_count; ++thread_i) {
+        pthread_join(threads[thread_i], NULL);
+    }
+
+    pthread_cond_destroy(&walker.changed);
+    pthread_mutex_destroy(&walker.mutex);
+    free_directory(root);
+    free(path_buffer.data);
+    close(root_fd);
+    return result;
+}
+
+int compare_walk_order(const char *a, size_t a_length, const char *b, size_t b_length) {
+    size_t i = 0;
+    while (i < a_length && i < b_length && a[i] == b[i]) ++i;
+    unsigned a_rank = i == a_length ? 0 : a[i] == '/' ? 1 : (unsigned char)a[i] + 1u;
+    unsigned b_rank = i == b_length ? 0 : b[i] == '/' ? 1 : (unsigned char)b[i] + 1u;
+    return (a_rank > b_rank) - (a_rank < b_rank);
+}
@@ -0,0 +1,47 @@
+#ifndef DIRECTORY_WALKER_H
+#define DIRECTORY_WALKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "path_filter.h"
+
+// called for every .m file found, a non zero return value is reported as error
+typedef int (*File_callback)(const char *file_path, void *context);
+
+// max_depth of a walk without a depth limit
+#define UNLIMITED_DEPTH SIZE_MAX
+
+typedef struct {
+    size_t max_depth; // directory levels below the path that are searched, 0 only searches the path itself
+    size_t thread_count;
+    const Path_filter *filter; // NULL to visit every .m file
+    size_t shard_index; // only visit the files of this shard, see walk_matlab_files
+    size_t shard_count; // 0 or 1 visits every file
+} Walk_options;
+
+/*
+recursively searches path for .m files and calls callback for
+each of them. thread_count threads list the directories with
+openat and getdents64, the file type comes from d_type, so only
+symbolic links and file systems without d_type need a stat.
+directories that link back to one of their parents (same device
+and inode) are skipped, excluded ones (path_filter.h) are never
+opened. callback runs on the calling thread, in the order of a
+sequential walk with the entries of each directory sorted by
+name, while the threads list the following directories. a non
+zero return value of callback stops the walk, -1 is returned.
+with shard_count > 1 only the files whose relative path hashes
+(hash.h) to shard_index are visited, so the shards of a path are
+disjoint, cover every file and don't change between runs.
+*/
+int walk_matlab_files(const char *path, const Walk_options *options, File_callback callback, void *context);
+
+/*
+the order in which walk_matlab_files visits paths: component by
+component like strcmp, a finished component ranks before any
+character. the strings don't have to be null terminated.
+*/
+int compare_walk_order(const char *a, size_t a_length, const char *b, size_t b_length);
+
+#endif
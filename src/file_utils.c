@@ -1,10 +1,18 @@
 #include "tinydir.h"
 #include "file_utils.h"
 #include "detector_registry.h"
+#include "path_table.h"
+#include "trace.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #ifdef _WIN32
     #define PATH_SEPARATOR '\\'
@@ -16,11 +24,11 @@
 #define INITIAL_FILE_CAPACITY 10
 #define MAX_PATH_LENGTH 4096
 #define NUM_SMELLS 3
-
-static int has_m_extension(const char* file_name) {
-    const char* file_extension = strrchr(file_name, '.');
-    return file_extension && strcmp(file_extension, ".m") == 0;
-}
+// files at least this large are memory mapped instead of read
+#define MMAP_THRESHOLD (64 * 1024)
+#define READ_CHUNK_SIZE (1024 * 1024)
+// upper bound for a single TSInput read callback
+#define PARSE_CHUNK_SIZE (1024 * 1024)
 
 int load_config(const char* file_name, Smell_detector **detectors, size_t detector_count) {
     FILE* file = fopen(file_name, "r");
@@ -81,91 +89,116 @@ int load_config(const char* file_name, Smell_detector **detectors, size_t detect
     return 0;
 }
 
-Matlab_file *read_file(const char *file_path) {
-    FILE *file = fopen(file_path, "rb");
-    if (!file) return NULL;
-
-    fseek(file, 0, SEEK_END);
-    long length = ftell(file);
+// reads length bytes in chunks, no seeking and no second pass over the content
+static char *read_chunked(int fd, size_t length) {
+    char *buffer = malloc(length);
+    if (!buffer) return NULL;
 
-    if (length <= 0) {
-        fclose(file);
-        return NULL;
+    size_t offset = 0;
+    while (offset < length) {
+        size_t chunk = length - offset;
+        if (chunk > READ_CHUNK_SIZE) chunk = READ_CHUNK_SIZE;
+        ssize_t bytes_read = read(fd, buffer + offset, chunk);
+        if (bytes_read < 0 && errno == EINTR) continue;
+        if (bytes_read <= 0) {
+            free(buffer);
+            return NULL;
+        }
+        offset += (size_t)bytes_read;
     }
+    return buffer;
+}
 
-    // reset file position
-    if (fseek(file, 0, SEEK_SET) != 0) {
-        fclose(file);
-        return NULL;
-    }
+Matlab_file *read_file(const char *file_path) {
+    int scoped = scopes_enabled();
+    Scope_start scope;
+    if (scoped) begin_scope(&scope);
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) return NULL;
 
-    char *buffer = malloc(length + 1);
-    if (!buffer) {
-        fclose(file);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+        close(fd);
         return NULL;
     }
 
-    if (fread(buffer, 1, length, file) != (size_t)length) {
-        fclose(file);
-        free(buffer);
+    if ((uint64_t)file_stat.st_size > UINT32_MAX) {
+        fprintf(stderr, "File %s exceeds the 4 GiB tree-sitter limit.\n", file_path);
+        close(fd);
         return NULL;
     }
+    size_t length = (size_t)file_stat.st_size;
 
-    buffer[length] = '\0';
-    fclose(file);
+    const char *content = NULL;
+    int is_mapped = 0;
 
-    Matlab_file *matlab_file = malloc(sizeof(Matlab_file));
-    if (!matlab_file) {
-        free(buffer);
-        return NULL;
-    } 
+    // small files are cheaper to read than to map and unmap
+    if (length >= MMAP_THRESHOLD) {
+        void *mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            // tree-sitter reads the source front to back
+            posix_madvise(mapping, length, POSIX_MADV_SEQUENTIAL);
+            content = mapping;
+            is_mapped = 1;
+        }
+    }
+    if (!content) {
+        content = read_chunked(fd, length);
+    }
+    close(fd);
+    if (!content) return NULL;
 
-    size_t path_length = strlen(file_path);
-    char *path = malloc(path_length+1);
-    if (!path) {
-        free(buffer);
+    Matlab_file *matlab_file = malloc(sizeof(Matlab_file));
+    const char *path = path_table_add(file_path);
+    if (!matlab_file || !path) {
+        if (is_mapped) {
+            munmap((void *)content, length);
+        } else {
+            free((void *)content);
+        }
         free(matlab_file);
         return NULL;
     }
-    memcpy(path, file_path, path_length + 1);
 
-    matlab_file->content = buffer;
+    matlab_file->content = content;
+    matlab_file->length = length;
+    matlab_file->is_mapped = is_mapped;
     matlab_file->file_name = path;
+    matlab_file->index = 0;
 
+    if (scoped) end_scope(&scope, PHASE_READ, NULL, path);
     return matlab_file;
 }
 
-// TODO: - add some kind of limit to search depth,
-// - add error check for path construction
-int load_files(const char *path, File_list *list) {
-    tinydir_file file;
-    if (tinydir_file_open(&file, path) == -1) {
-        perror("tinydir_file_open");
-        return -1;
+static const char *read_source_chunk(void *payload, uint32_t byte_index,
+                                     TSPoint position, uint32_t *bytes_read) {
+    (void)position;
+    const Matlab_file *file = payload;
+    if (byte_index >= file->length) {
+        *bytes_read = 0;
+        return "";
     }
+    size_t remaining = file->length - byte_index;
+    *bytes_read = remaining > PARSE_CHUNK_SIZE ? PARSE_CHUNK_SIZE : (uint32_t)remaining;
+    return file->content + byte_index;
+}
 
-    // --- base case: path is file ---
-    if (!file.is_dir) {
-        if (has_m_extension(file.name)) {
-            Matlab_file *matlab_file = read_file(path);
-            if (!matlab_file) {
-                fprintf(stderr, "Failed to read file %s.\n", path);
-                return -1;
-            }
-
-            if (add_matlab_file(matlab_file, list) != 0) {
-                fprintf(stderr, "Failed to allocate additional memory for file list.\n");
-            }
-        }
-        return 0;
-    }
+TSTree *parse_matlab_file(TSParser *parser, const TSTree *old_tree, const Matlab_file *file) {
+    TSInput input = {
+        .payload = (void *)file,
+        .read = read_source_chunk,
+        .encoding = TSInputEncodingUTF8
+    };
+    return ts_parser_parse(parser, old_tree, input);
+}
 
-    // --- recursive case: path is directory ---
+int walk_directories(const char *path, File_callback callback, void *context) {
     tinydir_dir dir;
     if (tinydir_open(&dir, path) == -1) {
         perror("tinydir_open");
         return -1;
     }
+    int result = callback(path, context);
 
     while (dir.has_next) {
         tinydir_file child;
@@ -174,64 +207,84 @@ int load_files(const char *path, File_list *list) {
             continue;
         }
 
-        if (strcmp(child.name, ".") != 0 && strcmp(child.name, "..") != 0) {
+        if (child.is_dir && strcmp(child.name, ".") != 0 && strcmp(child.name, "..") != 0) {
             char child_path[MAX_PATH_LENGTH];
             snprintf(child_path, sizeof(child_path), "%s%c%s", path, PATH_SEPARATOR, child.name);
-            load_files(child_path, list); // recursive call
+            if (walk_directories(child_path, callback, context) != 0) result = -1;
         }
 
         tinydir_next(&dir);
     }
 
     tinydir_close(&dir);
-    return 0;
+    return result;
 }
 
-static void write_smell_csv_row(FILE *file, const Smell *smell, const char *detector_name) {
-    fprintf(file, "%s,\"%s\",%d",
-            detector_name,
-            smell->location.file_name,
-            smell->location.line);
-    for (size_t metric_i = 0; metric_i < MAX_METRICS; ++metric_i) {
-        if (metric_i < smell->metric_count) {
-            const Metric *metric = &smell->metrics[metric_i];
-            if (metric->is_float) {
-                fprintf(file, ",%s,%.2f",
-                        metric->name,
-                        metric->measured_value.float_value);
-            } else {
-                fprintf(file, ",%s,%d",
-                        metric->name,
-                        metric->measured_value.int_value);
-            }
-        } else {
-            fprintf(file, ",,");
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t capacity;
+    File_selector select; // NULL keeps every path
+    void *select_context;
+} Path_list;
+
+static int add_path_to_list(const char *file_path, void *context) {
+    Path_list *list = context;
+    if (list->select && !list->select(file_path, list->select_context)) return 0;
+    if (list->count >= list->capacity) {
+        size_t new_capacity = list->capacity ? list->capacity * 2 : INITIAL_FILE_CAPACITY;
+        char **larger = realloc(list->paths, new_capacity * sizeof(char *));
+        if (!larger) {
+            fprintf(stderr, "Failed to allocate memory for path %s.\n", file_path);
+            return -1;
         }
+        list->paths = larger;
+        list->capacity = new_capacity;
     }
-    fprintf(file, "\n");
-}
-
-static void single_list_to_CSV(FILE *file, Smell_list *list, const char *detector_name) {
-    for (size_t smell_i = 0; smell_i < list->count; ++smell_i) {
-        write_smell_csv_row(file, &list->smells[smell_i], detector_name);
+    size_t length = strlen(file_path);
+    char *copy = malloc(length + 1);
+    if (!copy) {
+        fprintf(stderr, "Failed to allocate memory for path %s.\n", file_path);
+        return -1;
     }
+    memcpy(copy, file_path, length + 1);
+    list->paths[list->count++] = copy;
+    return 0;
 }
 
-void smell_lists_to_CSV() {
-    FILE *file = fopen("output.csv", "w");
-    if (!file) {
-        perror("output.csv");
-        return;
+static int add_file_to_list(const char *file_path, File_list *list) {
+    Matlab_file *matlab_file = read_file(file_path);
+    if (!matlab_file) {
+        fprintf(stderr, "Failed to read file %s.\n", file_path);
+        return -1;
     }
-    fprintf(file, "smell_type,file_name,line");
-    for (int metric_i = 0; metric_i < MAX_METRICS; ++metric_i) {
-        fprintf(file, ",metric%d_name,metric%d_measured_value",
-                metric_i + 1, metric_i + 1);
+
+    if (add_matlab_file(matlab_file, list) != 0) {
+        fprintf(stderr, "Failed to allocate additional memory for file list.\n");
+        free_matlab_file(matlab_file);
+        return -1;
     }
-    fprintf(file, "\n");
-    
-    for (size_t list_i = 0; list_i < detector_count; ++list_i) {
-        single_list_to_CSV(file, detectors[list_i]->smell_list, detectors[list_i]->name);
+    return 0;
+}
+
+// the paths are found first and read afterwards, so both phases can be timed on their own
+int load_files(const char *path, const Walk_options *options, File_list *list) {
+    return load_selected_files(path, options, NULL, NULL, list);
+}
+
+int load_selected_files(const char *path, const Walk_options *options, File_selector select, void *context,
+                        File_list *list) {
+    int scoped = scopes_enabled();
+    Scope_start scope;
+    if (scoped) begin_scope(&scope);
+    Path_list paths = { NULL, 0, 0, select, context };
+    int result = walk_matlab_files(path, options, add_path_to_list, &paths);
+    if (scoped) end_scope(&scope, PHASE_DISCOVERY, NULL, NULL);
+
+    for (size_t path_i = 0; path_i < paths.count; ++path_i) {
+        if (add_file_to_list(paths.paths[path_i], list) != 0) result = -1;
+        free(paths.paths[path_i]);
     }
-    fclose(file);
-}
\ No newline at end of file
+    free(paths.paths);
+    return result;
+}
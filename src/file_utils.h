@@ -3,18 +3,38 @@
 
 #include <stddef.h>
 
+#include "directory_walker.h"
 #include "matlab_file_list.h"
 #include "smell_list.h"
 #include "detector_registry.h"
 
+// calls callback for path and every directory below it, path has to be a directory
+int walk_directories(const char *path, File_callback callback, void *context);
+
 /*
 loads all .m files from a given path into a dynamic
-file list (matlab_file_list.h)
+file list (matlab_file_list.h), the path is searched
+as configured by options (directory_walker.h)
 */
-int load_files(const char *path, File_list *list);
+int load_files(const char *path, const Walk_options *options, File_list *list);
 
-int load_config(const char *file_name, Smell_detector **detectors, size_t detector_count);
+// returns non zero if the file should be loaded
+typedef int (*File_selector)(const char *file_path, void *context);
+
+// like load_files, but only the files that select accepts are read
+int load_selected_files(const char *path, const Walk_options *options, File_selector select, void *context,
+                        File_list *list);
+
+/*
+maps the file into memory (or reads it in chunks if it is small
+or mapping fails), the file name is stored in the path table.
+files tree-sitter can't address (> UINT32_MAX bytes) are rejected.
+*/
+Matlab_file *read_file(const char *file_path);
 
-void smell_lists_to_CSV();
+// parses the file content through a TSInput without copying it
+TSTree *parse_matlab_file(TSParser *parser, const TSTree *old_tree, const Matlab_file *file);
+
+int load_config(const char *file_name, Smell_detector **detectors, size_t detector_count);
 
 #endif
@@ -0,0 +1,52 @@
+#include "hash.h"
+
+#include <string.h>
+
+#define HASH_MULTIPLIER 0x9e3779b97f4a7c15ULL
+
+// final avalanche of murmur3
+static uint64_t mix(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+static uint64_t rotate_left(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t hash_bytes(const void *data, size_t length, uint64_t seed) {
+    const unsigned char *bytes = data;
+    uint64_t hash = seed ^ (length * HASH_MULTIPLIER);
+
+    // 32 bytes per iteration in four independent lanes
+    uint64_t lanes[4] = { hash, hash ^ HASH_MULTIPLIER, rotate_left(hash, 17), ~hash };
+    while (length >= 32) {
+        for (int lane_i = 0; lane_i < 4; ++lane_i) {
+            uint64_t word;
+            memcpy(&word, bytes + lane_i * 8, sizeof(word));
+            lanes[lane_i] = rotate_left(lanes[lane_i] ^ (word * HASH_MULTIPLIER), 31) * 0xbf58476d1ce4e5b9ULL;
+        }
+        bytes += 32;
+        length -= 32;
+    }
+    hash = mix(lanes[0]) ^ rotate_left(mix(lanes[1]), 16)
+         ^ rotate_left(mix(lanes[2]), 32) ^ rotate_left(mix(lanes[3]), 48);
+
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        hash = rotate_left(hash ^ (word * HASH_MULTIPLIER), 27) * 0xbf58476d1ce4e5b9ULL;
+        bytes += 8;
+        length -= 8;
+    }
+    uint64_t tail = 0;
+    for (size_t byte_i = 0; byte_i < length; ++byte_i) {
+        tail |= (uint64_t)bytes[byte_i] << (8 * byte_i);
+    }
+    hash ^= tail * HASH_MULTIPLIER;
+    return mix(hash);
+}
@@ -0,0 +1,14 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+fast non cryptographic 64 bit hash, stable across runs and
+machines of the same endianness. used for cache keys and for
+assigning files to shards.
+*/
+uint64_t hash_bytes(const void *data, size_t length, uint64_t seed);
+
+#endif
@@ -0,0 +1,210 @@
+#include "line_index.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_LINE_CAPACITY 256
+
+static int vector_scans = 1;
+
+typedef size_t (*Newline_kernel)(const char *text, size_t length);
+// writes the offset after every '\n' from position to length, at most max_count, returns how many it wrote
+typedef size_t (*Line_start_kernel)(const char *text, size_t position, size_t length, uint32_t *line_starts,
+                                    size_t max_count);
+
+static size_t count_newlines_scalar(const char *text, size_t length) {
+    size_t newline_count = 0;
+    const char *end = text + length;
+    while (text < end && (text = memchr(text, '\n', (size_t)(end - text))) != NULL) {
+        ++newline_count;
+        ++text;
+    }
+    return newline_count;
+}
+
+static size_t find_line_starts_scalar(const char *text, size_t position, size_t length, uint32_t *line_starts,
+                                      size_t max_count) {
+    size_t found = 0;
+    for (; position < length && found < max_count; ++position) {
+        if (text[position] == '\n') line_starts[found++] = (uint32_t)(position + 1);
+    }
+    return found;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_KERNEL 1
+#include <immintrin.h>
+
+// compiled for AVX2 only, the select functions check that the CPU supports it
+__attribute__((target("avx2")))
+static size_t count_newlines_avx2(const char *text, size_t length) {
+    __m256i newline = _mm256_set1_epi8('\n');
+    size_t newline_count = 0;
+    size_t position = 0;
+    for (; position + 32 <= length; position += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(text + position));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(newline, block));
+        newline_count += (size_t)__builtin_popcount(mask);
+    }
+    return newline_count + count_newlines_scalar(text + position, length - position);
+}
+
+/*
+one bit per byte of the block is set for a '\n', only the set bits
+are visited. a block writes at most 32 offsets, the last blocks
+before max_count is reached are left to the scalar loop.
+*/
+__attribute__((target("avx2")))
+static size_t find_line_starts_avx2(const char *text, size_t position, size_t length, uint32_t *line_starts,
+                                    size_t max_count) {
+    __m256i newline = _mm256_set1_epi8('\n');
+    size_t found = 0;
+    for (; position + 32 <= length && max_count - found >= 32; position += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(text + position));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(newline, block));
+        while (mask) {
+            line_starts[found++] = (uint32_t)(position + (size_t)__builtin_ctz(mask) + 1);
+            mask &= mask - 1;
+        }
+    }
+    return found + find_line_starts_scalar(text, position, length, line_starts + found, max_count - found);
+}
+#endif
+
+void enable_vector_scans(int enabled) {
+    vector_scans = enabled;
+}
+
+int vector_scans_enabled(void) {
+#ifdef HAVE_AVX2_KERNEL
+    return vector_scans && __builtin_cpu_supports("avx2");
+#else
+    return 0;
+#endif
+}
+
+static Newline_kernel select_newline_kernel(void) {
+#ifdef HAVE_AVX2_KERNEL
+    if (vector_scans_enabled()) return count_newlines_avx2;
+#endif
+    return count_newlines_scalar;
+}
+
+static Line_start_kernel select_line_start_kernel(void) {
+#ifdef HAVE_AVX2_KERNEL
+    if (vector_scans_enabled()) return find_line_starts_avx2;
+#endif
+    return find_line_starts_scalar;
+}
+
+size_t count_newlines(const char *text, size_t length) {
+    return select_newline_kernel()(text, length);
+}
+
+void init_line_index(Line_index *index) {
+    index->line_starts = NULL;
+    index->code_before = NULL;
+    index->comments_before = NULL;
+    index->line_count = 0;
+    index->capacity = 0;
+}
+
+void free_line_index(Line_index *index) {
+    free(index->line_starts);
+    free(index->code_before);
+    free(index->comments_before);
+    init_line_index(index);
+}
+
+// a buffer that was already enlarged stays larger if a later one fails
+static int reserve_lines(Line_index *index, size_t line_count) {
+    if (line_count <= index->capacity) return 0;
+    size_t new_capacity = index->capacity ? index->capacity : INITIAL_LINE_CAPACITY;
+    while (new_capacity < line_count) new_capacity *= 2;
+
+    uint32_t *line_starts = realloc(index->line_starts, new_capacity * sizeof(uint32_t));
+    if (!line_starts) return -1;
+    index->line_starts = line_starts;
+    uint32_t *code_before = realloc(index->code_before, (new_capacity + 1) * sizeof(uint32_t));
+    if (!code_before) return -1;
+    index->code_before = code_before;
+    uint32_t *comments_before = realloc(index->comments_before, (new_capacity + 1) * sizeof(uint32_t));
+    if (!comments_before) return -1;
+    index->comments_before = comments_before;
+    index->capacity = new_capacity;
+    return 0;
+}
+
+static int is_blank(char byte) {
+    return byte == ' ' || byte == '\t' || byte == '\r' || byte == '\f' || byte == '\v';
+}
+
+// "%{" or "%}" with nothing but whitespace after it, position is at the '%'
+static int is_block_marker(const char *content, size_t position, size_t end, char bracket) {
+    if (position + 1 >= end || content[position + 1] != bracket) return 0;
+    for (position += 2; position < end; ++position) {
+        if (!is_blank(content[position])) return 0;
+    }
+    return 1;
+}
+
+static void classify_lines(Line_index *index, const char *content, size_t length) {
+    size_t block_depth = 0;
+    uint32_t code_lines = 0;
+    uint32_t comment_lines = 0;
+    for (size_t row = 0; row < index->line_count; ++row) {
+        index->code_before[row] = code_lines;
+        index->comments_before[row] = comment_lines;
+        size_t position = index->line_starts[row];
+        size_t end = row + 1 < index->line_count ? index->line_starts[row + 1] - 1 : length;
+        while (position < end && is_blank(content[position])) ++position;
+        if (position == end) continue;
+
+        if (content[position] == '%') {
+            if (is_block_marker(content, position, end, '{')) {
+                ++block_depth;
+            } else if (block_depth > 0 && is_block_marker(content, position, end, '}')) {
+                --block_depth;
+            }
+            ++comment_lines;
+        } else if (block_depth > 0) {
+            ++comment_lines;
+        } else {
+            ++code_lines;
+        }
+    }
+    index->code_before[index->line_count] = code_lines;
+    index->comments_before[index->line_count] = comment_lines;
+}
+
+int build_line_index(Line_index *index, const char *content, size_t length) {
+    if (length > UINT32_MAX) return -1;
+    /*
+    the number of lines first, so the buffers grow only once. the
+    content can be a mapped file that changes between the scans, so
+    the second one still stops at the capacity and its count is kept
+    */
+    if (reserve_lines(index, count_newlines(content, length) + 1) != 0) return -1;
+
+    index->line_starts[0] = 0;
+    index->line_count = select_line_start_kernel()(content, 0, length, index->line_starts + 1,
+                                                   index->capacity - 1) + 1;
+    classify_lines(index, content, length);
+    return 0;
+}
+
+// last_row is clamped to the last row of the index
+static uint32_t count_in_rows(const Line_index *index, const uint32_t *before, uint32_t first_row,
+                              uint32_t last_row) {
+    if (first_row >= index->line_count || last_row < first_row) return 0;
+    size_t end_row = (size_t)last_row + 1 < index->line_count ? (size_t)last_row + 1 : index->line_count;
+    return before[end_row] - before[first_row];
+}
+
+uint32_t count_code_lines(const Line_index *index, uint32_t first_row, uint32_t last_row) {
+    return count_in_rows(index, index->code_before, first_row, last_row);
+}
+
+uint32_t count_comment_lines(const Line_index *index, uint32_t first_row, uint32_t last_row) {
+    return count_in_rows(index, index->comments_before, first_row, last_row);
+}
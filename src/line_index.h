@@ -0,0 +1,50 @@
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+line structure of a file's content, built by vectorized scans
+for newlines. rows are 0 based like TSPoint.row, row i starts at
+line_starts[i] and ends before the next '\n'. every line is
+blank, comment or code: a comment line starts with '%' after
+whitespace and the lines between "%{" and "%}" (each alone on
+its line, they nest) are comments unless they are blank. a line
+with code and a trailing comment is code. the counts are prefix
+sums, code_before[i] is the number of code lines before row i,
+so any range of rows costs two lookups.
+the buffers are reused when the index is built again.
+*/
+typedef struct {
+    uint32_t *line_starts; // line_count entries
+    uint32_t *code_before; // line_count + 1 entries
+    uint32_t *comments_before; // line_count + 1 entries
+    size_t line_count;
+    size_t capacity;
+} Line_index;
+
+void init_line_index(Line_index *index);
+// returns -1 if the buffers couldn't be allocated or the content is larger than 4 GiB
+int build_line_index(Line_index *index, const char *content, size_t length);
+void free_line_index(Line_index *index);
+
+// rows from first_row to last_row, both included, rows past the end count nothing
+uint32_t count_code_lines(const Line_index *index, uint32_t first_row, uint32_t last_row);
+uint32_t count_comment_lines(const Line_index *index, uint32_t first_row, uint32_t last_row);
+
+// number of '\n' bytes, with AVX2 if the CPU supports it
+size_t count_newlines(const char *text, size_t length);
+
+/*
+the scans of the line index, the prefilter (prefilter.h) and
+the TCC pair kernel (tcc.h) use AVX2 if the CPU supports it,
+unless disabled. the scalar loops give the same results
+(test/scan_test). not synchronized, set it before the workers
+start.
+*/
+void enable_vector_scans(int enabled);
+// 1 if the scans currently use AVX2
+int vector_scans_enabled(void);
+
+#endif
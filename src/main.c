@@ -6,69 +6,168 @@
 #include "file_utils.h"
 #include "smell_list.h"
 #include "detector_registry.h"
-
-extern uint32_t count_LOC(TSNode node);
-
-
-char* parse_argument(int argc, char* argv[], const char* program_name) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <path>\n", program_name); // TODO: add usage based on windows/linux
-        fprintf(stderr, "Error: Expected exactly 1 argument (path), got %d.\n", argc - 1);
-        return NULL;
-    }
-    return argv[1];
-}
+#include "options.h"
+#include "analysis.h"
+#include "path_table.h"
+#include "query_registry.h"
+#include "candidate_cache.h"
+#include "watch.h"
+#include "filter_utils.h"
+#include "report_writer.h"
+#include "binary_report.h"
+#include "shard_merge.h"
+#include "baseline.h"
+#include "trace.h"
+#include "tree_allocator.h"
+#include "prefilter.h"
 
 int main(int argc, char *argv[]) {
     clock_t begin = clock();
+    uint64_t wall_begin = trace_now();
 
-    char* path = parse_argument(argc, argv, argv[0]);
-    if (!path) return EXIT_FAILURE;
+    Run_options options;
+    if (parse_options(argc, argv, &options) != 0) return EXIT_FAILURE;
+    if (options.print_timings || options.trace_path) {
+        init_trace();
+    }
+    if (options.perf_counters && init_perf_counters() != 0) {
+        fprintf(stderr, "Continuing without performance counters.\n");
+    }
     
     load_config("config.ini", detectors, detector_count);
+    // before the queries are compiled, every tree-sitter object has to come from the same allocator
+    if (options.tree_arenas) {
+        install_tree_allocator();
+        enable_tree_arenas(1);
+    }
+    enable_prefilter(options.prefilter);
 
-    File_list file_list;
-    init_file_list(&file_list);
+    // merge mode only filters the candidates of the shards
+    if (!options.merge_paths && compile_queries() != 0) {
+        fprintf(stderr, "Error: Failed to compile detector queries.\n");
+        return EXIT_FAILURE;
+    }
 
-    load_files(path, &file_list);
+    if (options.cache_directory && init_candidate_cache(options.cache_directory) != 0) {
+        fprintf(stderr, "Error: Failed to open candidate cache.\n");
+        free_queries();
+        return EXIT_FAILURE;
+    }
 
     for (size_t i = 0; i < detector_count; ++i) {
         detectors[i]->smell_list = malloc(sizeof(Smell_list));
-        init_smell_list(detectors[i]->smell_list);
+        if (!detectors[i]->smell_list
+                || init_smell_list(detectors[i]->smell_list, detectors[i]->metrics, detectors[i]->metric_count) != 0) {
+            fprintf(stderr, "Error: Failed to allocate smell lists.\n");
+            return EXIT_FAILURE;
+        }
     }
 
-    TSParser *parser = ts_parser_new();
-    ts_parser_set_language(parser, tree_sitter_matlab());
+    if (options.watch) {
+        int watch_result = watch_path(options.path);
+        for (size_t i = 0; i < detector_count; ++i) {
+            free_smell_list(detectors[i]->smell_list);
+            free(detectors[i]->smell_list);
+        }
+        free_path_table();
+        free_queries();
+        return watch_result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
+    Walk_options walk = { options.max_depth, options.thread_count, &options.filter,
+                          options.shard_index, options.shard_count };
+    size_t file_count = 0;
+    size_t changed_count = 0;
     uint32_t total_LOC = 0;
-
-    for (size_t file_i = 0; file_i < file_list.count; ++file_i) {
-        Matlab_file *current_file = file_list.files[file_i];
-        char *source = current_file->content;
-        TSTree *tree = ts_parser_parse_string(parser, NULL, source, strlen(source));
-        TSNode root_node = ts_tree_root_node(tree);
-
-        total_LOC = total_LOC + count_LOC(root_node);
-
-        for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
-            Smell_detector *current_detector = detectors[detector_i];
-            current_detector->detect_candidates(root_node, current_file, current_detector->smell_list);
-        }
-        ts_tree_delete(tree);
+    int analysis_result;
+    // a baseline lists every file, changed files mode subtracts the replaced ones with it
+    record_file_LOCs(options.save_baseline_path != NULL);
+    if (options.merge_paths) {
+        analysis_result = merge_shards(options.merge_paths, options.merge_path_count, &file_count, &total_LOC);
+    } else if (options.changed_list_path) {
+        analysis_result = analyze_changed_files(options.path, &walk, options.changed_list_path, options.baseline_path,
+                                                options.thread_count, options.save_baseline_path != NULL,
+                                                &changed_count, &file_count, &total_LOC);
+    } else if (options.pipelined) {
+        analysis_result = analyze_path_pipelined(options.path, &walk, options.thread_count,
+                                                 options.queue_capacity, options.bounded, &file_count, &total_LOC);
+    } else {
+        File_list file_list;
+        init_file_list(&file_list);
+        load_files(options.path, &walk, &file_list);
+        file_count = file_list.count;
+        analysis_result = analyze_files(&file_list, options.thread_count, options.bounded, &total_LOC);
+        free_file_list(&file_list);
+    }
+    free_path_filter(&options.filter);
+    if (analysis_result != 0 && options.merge_paths) {
+        fprintf(stderr, "Error: Failed to merge the shards.\n");
+        return EXIT_FAILURE;
+    }
+    if (analysis_result < 0 && options.changed_list_path) {
+        fprintf(stderr, "Error: Failed to apply the changed files to the baseline.\n");
+        return EXIT_FAILURE;
+    }
+    // the results are still printed, but the run fails and a partial baseline is never saved
+    if (analysis_result != 0) {
+        fprintf(stderr, "Analysis incomplete, results may be missing smells.\n");
+    }
+    if (analysis_result != 0 && options.save_baseline_path) {
+        fprintf(stderr, "Error: Baseline not saved to %s, the analysis is incomplete.\n", options.save_baseline_path);
     }
-    ts_parser_delete(parser);
 
-    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
-            Smell_detector *current_detector = detectors[detector_i];
-            current_detector->filter(current_detector);
-            printf("Smell List: %s\n", current_detector->name);
-            print_smell_list(current_detector->smell_list);
+    // a shard only writes its candidates, merge filters them together with the other shards
+    int sharded = options.shard_count > 0;
+    int scoped = scopes_enabled();
+    Scope_start scope;
+    if (options.save_baseline_path && analysis_result == 0) {
+        size_t file_LOC_count;
+        const File_LOC *file_LOCs = recorded_file_LOCs(&file_LOC_count);
+        Binary_run_info info = {
+            .flags = BINARY_FLAG_UNFILTERED,
+            .shard_index = 0,
+            .shard_count = 1,
+            .file_count = file_count,
+            .total_LOC = total_LOC,
+            .file_LOCs = file_LOCs,
+            .file_LOC_count = file_LOC_count
+        };
+        if (scoped) begin_scope(&scope);
+        smell_lists_to_binary(options.save_baseline_path, &info);
+        if (scoped) end_scope(&scope, PHASE_OUTPUT, "baseline", NULL);
+    }
+    free_recorded_file_LOCs();
+    for (size_t detector_i = 0; detector_i < detector_count && !sharded; ++detector_i) {
+            if (scoped) begin_scope(&scope);
+            filter_smell_list(detectors[detector_i]);
+            if (scoped) end_scope(&scope, PHASE_FILTER, detectors[detector_i]->name, NULL);
+    }
+    if (options.print_smells && !sharded) {
+        if (scoped) begin_scope(&scope);
+        print_smell_lists(options.thread_count);
+        if (scoped) end_scope(&scope, PHASE_OUTPUT, "print", NULL);
+    }
+    if (!sharded) {
+        if (scoped) begin_scope(&scope);
+        smell_lists_to_CSV(options.thread_count);
+        if (scoped) end_scope(&scope, PHASE_OUTPUT, "csv", NULL);
+    }
+    if (options.binary_path) {
+        Binary_run_info info = {
+            .flags = sharded ? BINARY_FLAG_UNFILTERED : 0,
+            .shard_index = (uint32_t)options.shard_index,
+            .shard_count = sharded ? (uint32_t)options.shard_count : 1,
+            .file_count = file_count,
+            .total_LOC = total_LOC
+        };
+        if (scoped) begin_scope(&scope);
+        smell_lists_to_binary(options.binary_path, &info);
+        if (scoped) end_scope(&scope, PHASE_OUTPUT, "binary", NULL);
     }
-    smell_lists_to_CSV();
 
     for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
             Smell_detector *current_detector = detectors[detector_i];
-            printf("Total number of %s smells: %zu\n", current_detector->name, 
+            printf("Total number of %s %s: %zu\n", current_detector->name, sharded ? "candidates" : "smells",
                     current_detector->smell_list->count);
     }
     printf("\n");
@@ -77,12 +176,30 @@ int main(int argc, char *argv[]) {
         free_smell_list(detectors[i]->smell_list);
         free(detectors[i]->smell_list);
     }
-    printf("Files analyzed: %zu\n", file_list.count);
-    free_file_list(&file_list);
+    if (options.changed_list_path) {
+        printf("Changed files analyzed: %zu\n", changed_count);
+    }
+    printf("Files analyzed: %zu\n", file_count);
+    if (prefilter_skipped_count() > 0) {
+        printf("Files without detector keywords (not parsed): %zu\n", prefilter_skipped_count());
+    }
     printf("Total LOC analyzed: %d\n", total_LOC);
+    if (options.print_timings) {
+        print_trace_summary(stdout);
+    }
+    print_perf_counters(stdout);
+    free_perf_counters();
+    // the trace refers to file names in the path table
+    if (options.trace_path) {
+        write_chrome_trace(options.trace_path);
+    }
+    free_trace();
+    free_path_table();
+    free_queries();
     clock_t end = clock();
     double time_spent = (double)(end - begin) / CLOCKS_PER_SEC;
     printf("CPU time used: %lf seconds\n", time_spent);
+    printf("Wall time: %lf seconds\n", (trace_now() - wall_begin) / 1e9);
 
-    return EXIT_SUCCESS;
+    return analysis_result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 
 #include "matlab_file_list.h"
 
+#include <sys/mman.h>
+
 #define INITIAL_FILE_CAPACITY 10
 
 void init_file_list(File_list *list) {
@@ -17,8 +19,12 @@ void init_file_list(File_list *list) {
 }
 
 void free_matlab_file(Matlab_file *file) {
-    free(file->content);
-    free(file->file_name);
+    // file_name belongs to the path table and outlives the file
+    if (file->is_mapped) {
+        munmap((void *)file->content, file->length);
+    } else {
+        free((void *)file->content);
+    }
     free(file);
 }
 
@@ -45,6 +51,7 @@ int add_matlab_file(Matlab_file *file, File_list *list) {
             return -1;
         }
     }
+    file->index = list->count;
     list->files[list->count] = file;
     list->count++;
     return 0;
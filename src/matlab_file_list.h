@@ -2,17 +2,32 @@
 #define MATLAB_FILE_LIST_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 /*
 struct to store Matlab files and
 dynamic list that store the Matlab files
 */
 
+/*
+content is either a heap buffer or a read only memory mapping
+of the file (is_mapped). it is not null terminated, length is
+the number of bytes in content.
+*/
 typedef struct {
-    char *file_name;
-    char *content;
+    const char *file_name; // owned by the path table (path_table.h)
+    const char *content;
+    size_t length;
+    int is_mapped;
+    size_t index; // position in discovery order
 } Matlab_file;
 
+// LOC of an analyzed file, 0 if it couldn't be parsed
+typedef struct {
+    const char *file_name; // owned by the path table (path_table.h)
+    uint32_t LOC;
+} File_LOC;
+
 typedef struct {
     Matlab_file **files;
     size_t count;
@@ -22,5 +37,6 @@ typedef struct {
 void init_file_list(File_list *list);
 void free_file_list(File_list *list);
 int add_matlab_file(Matlab_file *file, File_list *list);
+void free_matlab_file(Matlab_file *file);
 
 #endif
\ No newline at end of file
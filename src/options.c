@@ -0,0 +1,395 @@
+#include "options.h"
+#include "directory_walker.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_QUEUE_CAPACITY 64
+
+static void print_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s [options] <path>\n", program_name); // TODO: add usage based on windows/linux
+    fprintf(stderr, "       %s merge [-j N] [--no-print] [--binary FILE] [--timings] <shard file>...\n", program_name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -j N              analyze files with N worker threads (0 = one per CPU, default 1)\n");
+    fprintf(stderr, "  --max-depth N     search at most N directory levels below the path (default unlimited)\n");
+    fprintf(stderr, "  --exclude GLOB    skip files and directories matching the gitignore style GLOB (repeatable)\n");
+    fprintf(stderr, "  --include GLOB    only analyze files matching one of the GLOBs (repeatable)\n");
+    fprintf(stderr, "  --gitignore       also skip what the .gitignore files below the path exclude\n");
+    fprintf(stderr, "  --pipeline        overlap discovery, reading and parsing, keeps only queued files in memory\n");
+    fprintf(stderr, "  --queue-size N    capacity of each pipeline queue (default %d)\n", DEFAULT_QUEUE_CAPACITY);
+    fprintf(stderr, "  --cache DIR       reuse candidates of unchanged files from DIR\n");
+    fprintf(stderr, "  --watch           keep running and reanalyze files when they change\n");
+    fprintf(stderr, "  --shard I/N       only analyze shard I of N, write its unfiltered candidates to --binary\n");
+    fprintf(stderr, "  --save-baseline F also write the unfiltered candidates to F, a baseline for --changed\n");
+    fprintf(stderr, "  --changed LIST    only analyze the files in LIST (- for stdin), the others come from --baseline\n");
+    fprintf(stderr, "  --baseline FILE   candidates of all files, saved by an earlier run with --save-baseline\n");
+    fprintf(stderr, "  --bounded         keep only candidates that can pass the filters, memory grows with the result\n");
+    fprintf(stderr, "  --tree-arenas     allocate every syntax tree from its worker's arena, dropped at once\n");
+    fprintf(stderr, "  --no-prefilter    also parse files without any keyword a detector looks for\n");
+    fprintf(stderr, "  --no-print        don't print the smell lists, they are still written to output.csv\n");
+    fprintf(stderr, "  --binary FILE     also write the results to FILE in the columnar binary format\n");
+    fprintf(stderr, "  --timings         print the wall time of every phase and the slowest files\n");
+    fprintf(stderr, "  --trace FILE      write the timed phases as Chrome trace events to FILE\n");
+    fprintf(stderr, "  --perf-counters   count cycles, instructions and misses of every phase and detector (Linux)\n");
+    fprintf(stderr, "merge combines the --binary files of all shards of a run and filters them like a single run.\n");
+}
+
+static size_t online_cpu_count(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (size_t)cpus : 1;
+}
+
+// parses a non-negative integer, returns -1 if value is not a number
+static int parse_count(const char *value, size_t *count) {
+    char *end;
+    long parsed = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || parsed < 0) return -1;
+    *count = (size_t)parsed;
+    return 0;
+}
+
+// parses "I/N" with I < N
+static int parse_shard(const char *value, size_t *shard_index, size_t *shard_count) {
+    char *end;
+    long index = strtol(value, &end, 10);
+    if (end == value || *end != '/' || index < 0) return -1;
+    const char *count_text = end + 1;
+    long count = strtol(count_text, &end, 10);
+    if (end == count_text || *end != '\0' || count <= 0 || index >= count) return -1;
+    *shard_index = (size_t)index;
+    *shard_count = (size_t)count;
+    return 0;
+}
+
+// "merge" only filters and writes results, the options of the analysis don't apply
+static int parse_merge_options(int argc, char *argv[], Run_options *options) {
+    for (int arg_i = 2; arg_i < argc; ++arg_i) {
+        const char *arg = argv[arg_i];
+
+        if (strcmp(arg, "-j") == 0) {
+            if (arg_i + 1 >= argc || parse_count(argv[arg_i + 1], &options->thread_count) != 0) {
+                fprintf(stderr, "Error: -j expects a non-negative number of threads.\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            ++arg_i;
+            continue;
+        }
+
+        if (strcmp(arg, "--no-print") == 0) {
+            options->print_smells = 0;
+            continue;
+        }
+
+        if (strcmp(arg, "--timings") == 0) {
+            options->print_timings = 1;
+            continue;
+        }
+
+        if (strcmp(arg, "--binary") == 0) {
+            if (arg_i + 1 >= argc) {
+                fprintf(stderr, "Error: --binary expects a file name.\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            options->binary_path = argv[++arg_i];
+            continue;
+        }
+
+        if (arg[0] == '-') {
+            fprintf(stderr, "Error: Option %s can't be used with merge.\n", arg);
+            print_usage(argv[0]);
+            return -1;
+        }
+
+        // the shard files are the remaining arguments, in any order
+        if (!options->merge_paths) options->merge_paths = (const char *const *)&argv[arg_i];
+        if (&options->merge_paths[options->merge_path_count] != (const char *const *)&argv[arg_i]) {
+            fprintf(stderr, "Error: Options of merge have to come before the shard files.\n");
+            print_usage(argv[0]);
+            return -1;
+        }
+        ++options->merge_path_count;
+    }
+
+    if (options->merge_path_count == 0) {
+        fprintf(stderr, "Error: merge expects the files written by every shard.\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if (options->thread_count == 0) {
+        options->thread_count = online_cpu_count();
+    }
+    return 0;
+}
+
+int parse_options(int argc, char *argv[], Run_options *options) {
+    options->path = NULL;
+    options->merge_paths = NULL;
+    options->merge_path_count = 0;
+    options->max_depth = UNLIMITED_DEPTH;
+    init_path_filter(&options->filter);
+    options->thread_count = 1;
+    options->pipelined = 0;
+    options->queue_capacity = DEFAULT_QUEUE_CAPACITY;
+    options->cache_directory = NULL;
+    options->watch = 0;
+    options->bounded = 0;
+    options->shard_index = 0;
+    options->shard_count = 0;
+    options->changed_list_path = NULL;
+    options->baseline_path = NULL;
+    options->save_baseline_path = NULL;
+    options->tree_arenas = 0;
+    options->prefilter = 1;
+    options->print_smells = 1;
+    options->binary_path = NULL;
+    options->print_timings = 0;
+    options->trace_path = NULL;
+    options->perf_counters = 0;
+
+    if (argc > 1 && strcmp(argv[1], "merge") == 0) {
+        return parse_merge_options(argc, argv, options);
+    }
+
+    for (int arg_i = 1; arg_i < argc; ++arg_i) {
+        const char *arg = argv[arg_i];
+
+        if (strcmp(arg, "-j") == 0) {
+            if (arg_i + 1 >= argc || parse_count(argv[arg_i + 1], &options->thread_count) != 0) {
+                fprintf(stderr, "Error: -j expects a non-negative number of threads.\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            ++arg_i;
+            continue;
+        }
+
+        if (strcmp(arg, "--max-depth") == 0) {
+            if (arg_i + 1 >= argc || parse_count(argv[arg_i + 1], &options->max_depth) != 0) {
+                fprintf(stderr, "Error: --max-depth expects a non-negative number of levels.\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            ++arg_i;
+            continue;
+        }
+
+        if (strcmp(arg, "--exclude") == 0 || strcmp(arg, "--include") == 0) {
+            if (arg_i + 1 >= argc) {
+                fprintf(stderr, "Error: %s expects a pattern.\n", arg);
+                print_usage(argv[0]);
+                return -1;
+            }
+            Pattern_set *set = strcmp(arg, "--exclude") == 0 ? &options->filter.excludes : &options->filter.includes;
+            const char *pattern = argv[++arg_i];
+            if (add_pattern(set, pattern, strlen(pattern)) != 0) {
+                fprintf(stderr, "Error: Failed to allocate memory for pattern %s.\n", pattern);
+                return -1;
+            }
+            continue;
+        }
+
+        if (strcmp(arg, "--gitignore") == 0) {
+            options->filter.read_gitignore = 1;
+            continue;
+        }
+
+        if (strcmp(arg, "--pipeline") == 0) {
+            options->pipelined = 1;
+            continue;
+        }
+
+        if (strcmp(arg, "--queue-size") == 0) {
+            if (arg_i + 1 >= argc || parse_count(argv[arg_i + 1], &options->queue_capacity) != 0
+                    || options->queue_capacity == 0) {
+                fprintf(stderr, "Error: --queue-size expects a positive number.\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            ++arg_i;
+            continue;
+        }
+
+        if (strcmp(arg, "--watch") == 0) {
+            options->watch = 1;
+            continue;
+        }
+
+        if (strcmp(arg, "--shard") == 0) {
+            if (arg_i + 1 >= argc || parse_shard(argv[arg_i + 1], &options->shard_index, &options->shard_count) != 0) {
+                fprintf(stderr, "Error: --shard expects I/N with 0 <= I < N.\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            ++arg_i;
+            continue;
+        }
+
+        if (strcmp(arg, "--changed") == 0 || strcmp(arg, "--baseline") == 0 || strcmp(arg, "--save-baseline") == 0) {
+            if (arg_i + 1 >= argc) {
+                fprintf(stderr, "Error: %s expects a file name.\n", arg);
+                print_usage(argv[0]);
+                return -1;
+            }
+            const char **file_name = strcmp(arg, "--changed") == 0 ? &options->changed_list_path
+                                   : strcmp(arg, "--baseline") == 0 ? &options->baseline_path
+                                   : &options->save_baseline_path;
+            *file_name = argv[++arg_i];
+            continue;
+        }
+
+        if (strcmp(arg, "--bounded") == 0) {
+            options->bounded = 1;
+            continue;
+        }
+
+        if (strcmp(arg, "--tree-arenas") == 0) {
+            options->tree_arenas = 1;
+            continue;
+        }
+
+        if (strcmp(arg, "--no-prefilter") == 0) {
+            options->prefilter = 0;
+            continue;
+        }
+
+        if (strcmp(arg, "--no-print") == 0) {
+            options->print_smells = 0;
+            continue;
+        }
+
+        if (strcmp(arg, "--timings") == 0) {
+            options->print_timings = 1;
+            continue;
+        }
+
+        if (strcmp(arg, "--perf-counters") == 0) {
+            options->perf_counters = 1;
+            continue;
+        }
+
+        if (strcmp(arg, "--trace") == 0) {
+            if (arg_i + 1 >= argc) {
+                fprintf(stderr, "Error: --trace expects a file name.\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            options->trace_path = argv[++arg_i];
+            continue;
+        }
+
+        if (strcmp(arg, "--binary") == 0) {
+            if (arg_i + 1 >= argc) {
+                fprintf(stderr, "Error: --binary expects a file name.\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            options->binary_path = argv[++arg_i];
+            continue;
+        }
+
+        if (strcmp(arg, "--cache") == 0) {
+            if (arg_i + 1 >= argc) {
+                fprintf(stderr, "Error: --cache expects a directory.\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            options->cache_directory = argv[++arg_i];
+            continue;
+        }
+
+        if (arg[0] == '-') {
+            fprintf(stderr, "Error: Unknown option %s.\n", arg);
+            print_usage(argv[0]);
+            return -1;
+        }
+
+        if (options->path) {
+            fprintf(stderr, "Error: Expected exactly 1 path argument.\n");
+            print_usage(argv[0]);
+            return -1;
+        }
+        options->path = arg;
+    }
+
+    if (!options->path) {
+        fprintf(stderr, "Error: Expected exactly 1 path argument.\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if (options->watch && options->tree_arenas) {
+        // watch mode keeps the trees of all files for incremental parsing
+        fprintf(stderr, "Error: --tree-arenas can't be combined with --watch.\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if (options->watch && options->bounded) {
+        // watch mode keeps all candidates to update them per file
+        fprintf(stderr, "Error: --bounded can't be combined with --watch.\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if (options->watch && (options->max_depth != UNLIMITED_DEPTH || path_filter_active(&options->filter))) {
+        // new directories are watched wherever they are created
+        fprintf(stderr, "Error: --max-depth, --exclude, --include and --gitignore can't be combined with --watch.\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if (options->watch && (options->print_timings || options->trace_path || options->perf_counters)) {
+        // the phases of a single run are measured, watch mode never finishes one
+        fprintf(stderr, "Error: --timings, --trace and --perf-counters can't be combined with --watch.\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if (options->shard_count && (options->watch || options->bounded)) {
+        // the merge filters all candidates at once, a shard can't drop any of them
+        fprintf(stderr, "Error: --shard can't be combined with --watch or --bounded.\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if (!options->changed_list_path != !options->baseline_path) {
+        fprintf(stderr, "Error: --changed and --baseline have to be given together.\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if (options->changed_list_path && (options->watch || options->shard_count || options->pipelined)) {
+        fprintf(stderr, "Error: --changed can't be combined with --watch, --shard or --pipeline.\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if ((options->changed_list_path || options->save_baseline_path) && options->bounded) {
+        // a baseline holds every candidate, the filters run after the changed files were merged into it
+        fprintf(stderr, "Error: --changed and --save-baseline can't be combined with --bounded.\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if (options->save_baseline_path && (options->watch || options->shard_count)) {
+        fprintf(stderr, "Error: --save-baseline can't be combined with --watch or --shard.\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if (options->shard_count && !options->binary_path) {
+        fprintf(stderr, "Error: --shard needs --binary FILE for the candidates of the shard.\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    if (options->thread_count == 0) {
+        options->thread_count = online_cpu_count();
+    }
+    return 0;
+}
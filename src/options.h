@@ -0,0 +1,41 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stddef.h>
+
+#include "path_filter.h"
+
+/*
+command line options of a single run,
+filled by parse_options from argv
+*/
+typedef struct {
+    const char *path; // NULL in merge mode
+    const char *const *merge_paths; // shard files of "merge", NULL when a path is analyzed (shard_merge.h)
+    size_t merge_path_count;
+    size_t max_depth; // directory levels searched below path, UNLIMITED_DEPTH by default (directory_walker.h)
+    Path_filter filter; // --exclude, --include and --gitignore, freed by the caller
+    size_t thread_count; // also lists the directories
+    int pipelined;
+    size_t queue_capacity;
+    const char *cache_directory; // NULL if the candidate cache is disabled
+    int watch;
+    int bounded; // prefilter candidates while they are found (analysis.h)
+    size_t shard_index;
+    size_t shard_count; // 0 without --shard, else only the unfiltered candidates of the shard are written
+    const char *changed_list_path; // NULL unless only the listed files are analyzed against baseline_path (baseline.h)
+    const char *baseline_path;
+    const char *save_baseline_path; // NULL if the unfiltered candidates aren't saved as baseline
+    int tree_arenas; // parse every file in its worker's arena (tree_allocator.h)
+    int prefilter; // skip files without detector keywords (prefilter.h), on by default
+    int print_smells; // 0 if the smell lists are only written to output.csv
+    const char *binary_path; // NULL if no binary results file is written (binary_report.h)
+    int print_timings; // phase timings and slowest files after the run (trace.h)
+    const char *trace_path; // NULL if no Chrome trace is written
+    int perf_counters; // hardware counters per phase and detector (perf_counters.h)
+} Run_options;
+
+// returns 0 on success, -1 if the arguments are invalid (usage is printed)
+int parse_options(int argc, char *argv[], Run_options *options);
+
+#endif
@@ -0,0 +1,219 @@
+#include "path_filter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_PATTERN_CAPACITY 8
+
+/*
+most patterns are plain names ("build") or extensions ("*.asv"),
+they are compared directly instead of going through glob_match
+*/
+typedef enum {
+    PATTERN_LITERAL,
+    PATTERN_SUFFIX, // "*" followed by a literal
+    PATTERN_GLOB
+} Pattern_kind;
+
+void init_pattern_set(Pattern_set *set) {
+    set->patterns = NULL;
+    set->count = 0;
+    set->capacity = 0;
+}
+
+void free_pattern_set(Pattern_set *set) {
+    for (size_t pattern_i = 0; pattern_i < set->count; ++pattern_i) {
+        free(set->patterns[pattern_i].glob);
+    }
+    free(set->patterns);
+    init_pattern_set(set);
+}
+
+static int has_wildcard(const char *text, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (text[i] == '*' || text[i] == '?' || text[i] == '[' || text[i] == '\\') return 1;
+    }
+    return 0;
+}
+
+int add_pattern(Pattern_set *set, const char *pattern, size_t length) {
+    if (length > 0 && pattern[length - 1] == '\r') --length;
+    if (length == 0 || pattern[0] == '#') return 0;
+    // trailing spaces are ignored unless they are escaped
+    while (length > 0 && pattern[length - 1] == ' ' && !(length > 1 && pattern[length - 2] == '\\')) --length;
+
+    Pattern compiled = { 0 };
+    if (length > 0 && pattern[0] == '!') {
+        compiled.negated = 1;
+        ++pattern;
+        --length;
+    }
+    if (length > 0 && pattern[length - 1] == '/') {
+        compiled.directory_only = 1;
+        --length;
+    }
+    compiled.anchored = memchr(pattern, '/', length) != NULL;
+    if (length > 0 && pattern[0] == '/') {
+        ++pattern;
+        --length;
+    }
+    if (length == 0) return 0;
+
+    if (!has_wildcard(pattern, length)) {
+        compiled.kind = PATTERN_LITERAL;
+    } else if (!compiled.anchored && pattern[0] == '*' && !has_wildcard(pattern + 1, length - 1)) {
+        compiled.kind = PATTERN_SUFFIX;
+        ++pattern;
+        --length;
+    } else {
+        compiled.kind = PATTERN_GLOB;
+    }
+
+    if (set->count >= set->capacity) {
+        size_t new_capacity = set->capacity ? set->capacity * 2 : INITIAL_PATTERN_CAPACITY;
+        Pattern *larger = realloc(set->patterns, new_capacity * sizeof(Pattern));
+        if (!larger) return -1;
+        set->patterns = larger;
+        set->capacity = new_capacity;
+    }
+    compiled.glob = malloc(length + 1);
+    if (!compiled.glob) return -1;
+    memcpy(compiled.glob, pattern, length);
+    compiled.glob[length] = '\0';
+    compiled.length = length;
+    set->patterns[set->count++] = compiled;
+    return 0;
+}
+
+int add_pattern_lines(Pattern_set *set, const char *content, size_t length) {
+    const char *end = content + length;
+    while (content < end) {
+        const char *line_end = memchr(content, '\n', (size_t)(end - content));
+        if (!line_end) line_end = end;
+        if (add_pattern(set, content, (size_t)(line_end - content)) != 0) return -1;
+        content = line_end + 1;
+    }
+    return 0;
+}
+
+// matches a "[...]" class at pattern against c, *class_end is set behind the closing "]"
+static int match_class(const char *pattern, const char *pattern_end, char c, const char **class_end) {
+    const char *position = pattern + 1;
+    int negated = position < pattern_end && (*position == '!' || *position == '^');
+    if (negated) ++position;
+
+    int matched = 0;
+    // a "]" right after the opening bracket is part of the class
+    const char *first = position;
+    while (position < pattern_end && (*position != ']' || position == first)) {
+        char low = *position;
+        if (low == '\\' && position + 1 < pattern_end) low = *++position;
+        char high = low;
+        if (position + 2 < pattern_end && position[1] == '-' && position[2] != ']') {
+            high = position[2];
+            position += 2;
+            if (high == '\\' && position + 1 < pattern_end) high = *++position;
+        }
+        if ((unsigned char)c >= (unsigned char)low && (unsigned char)c <= (unsigned char)high) matched = 1;
+        ++position;
+    }
+    if (position >= pattern_end) return -1; // no closing bracket, "[" is literal
+    *class_end = position + 1;
+    return matched != negated;
+}
+
+static int glob_match(const char *pattern_begin, const char *pattern, const char *pattern_end,
+                      const char *text, const char *text_end) {
+    while (pattern < pattern_end) {
+        char c = *pattern;
+
+        if (c == '*') {
+            const char *rest = pattern + 1;
+            int is_component = pattern == pattern_begin || pattern[-1] == '/';
+            if (rest < pattern_end && *rest == '*') {
+                while (rest < pattern_end && *rest == '*') ++rest;
+                if (is_component && rest == pattern_end) {
+                    // "dir/**" matches everything inside dir
+                    return text < text_end;
+                }
+                if (is_component && *rest == '/') {
+                    // "**/" matches zero or more directories
+                    ++rest;
+                    for (const char *position = text;;) {
+                        if (glob_match(pattern_begin, rest, pattern_end, position, text_end)) return 1;
+                        position = memchr(position, '/', (size_t)(text_end - position));
+                        if (!position) return 0;
+                        ++position;
+                    }
+                }
+            }
+            // "*" stays within a path component
+            for (const char *position = text;; ++position) {
+                if (glob_match(pattern_begin, rest, pattern_end, position, text_end)) return 1;
+                if (position == text_end || *position == '/') return 0;
+            }
+        }
+
+        if (text == text_end) return 0;
+        if (c == '?') {
+            if (*text == '/') return 0;
+        } else if (c == '[') {
+            const char *class_end;
+            int matched = *text == '/' ? 0 : match_class(pattern, pattern_end, *text, &class_end);
+            if (matched == 0) return 0;
+            if (matched > 0) {
+                pattern = class_end;
+                ++text;
+                continue;
+            }
+            if (*text != '[') return 0;
+        } else {
+            if (c == '\\' && pattern + 1 < pattern_end) c = *++pattern;
+            if (c != *text) return 0;
+        }
+        ++pattern;
+        ++text;
+    }
+    return text == text_end;
+}
+
+static int pattern_matches(const Pattern *pattern, const char *text) {
+    switch (pattern->kind) {
+        case PATTERN_LITERAL:
+            return strcmp(pattern->glob, text) == 0;
+        case PATTERN_SUFFIX: {
+            size_t length = strlen(text);
+            return length >= pattern->length
+                && memcmp(text + length - pattern->length, pattern->glob, pattern->length) == 0;
+        }
+        default:
+            return glob_match(pattern->glob, pattern->glob, pattern->glob + pattern->length, text, text + strlen(text));
+    }
+}
+
+int match_pattern_set(const Pattern_set *set, const char *path, const char *name, int is_directory) {
+    // the last matching pattern decides
+    for (size_t pattern_i = set->count; pattern_i-- > 0;) {
+        const Pattern *pattern = &set->patterns[pattern_i];
+        if (pattern->directory_only && !is_directory) continue;
+        if (pattern_matches(pattern, pattern->anchored ? path : name)) {
+            return pattern->negated ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+void init_path_filter(Path_filter *filter) {
+    init_pattern_set(&filter->excludes);
+    init_pattern_set(&filter->includes);
+    filter->read_gitignore = 0;
+}
+
+void free_path_filter(Path_filter *filter) {
+    free_pattern_set(&filter->excludes);
+    free_pattern_set(&filter->includes);
+}
+
+int path_filter_active(const Path_filter *filter) {
+    return filter->excludes.count > 0 || filter->includes.count > 0 || filter->read_gitignore;
+}
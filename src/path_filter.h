@@ -0,0 +1,60 @@
+#ifndef PATH_FILTER_H
+#define PATH_FILTER_H
+
+#include <stddef.h>
+
+/*
+gitignore style patterns. "*", "?" and "[...]" don't match "/",
+"**" as a whole path component matches any number of directories,
+"\" escapes the next character. a leading "!" re-includes what an
+earlier pattern excluded and a trailing "/" only matches
+directories. a pattern with a "/" anywhere else is matched against
+the path relative to the directory of its set, all others against
+the last path component at any depth.
+*/
+typedef struct {
+    char *glob;
+    size_t length;
+    unsigned char kind; // compiled form, see path_filter.c
+    unsigned char negated;
+    unsigned char directory_only;
+    unsigned char anchored;
+} Pattern;
+
+typedef struct {
+    Pattern *patterns;
+    size_t count;
+    size_t capacity;
+} Pattern_set;
+
+void init_pattern_set(Pattern_set *set);
+void free_pattern_set(Pattern_set *set);
+// blank lines and "#" comments are skipped, returns -1 if out of memory
+int add_pattern(Pattern_set *set, const char *pattern, size_t length);
+// adds every line of content (e.g. a .gitignore file)
+int add_pattern_lines(Pattern_set *set, const char *content, size_t length);
+
+/*
+path is relative to the directory of the set and name is its last
+component. returns 1 if the last matching pattern excludes the path,
+-1 if it is negated and 0 if no pattern matches.
+*/
+int match_pattern_set(const Pattern_set *set, const char *path, const char *name, int is_directory);
+
+/*
+what the directory walker (directory_walker.h) skips. excluded
+directories are never opened. --exclude patterns take precedence
+over .gitignore files, a deeper .gitignore over the ones above it.
+*/
+typedef struct {
+    Pattern_set excludes;
+    Pattern_set includes; // if there are any, a file has to match one of them
+    int read_gitignore; // honor .gitignore files in every searched directory
+} Path_filter;
+
+void init_path_filter(Path_filter *filter);
+void free_path_filter(Path_filter *filter);
+// 0 if the filter can't exclude anything
+int path_filter_active(const Path_filter *filter);
+
+#endif
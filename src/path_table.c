@@ -0,0 +1,66 @@
+#include "path_table.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PATH_BLOCK_SIZE (64 * 1024)
+
+typedef struct Path_block Path_block;
+
+struct Path_block {
+    Path_block *next;
+    size_t used;
+    size_t capacity;
+    char data[];
+};
+
+static Path_block *current_block = NULL;
+static pthread_mutex_t path_table_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static Path_block *new_block(size_t min_size, Path_block *next) {
+    size_t capacity = min_size > PATH_BLOCK_SIZE ? min_size : PATH_BLOCK_SIZE;
+    Path_block *block = malloc(sizeof(Path_block) + capacity);
+    if (!block) return NULL;
+    block->next = next;
+    block->used = 0;
+    block->capacity = capacity;
+    return block;
+}
+
+const char *path_table_add(const char *path) {
+    return path_table_add_length(path, strlen(path));
+}
+
+const char *path_table_add_length(const char *path, size_t length) {
+    size_t size = length + 1;
+
+    pthread_mutex_lock(&path_table_mutex);
+    if (!current_block || current_block->capacity - current_block->used < size) {
+        Path_block *block = new_block(size, current_block);
+        if (!block) {
+            pthread_mutex_unlock(&path_table_mutex);
+            fprintf(stderr, "Failed to allocate memory for path table.\n");
+            return NULL;
+        }
+        current_block = block;
+    }
+    char *stored = current_block->data + current_block->used;
+    current_block->used += size;
+    pthread_mutex_unlock(&path_table_mutex);
+
+    memcpy(stored, path, length);
+    stored[length] = '\0';
+    return stored;
+}
+
+void free_path_table(void) {
+    pthread_mutex_lock(&path_table_mutex);
+    while (current_block) {
+        Path_block *next = current_block->next;
+        free(current_block);
+        current_block = next;
+    }
+    pthread_mutex_unlock(&path_table_mutex);
+}
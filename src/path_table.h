@@ -0,0 +1,19 @@
+#ifndef PATH_TABLE_H
+#define PATH_TABLE_H
+
+#include <stddef.h>
+
+/*
+global storage for the file names of all analyzed files.
+names are copied into large blocks and never move, so smell
+locations can keep pointers to them after the file itself
+(and its content) has been freed.
+adding is thread safe.
+*/
+
+const char *path_table_add(const char *path);
+// adds the first length bytes of path, which doesn't have to be null terminated
+const char *path_table_add_length(const char *path, size_t length);
+void free_path_table(void);
+
+#endif
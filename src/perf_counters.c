@@ -0,0 +1,296 @@
+// syscall() is not part of POSIX
+#define _DEFAULT_SOURCE
+#include "perf_counters.h"
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// distinct phase and name pairs per thread and in the report
+#define MAX_COUNTER_ROWS 64
+
+typedef struct {
+    int phase;
+    const char *phase_name;
+    const char *name;
+    Counter_values totals;
+    size_t count;
+} Counter_row;
+
+// counter group and rows of one thread, only that thread changes them until the report
+typedef struct Counter_thread {
+    struct Counter_thread *next;
+    int fds[COUNTER_COUNT]; // fds[COUNTER_CYCLES] leads the group, -1 if not open
+    int slots[COUNTER_COUNT]; // position in a group read, -1 if the counter isn't part of the group
+    size_t slot_count;
+    Counter_row rows[MAX_COUNTER_ROWS];
+    size_t row_count;
+    uint64_t node_count;
+} Counter_thread;
+
+static const struct {
+    const char *name;
+    uint64_t config;
+} counter_events[COUNTER_COUNT] = {
+    [COUNTER_CYCLES] = {"cycles", PERF_COUNT_HW_CPU_CYCLES},
+    [COUNTER_INSTRUCTIONS] = {"instructions", PERF_COUNT_HW_INSTRUCTIONS},
+    [COUNTER_CACHE_MISSES] = {"cache misses", PERF_COUNT_HW_CACHE_MISSES},
+    [COUNTER_BRANCH_MISSES] = {"branch misses", PERF_COUNT_HW_BRANCH_MISSES}
+};
+
+static int enabled = 0;
+// counters the hardware supports, others are reported as missing
+static int available[COUNTER_COUNT];
+static pthread_mutex_t threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Counter_thread *threads = NULL;
+static _Thread_local Counter_thread *current_thread = NULL;
+
+static int open_counter(uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    // the leader starts disabled and enables the whole group at once
+    attr.disabled = group_fd == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // pid 0 and any cpu: only the calling thread is counted
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static void close_group(Counter_thread *thread) {
+    for (size_t counter_i = 0; counter_i < COUNTER_COUNT; ++counter_i) {
+        if (thread->fds[counter_i] >= 0) close(thread->fds[counter_i]);
+        thread->fds[counter_i] = -1;
+    }
+}
+
+// returns -1 if the leader couldn't be opened, members that fail are left out
+static int open_group(Counter_thread *thread) {
+    for (size_t counter_i = 0; counter_i < COUNTER_COUNT; ++counter_i) {
+        thread->fds[counter_i] = -1;
+        thread->slots[counter_i] = -1;
+    }
+    thread->slot_count = 0;
+
+    int leader = open_counter(counter_events[COUNTER_CYCLES].config, -1);
+    if (leader < 0) return -1;
+    thread->fds[COUNTER_CYCLES] = leader;
+    thread->slots[COUNTER_CYCLES] = (int)thread->slot_count++;
+    for (size_t counter_i = COUNTER_CYCLES + 1; counter_i < COUNTER_COUNT; ++counter_i) {
+        if (!available[counter_i]) continue;
+        int fd = open_counter(counter_events[counter_i].config, leader);
+        if (fd < 0) continue;
+        thread->fds[counter_i] = fd;
+        thread->slots[counter_i] = (int)thread->slot_count++;
+    }
+    if (ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0) {
+        close_group(thread);
+        return -1;
+    }
+    return 0;
+}
+
+int init_perf_counters(void) {
+    // probe every counter once, a thread's group only holds the available ones
+    for (size_t counter_i = 0; counter_i < COUNTER_COUNT; ++counter_i) {
+        int fd = open_counter(counter_events[counter_i].config, -1);
+        available[counter_i] = fd >= 0;
+        if (fd >= 0) {
+            close(fd);
+        } else if (counter_i == COUNTER_CYCLES) {
+            fprintf(stderr, "Failed to open performance counters: %s.\n", strerror(errno));
+            fprintf(stderr, "Counting in user space may need a lower /proc/sys/kernel/perf_event_paranoid.\n");
+            return -1;
+        }
+    }
+    enabled = 1;
+    return 0;
+}
+
+int perf_counters_enabled(void) {
+    return enabled;
+}
+
+void free_perf_counters(void) {
+    pthread_mutex_lock(&threads_mutex);
+    while (threads) {
+        Counter_thread *next = threads->next;
+        close_group(threads);
+        free(threads);
+        threads = next;
+    }
+    pthread_mutex_unlock(&threads_mutex);
+    current_thread = NULL;
+    enabled = 0;
+}
+
+static Counter_thread *get_current_thread(void) {
+    if (current_thread) return current_thread;
+    Counter_thread *thread = calloc(1, sizeof(Counter_thread));
+    if (!thread) return NULL;
+    if (open_group(thread) != 0) {
+        // the thread is still registered, its scopes count as 0
+        fprintf(stderr, "Failed to open performance counters for a thread.\n");
+    }
+    pthread_mutex_lock(&threads_mutex);
+    thread->next = threads;
+    threads = thread;
+    pthread_mutex_unlock(&threads_mutex);
+    current_thread = thread;
+    return thread;
+}
+
+void read_perf_counters(Counter_values *values) {
+    memset(values, 0, sizeof(*values));
+    Counter_thread *thread = enabled ? get_current_thread() : NULL;
+    if (!thread || thread->fds[COUNTER_CYCLES] < 0) return;
+
+    // nr, time enabled, time running, one value per group member
+    uint64_t buffer[3 + COUNTER_COUNT];
+    ssize_t bytes_read = read(thread->fds[COUNTER_CYCLES], buffer, sizeof(buffer));
+    if (bytes_read < (ssize_t)(3 * sizeof(uint64_t)) || buffer[0] != thread->slot_count) return;
+
+    // scaled up if the group had to share the hardware with other events
+    double scale = buffer[2] > 0 && buffer[2] < buffer[1] ? (double)buffer[1] / buffer[2] : 1.0;
+    for (size_t counter_i = 0; counter_i < COUNTER_COUNT; ++counter_i) {
+        if (thread->slots[counter_i] < 0) continue;
+        uint64_t value = buffer[3 + thread->slots[counter_i]];
+        values->values[counter_i] = scale == 1.0 ? value : (uint64_t)(value * scale);
+    }
+}
+
+static int same_name(const char *name_a, const char *name_b) {
+    if (!name_a || !name_b) return name_a == name_b;
+    return strcmp(name_a, name_b) == 0;
+}
+
+static Counter_row *find_row(Counter_row *rows, size_t *row_count, int phase, const char *phase_name,
+                             const char *name) {
+    for (size_t row_i = 0; row_i < *row_count; ++row_i) {
+        if (rows[row_i].phase == phase && same_name(rows[row_i].name, name)) return &rows[row_i];
+    }
+    if (*row_count >= MAX_COUNTER_ROWS) return NULL;
+    Counter_row *row = &rows[(*row_count)++];
+    memset(row, 0, sizeof(*row));
+    row->phase = phase;
+    row->phase_name = phase_name;
+    row->name = name;
+    return row;
+}
+
+void add_counted_scope(int phase, const char *phase_name, const char *name,
+                       const Counter_values *begin, const Counter_values *end) {
+    Counter_thread *thread = enabled ? get_current_thread() : NULL;
+    if (!thread) return;
+    Counter_row *row = find_row(thread->rows, &thread->row_count, phase, phase_name, name);
+    if (!row) return;
+    for (size_t counter_i = 0; counter_i < COUNTER_COUNT; ++counter_i) {
+        // a group that couldn't be read in between reports 0, never a negative count
+        if (end->values[counter_i] > begin->values[counter_i]) {
+            row->totals.values[counter_i] += end->values[counter_i] - begin->values[counter_i];
+        }
+    }
+    row->count++;
+}
+
+void add_counted_nodes(uint64_t node_count) {
+    Counter_thread *thread = enabled ? get_current_thread() : NULL;
+    if (thread) thread->node_count += node_count;
+}
+
+static void print_counter(FILE *file, Counter_id counter, uint64_t value) {
+    if (available[counter]) {
+        fprintf(file, " %14llu", (unsigned long long)value);
+    } else {
+        fprintf(file, " %14s", "-");
+    }
+}
+
+static void print_per_kilo_node(FILE *file, Counter_id counter, uint64_t value, uint64_t node_count) {
+    if (available[counter] && node_count > 0) {
+        fprintf(file, " %11.2f", 1000.0 * value / node_count);
+    } else {
+        fprintf(file, " %11s", "-");
+    }
+}
+
+static void print_row(FILE *file, const char *label, int indent, const Counter_values *totals,
+                      uint64_t node_count) {
+    fprintf(file, "  %*s%-*s", indent, "", 22 - indent, label);
+    for (size_t counter_i = 0; counter_i < COUNTER_COUNT; ++counter_i) {
+        print_counter(file, counter_i, totals->values[counter_i]);
+    }
+    uint64_t cycles = totals->values[COUNTER_CYCLES];
+    if (available[COUNTER_INSTRUCTIONS] && cycles > 0) {
+        fprintf(file, " %6.2f", (double)totals->values[COUNTER_INSTRUCTIONS] / cycles);
+    } else {
+        fprintf(file, " %6s", "-");
+    }
+    print_per_kilo_node(file, COUNTER_CACHE_MISSES, totals->values[COUNTER_CACHE_MISSES], node_count);
+    print_per_kilo_node(file, COUNTER_BRANCH_MISSES, totals->values[COUNTER_BRANCH_MISSES], node_count);
+    fprintf(file, "\n");
+}
+
+static void add_values(Counter_values *target, const Counter_values *values) {
+    for (size_t counter_i = 0; counter_i < COUNTER_COUNT; ++counter_i) {
+        target->values[counter_i] += values->values[counter_i];
+    }
+}
+
+void print_perf_counters(FILE *file) {
+    if (!enabled) return;
+    pthread_mutex_lock(&threads_mutex);
+
+    // rows of all threads merged, then ordered by phase (stable, names keep their first appearance)
+    Counter_row rows[MAX_COUNTER_ROWS];
+    size_t row_count = 0;
+    uint64_t node_count = 0;
+    for (const Counter_thread *thread = threads; thread; thread = thread->next) {
+        node_count += thread->node_count;
+        for (size_t row_i = 0; row_i < thread->row_count; ++row_i) {
+            const Counter_row *source = &thread->rows[row_i];
+            Counter_row *row = find_row(rows, &row_count, source->phase, source->phase_name, source->name);
+            if (!row) continue;
+            add_values(&row->totals, &source->totals);
+            row->count += source->count;
+        }
+    }
+    pthread_mutex_unlock(&threads_mutex);
+    for (size_t row_i = 1; row_i < row_count; ++row_i) {
+        Counter_row row = rows[row_i];
+        size_t position = row_i;
+        for (; position > 0 && rows[position - 1].phase > row.phase; --position) rows[position] = rows[position - 1];
+        rows[position] = row;
+    }
+
+    fprintf(file, "Performance counters (user space, summed over all threads, %llu syntax tree nodes):\n",
+            (unsigned long long)node_count);
+    fprintf(file, "  %-22s", "scope");
+    for (size_t counter_i = 0; counter_i < COUNTER_COUNT; ++counter_i) {
+        fprintf(file, " %14s", counter_events[counter_i].name);
+    }
+    fprintf(file, " %6s %11s %11s\n", "IPC", "cache/knode", "branch/knode");
+
+    for (size_t first = 0; first < row_count;) {
+        size_t last = first;
+        Counter_values phase_totals = {{0}};
+        int has_names = 0;
+        for (; last < row_count && rows[last].phase == rows[first].phase; ++last) {
+            add_values(&phase_totals, &rows[last].totals);
+            if (rows[last].name) has_names = 1;
+        }
+        print_row(file, rows[first].phase_name, 0, &phase_totals, node_count);
+        for (size_t row_i = first; has_names && row_i < last; ++row_i) {
+            if (rows[row_i].name) print_row(file, rows[row_i].name, 2, &rows[row_i].totals, node_count);
+        }
+        first = last;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+hardware performance counters of the calling thread through
+Linux perf_event_open, user space only. every thread opens its
+own counter group the first time it reads it, so the counts of
+a scope only contain the work of the thread that ran it. the
+scopes are reported per phase and name (trace.h begin_scope and
+end_scope), misses are also given per 1000 syntax tree nodes.
+*/
+
+typedef enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_CACHE_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_COUNT
+} Counter_id;
+
+typedef struct {
+    uint64_t values[COUNTER_COUNT];
+} Counter_values;
+
+// returns -1 if the counters can't be opened (e.g. perf_event_paranoid), the reason is printed
+int init_perf_counters(void);
+int perf_counters_enabled(void);
+void free_perf_counters(void);
+
+// current counts of the calling thread, all 0 if its group couldn't be opened
+void read_perf_counters(Counter_values *values);
+
+/*
+adds the counts between begin and end to the row of phase and
+name (name may be NULL), rows are printed in the order of phase
+and name strings have to stay valid until the report
+*/
+void add_counted_scope(int phase, const char *phase_name, const char *name,
+                       const Counter_values *begin, const Counter_values *end);
+// syntax tree nodes of the parsed files, the reference of the misses per kilo-node
+void add_counted_nodes(uint64_t node_count);
+
+void print_perf_counters(FILE *file);
+
+#endif
@@ -0,0 +1,142 @@
+#include "prefilter.h"
+#include "detector_registry.h"
+#include "line_index.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef int (*Keyword_kernel)(const char *text, size_t length, const char *keyword, size_t keyword_length);
+
+typedef struct {
+    const char **keywords; // distinct keywords of all detectors
+    size_t *keyword_lengths;
+    size_t keyword_count;
+    int usable; // 0 if a detector has no keywords or the list couldn't be allocated
+} Prefilter;
+
+static Prefilter prefilter;
+static pthread_once_t prefilter_once = PTHREAD_ONCE_INIT;
+static int prefilter_enabled = 1;
+static atomic_size_t skipped_count;
+
+static int contains_keyword_scalar(const char *text, size_t length, const char *keyword, size_t keyword_length) {
+    const char *end = text + length;
+    while ((size_t)(end - text) >= keyword_length) {
+        // the last possible start of the keyword is the end of the search
+        const char *found = memchr(text, keyword[0], (size_t)(end - text) - keyword_length + 1);
+        if (!found) return 0;
+        if (memcmp(found, keyword, keyword_length) == 0) return 1;
+        text = found + 1;
+    }
+    return 0;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_KERNEL 1
+#include <immintrin.h>
+
+/*
+compares the first and the last byte of the keyword with 32
+positions at once, only the positions where both match are
+compared in full. compiled for AVX2 only, select_keyword_kernel checks
+that the CPU supports it (vector_scans_enabled, line_index.h).
+*/
+__attribute__((target("avx2")))
+static int contains_keyword_avx2(const char *text, size_t length, const char *keyword, size_t keyword_length) {
+    __m256i first = _mm256_set1_epi8(keyword[0]);
+    __m256i last = _mm256_set1_epi8(keyword[keyword_length - 1]);
+    size_t position = 0;
+    for (; position + 32 + keyword_length - 1 <= length; position += 32) {
+        __m256i first_block = _mm256_loadu_si256((const __m256i *)(text + position));
+        __m256i last_block = _mm256_loadu_si256((const __m256i *)(text + position + keyword_length - 1));
+        __m256i matches = _mm256_and_si256(_mm256_cmpeq_epi8(first, first_block),
+                                           _mm256_cmpeq_epi8(last, last_block));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(matches);
+        while (mask) {
+            size_t start = position + (size_t)__builtin_ctz(mask);
+            if (memcmp(text + start, keyword, keyword_length) == 0) return 1;
+            mask &= mask - 1;
+        }
+    }
+    return contains_keyword_scalar(text + position, length - position, keyword, keyword_length);
+}
+#endif
+
+static Keyword_kernel select_keyword_kernel(void) {
+#ifdef HAVE_AVX2_KERNEL
+    if (vector_scans_enabled()) return contains_keyword_avx2;
+#endif
+    return contains_keyword_scalar;
+}
+
+static int add_keyword(Prefilter *filter, const char *keyword, size_t capacity) {
+    size_t keyword_length = strlen(keyword);
+    if (keyword_length == 0) return -1; // every file would contain it
+    for (size_t keyword_i = 0; keyword_i < filter->keyword_count; ++keyword_i) {
+        if (strcmp(filter->keywords[keyword_i], keyword) == 0) return 0;
+    }
+    if (filter->keyword_count == capacity) return -1;
+    filter->keywords[filter->keyword_count] = keyword;
+    filter->keyword_lengths[filter->keyword_count] = keyword_length;
+    ++filter->keyword_count;
+    return 0;
+}
+
+static void collect_keywords(void) {
+    size_t capacity = 0;
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        const char *const *keywords = detectors[detector_i]->keywords;
+        if (!keywords) return; // the detector has to see every file
+        for (size_t keyword_i = 0; keywords[keyword_i]; ++keyword_i) ++capacity;
+    }
+    prefilter.keywords = malloc((capacity ? capacity : 1) * sizeof(const char *));
+    prefilter.keyword_lengths = malloc((capacity ? capacity : 1) * sizeof(size_t));
+    if (!prefilter.keywords || !prefilter.keyword_lengths) {
+        fprintf(stderr, "Failed to allocate memory for the prefilter, every file is parsed.\n");
+        return;
+    }
+
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        for (const char *const *keyword = detectors[detector_i]->keywords; *keyword; ++keyword) {
+            if (add_keyword(&prefilter, *keyword, capacity) != 0) return;
+        }
+    }
+    prefilter.usable = 1;
+}
+
+static int is_whitespace(char byte) {
+    return byte == ' ' || byte == '\t' || byte == '\n' || byte == '\r' || byte == '\f' || byte == '\v';
+}
+
+void enable_prefilter(int enabled) {
+    prefilter_enabled = enabled;
+}
+
+int file_needs_parse(const Matlab_file *file) {
+    if (!prefilter_enabled) return 1;
+    pthread_once(&prefilter_once, collect_keywords);
+    if (!prefilter.usable) return 1;
+
+    Keyword_kernel contains_keyword = select_keyword_kernel();
+    for (size_t keyword_i = 0; keyword_i < prefilter.keyword_count; ++keyword_i) {
+        if (contains_keyword(file->content, file->length, prefilter.keywords[keyword_i],
+                             prefilter.keyword_lengths[keyword_i])) {
+            return 1;
+        }
+    }
+    atomic_fetch_add_explicit(&skipped_count, 1, memory_order_relaxed);
+    return 0;
+}
+
+uint32_t count_unparsed_LOC(const Matlab_file *file) {
+    size_t start = 0;
+    while (start < file->length && is_whitespace(file->content[start])) ++start;
+    return (uint32_t)count_newlines(file->content + start, file->length - start) + 1;
+}
+
+size_t prefilter_skipped_count(void) {
+    return atomic_load_explicit(&skipped_count, memory_order_relaxed);
+}
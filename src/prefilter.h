@@ -0,0 +1,35 @@
+#ifndef PREFILTER_H
+#define PREFILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "matlab_file_list.h"
+
+/*
+lexical prefilter of the workers (analysis.h). every detector
+lists the keywords (Smell_detector.keywords) without which none
+of its hooks can run, a file that contains none of the keywords
+of any detector has no candidates and isn't parsed at all. the
+keywords are searched as plain bytes, also in comments and
+strings, so the prefilter can only let too many files through.
+a detector without keywords turns the prefilter off. it is on
+unless disabled, watch mode (watch.h) always parses.
+*/
+
+void enable_prefilter(int enabled);
+
+// 1 if the file has to be parsed, always 1 while the prefilter is disabled. counts the other files
+int file_needs_parse(const Matlab_file *file);
+
+/*
+the LOC count_LOC gives for the root node of the file, without
+parsing it: the root node starts at the first byte that isn't
+whitespace and ends at the end of the file.
+*/
+uint32_t count_unparsed_LOC(const Matlab_file *file);
+
+// files file_needs_parse rejected since the program started, they weren't parsed
+size_t prefilter_skipped_count(void);
+
+#endif
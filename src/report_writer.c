@@ -0,0 +1,299 @@
+#include "report_writer.h"
+#include "detector_registry.h"
+
+#include <math.h> // signbit only, no libm needed
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_REPORT_CAPACITY (64 * 1024)
+// buffers with a sink are written in chunks of this size
+#define REPORT_FLUSH_SIZE (1024 * 1024)
+// larger values don't fit the integer formatting, printf handles them
+#define MAX_FIXED_VALUE 1e15
+
+void init_report_buffer(Report_buffer *buffer, FILE *sink) {
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+    buffer->sink = sink;
+    buffer->failed = 0;
+}
+
+void free_report_buffer(Report_buffer *buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+}
+
+int flush_report_buffer(Report_buffer *buffer, FILE *file) {
+    if (buffer->size > 0 && fwrite(buffer->data, 1, buffer->size, file) != buffer->size) {
+        buffer->failed = 1;
+    }
+    buffer->size = 0;
+    return buffer->failed ? -1 : 0;
+}
+
+static int reserve_bytes(Report_buffer *buffer, size_t length) {
+    if (buffer->size + length <= buffer->capacity) return 0;
+    if (buffer->sink && buffer->size > 0) {
+        flush_report_buffer(buffer, buffer->sink);
+        if (length <= buffer->capacity) return 0;
+    }
+
+    size_t new_capacity = buffer->capacity ? buffer->capacity * 2 : INITIAL_REPORT_CAPACITY;
+    while (new_capacity < buffer->size + length) new_capacity *= 2;
+    char *larger = realloc(buffer->data, new_capacity);
+    if (!larger) {
+        fprintf(stderr, "Failed to allocate memory for the report.\n");
+        buffer->failed = 1;
+        return -1;
+    }
+    buffer->data = larger;
+    buffer->capacity = new_capacity;
+    return 0;
+}
+
+void append_bytes(Report_buffer *buffer, const char *bytes, size_t length) {
+    if (buffer->failed || reserve_bytes(buffer, length) != 0) return;
+    memcpy(buffer->data + buffer->size, bytes, length);
+    buffer->size += length;
+    if (buffer->sink && buffer->size >= REPORT_FLUSH_SIZE) {
+        flush_report_buffer(buffer, buffer->sink);
+    }
+}
+
+void append_text(Report_buffer *buffer, const char *text) {
+    append_bytes(buffer, text, strlen(text));
+}
+
+// writes the digits of value right aligned into the end of digits, returns the first digit
+static char *format_digits(uint64_t value, char *end) {
+    char *digit = end;
+    do {
+        *--digit = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    return digit;
+}
+
+void append_int(Report_buffer *buffer, int64_t value) {
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    // negated as unsigned, so INT64_MIN doesn't overflow
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    char *first = format_digits(magnitude, end);
+    if (value < 0) *--first = '-';
+    append_bytes(buffer, first, (size_t)(end - first));
+}
+
+void append_fixed2(Report_buffer *buffer, float value) {
+    double magnitude = value < 0 ? -(double)value : (double)value;
+    if (!(magnitude < MAX_FIXED_VALUE)) {
+        // infinite, NaN or too large
+        char text[512];
+        int length = snprintf(text, sizeof(text), "%.2f", value);
+        if (length > 0) append_bytes(buffer, text, (size_t)length < sizeof(text) ? (size_t)length : sizeof(text) - 1);
+        return;
+    }
+
+    // a float has 24 significant bits, so the scaled value is exact and can be rounded like printf (to even)
+    double scaled = magnitude * 100.0;
+    uint64_t hundredths = (uint64_t)scaled;
+    double fraction = scaled - (double)hundredths;
+    if (fraction > 0.5 || (fraction == 0.5 && (hundredths & 1))) hundredths++;
+
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *first = format_digits(hundredths / 100, end - 3);
+    end[-3] = '.';
+    end[-2] = (char)('0' + hundredths / 10 % 10);
+    end[-1] = (char)('0' + hundredths % 10);
+    if (signbit(value)) *--first = '-';
+    append_bytes(buffer, first, (size_t)(end - first));
+}
+
+static void append_metric(Report_buffer *buffer, const Smell_list *list, size_t smell_i, size_t metric_i) {
+    Metric_value value = list->columns[metric_i][smell_i];
+    if (list->metrics[metric_i].is_float) {
+        append_fixed2(buffer, value.float_value);
+    } else {
+        append_int(buffer, value.int_value);
+    }
+}
+
+void format_smell_list(Report_buffer *buffer, const Smell_list *list) {
+    for (size_t smell_i = 0; smell_i < list->count; ++smell_i) {
+        const Smell_location *location = &list->locations[smell_i];
+        append_text(buffer, "-------------\nFile: ");
+        append_text(buffer, location->file_name);
+        append_text(buffer, " Line: ");
+        append_int(buffer, location->line);
+        append_bytes(buffer, "\n", 1);
+        for (size_t metric_i = 0; metric_i < list->metric_count; ++metric_i) {
+            append_text(buffer, "Metric: ");
+            append_text(buffer, list->metrics[metric_i].name);
+            append_text(buffer, ", Measured Value: ");
+            append_metric(buffer, list, smell_i, metric_i);
+            append_bytes(buffer, "\n", 1);
+        }
+    }
+    append_bytes(buffer, "\n", 1);
+}
+
+void print_smell_list(const Smell_list *list) {
+    Report_buffer buffer;
+    init_report_buffer(&buffer, stdout);
+    format_smell_list(&buffer, list);
+    flush_report_buffer(&buffer, stdout);
+    free_report_buffer(&buffer);
+}
+
+// column_count metric name and value pairs, missing metrics stay empty
+static void format_smell_csv(Report_buffer *buffer, const Smell_list *list, const char *detector_name,
+                             size_t column_count) {
+    for (size_t smell_i = 0; smell_i < list->count; ++smell_i) {
+        append_text(buffer, detector_name);
+        append_text(buffer, ",\"");
+        append_text(buffer, list->locations[smell_i].file_name);
+        append_text(buffer, "\",");
+        append_int(buffer, list->locations[smell_i].line);
+        for (size_t metric_i = 0; metric_i < column_count; ++metric_i) {
+            if (metric_i >= list->metric_count) {
+                append_text(buffer, ",,");
+                continue;
+            }
+            append_bytes(buffer, ",", 1);
+            append_text(buffer, list->metrics[metric_i].name);
+            append_bytes(buffer, ",", 1);
+            append_metric(buffer, list, smell_i, metric_i);
+        }
+        append_bytes(buffer, "\n", 1);
+    }
+}
+
+typedef enum {
+    SECTION_TEXT,
+    SECTION_CSV
+} Section_format;
+
+typedef struct {
+    Section_format format;
+    size_t column_count; // CSV only
+} Report_layout;
+
+static void format_section(Report_buffer *buffer, const Report_layout *layout, size_t detector_i) {
+    const Smell_detector *detector = detectors[detector_i];
+    if (layout->format == SECTION_CSV) {
+        format_smell_csv(buffer, detector->smell_list, detector->name, layout->column_count);
+        return;
+    }
+    append_text(buffer, "Smell List: ");
+    append_text(buffer, detector->name);
+    append_bytes(buffer, "\n", 1);
+    format_smell_list(buffer, detector->smell_list);
+}
+
+// formats the sections first, first + stride, ... into their own buffers
+typedef struct {
+    const Report_layout *layout;
+    Report_buffer *sections;
+    size_t first;
+    size_t stride;
+} Section_worker;
+
+static void *run_section_worker(void *argument) {
+    Section_worker *worker = argument;
+    for (size_t detector_i = worker->first; detector_i < detector_count; detector_i += worker->stride) {
+        format_section(&worker->sections[detector_i], worker->layout, detector_i);
+    }
+    return NULL;
+}
+
+static int write_sections(FILE *file, const Report_layout *layout, size_t thread_count) {
+    if (thread_count > detector_count) thread_count = detector_count;
+    if (thread_count <= 1) {
+        Report_buffer buffer;
+        init_report_buffer(&buffer, file);
+        for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+            format_section(&buffer, layout, detector_i);
+        }
+        int result = flush_report_buffer(&buffer, file);
+        free_report_buffer(&buffer);
+        return result;
+    }
+
+    Report_buffer sections[detector_count];
+    Section_worker workers[thread_count];
+    pthread_t threads[thread_count];
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        init_report_buffer(&sections[detector_i], NULL);
+    }
+
+    // the calling thread formats its share as worker 0
+    size_t started = 1;
+    for (size_t worker_i = 0; worker_i < thread_count; ++worker_i) {
+        workers[worker_i] = (Section_worker){ layout, sections, worker_i, thread_count };
+    }
+    for (; started < thread_count; ++started) {
+        if (pthread_create(&threads[started], NULL, run_section_worker, &workers[started]) != 0) break;
+    }
+    // sections of workers that couldn't be started are formatted here as well
+    for (size_t worker_i = started; worker_i < thread_count; ++worker_i) {
+        run_section_worker(&workers[worker_i]);
+    }
+    run_section_worker(&workers[0]);
+    for (size_t worker_i = 1; worker_i < started; ++worker_i) {
+        pthread_join(threads[worker_i], NULL);
+    }
+
+    int result = 0;
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        if (flush_report_buffer(&sections[detector_i], file) != 0) result = -1;
+        free_report_buffer(&sections[detector_i]);
+    }
+    return result;
+}
+
+int print_smell_lists(size_t thread_count) {
+    Report_layout layout = { SECTION_TEXT, 0 };
+    int result = write_sections(stdout, &layout, thread_count);
+    fflush(stdout);
+    return result;
+}
+
+int smell_lists_to_CSV(size_t thread_count) {
+    FILE *file = fopen("output.csv", "w");
+    if (!file) {
+        perror("output.csv");
+        return -1;
+    }
+
+    // as many metric columns as the detector with the most metrics needs
+    Report_layout layout = { SECTION_CSV, 0 };
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        if (detectors[detector_i]->metric_count > layout.column_count) {
+            layout.column_count = detectors[detector_i]->metric_count;
+        }
+    }
+
+    Report_buffer header;
+    init_report_buffer(&header, NULL);
+    append_text(&header, "smell_type,file_name,line");
+    for (size_t metric_i = 0; metric_i < layout.column_count; ++metric_i) {
+        append_text(&header, ",metric");
+        append_int(&header, (int64_t)metric_i + 1);
+        append_text(&header, "_name,metric");
+        append_int(&header, (int64_t)metric_i + 1);
+        append_text(&header, "_measured_value");
+    }
+    append_bytes(&header, "\n", 1);
+    int result = flush_report_buffer(&header, file);
+    free_report_buffer(&header);
+
+    if (write_sections(file, &layout, thread_count) != 0) result = -1;
+    if (fclose(file) != 0) result = -1;
+    if (result != 0) fprintf(stderr, "Failed to write output.csv.\n");
+    return result;
+}
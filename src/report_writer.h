@@ -0,0 +1,47 @@
+#ifndef REPORT_WRITER_H
+#define REPORT_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "smell_list.h"
+
+/*
+growable output buffer, reports are formatted into it by hand
+instead of one printf call per field. numbers come out like %d
+and %.2f in the C locale. with a sink, the buffer is written to
+it whenever REPORT_FLUSH_SIZE bytes are collected, without one it
+keeps everything (sections formatted in parallel).
+*/
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+    FILE *sink; // NULL if the buffer is written by the caller
+    int failed;
+} Report_buffer;
+
+void init_report_buffer(Report_buffer *buffer, FILE *sink);
+void free_report_buffer(Report_buffer *buffer);
+void append_bytes(Report_buffer *buffer, const char *bytes, size_t length);
+void append_text(Report_buffer *buffer, const char *text);
+void append_int(Report_buffer *buffer, int64_t value);
+void append_fixed2(Report_buffer *buffer, float value);
+// writes and empties the buffer, returns -1 if anything couldn't be formatted or written
+int flush_report_buffer(Report_buffer *buffer, FILE *file);
+
+// the human readable smell list, one block per smell
+void format_smell_list(Report_buffer *buffer, const Smell_list *list);
+void print_smell_list(const Smell_list *list);
+
+/*
+both write one section per detector, formatted by up to
+thread_count threads and written in detector order.
+print_smell_lists prints the smell lists to stdout,
+smell_lists_to_CSV writes them to output.csv.
+*/
+int print_smell_lists(size_t thread_count);
+int smell_lists_to_CSV(size_t thread_count);
+
+#endif
@@ -0,0 +1,173 @@
+#include "shard_merge.h"
+#include "binary_report.h"
+#include "detector_registry.h"
+#include "directory_walker.h"
+#include "path_table.h"
+#include "smell_list.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    Binary_results results;
+    const char **interned; // path table entry of every string id, NULL until it is used
+} Shard;
+
+// the candidates of one detector in one shard, position is the next smell to merge
+typedef struct {
+    Shard *shard;
+    Binary_detector detector;
+    uint64_t position;
+    uint32_t *metric_columns; // column in the shard of every metric of the detector
+} Cursor;
+
+static int open_shards(Shard *shards, const char *const *paths, size_t path_count) {
+    const char **shard_paths = calloc(path_count, sizeof(const char *));
+    if (!shard_paths) {
+        fprintf(stderr, "Failed to allocate memory for %zu shards.\n", path_count);
+        return -1;
+    }
+
+    int result = 0;
+    for (size_t shard_i = 0; shard_i < path_count && result == 0; ++shard_i) {
+        Shard *shard = &shards[shard_i];
+        const char *path = paths[shard_i];
+        if (open_binary_results(path, &shard->results) != 0) {
+            result = -1;
+            break;
+        }
+
+        const Binary_run_info *info = &shard->results.info;
+        shard->interned = calloc(shard->results.string_count ? shard->results.string_count : 1, sizeof(const char *));
+        if (!shard->interned) {
+            fprintf(stderr, "Failed to allocate memory for %s.\n", path);
+            result = -1;
+        } else if (!(info->flags & BINARY_FLAG_UNFILTERED)) {
+            fprintf(stderr, "%s holds filtered results, not the candidates of a shard (--shard).\n", path);
+            result = -1;
+        } else if (info->shard_index >= info->shard_count) {
+            fprintf(stderr, "%s is damaged, it is shard %u of %u.\n",
+                    path, info->shard_index, info->shard_count);
+            result = -1;
+        } else if (info->shard_count != path_count) {
+            fprintf(stderr, "%s is shard %u of %u, but %zu shard files were given.\n",
+                    path, info->shard_index, info->shard_count, path_count);
+            result = -1;
+        } else if (shard_paths[info->shard_index]) {
+            fprintf(stderr, "%s and %s are both shard %u.\n",
+                    shard_paths[info->shard_index], path, info->shard_index);
+            result = -1;
+        } else {
+            shard_paths[info->shard_index] = path;
+        }
+    }
+    free(shard_paths);
+    return result;
+}
+
+static void close_shards(Shard *shards, size_t path_count) {
+    for (size_t shard_i = 0; shard_i < path_count; ++shard_i) {
+        if (shards[shard_i].results.data) close_binary_results(&shards[shard_i].results);
+        free(shards[shard_i].interned);
+    }
+}
+
+// the path table entry of a file name of the shard, NULL if out of memory
+static const char *intern_file_name(Shard *shard, uint32_t string_id) {
+    if (!shard->interned[string_id]) {
+        size_t length;
+        const char *name = binary_string(&shard->results, string_id, &length);
+        shard->interned[string_id] = path_table_add_length(name, length);
+    }
+    return shard->interned[string_id];
+}
+
+// appends the smells of the next file in walk order, returns 1 when every cursor is done
+static int merge_next_file(Cursor *cursors, size_t cursor_count, Smell_list *list) {
+    Cursor *next = NULL;
+    const char *next_name = NULL;
+    size_t next_length = 0;
+    for (size_t cursor_i = 0; cursor_i < cursor_count; ++cursor_i) {
+        Cursor *cursor = &cursors[cursor_i];
+        if (cursor->position == cursor->detector.smell_count) continue;
+        size_t length;
+        const char *name = binary_string(&cursor->shard->results,
+                                         cursor->detector.files[cursor->position], &length);
+        if (!next || compare_walk_order(name, length, next_name, next_length) < 0) {
+            next = cursor;
+            next_name = name;
+            next_length = length;
+        }
+    }
+    if (!next) return 1;
+
+    uint32_t file = next->detector.files[next->position];
+    const char *file_name = intern_file_name(next->shard, file);
+    if (!file_name) return -1;
+    do {
+        if (add_binary_smell(list, &next->detector, next->metric_columns, (size_t)next->position, file_name)
+                == SMELL_NOT_ADDED) {
+            return -1;
+        }
+    } while (++next->position < next->detector.smell_count && next->detector.files[next->position] == file);
+    return 0;
+}
+
+static int merge_detector(Shard *shards, size_t shard_count, Smell_detector *detector) {
+    Cursor *cursors = calloc(shard_count, sizeof(Cursor));
+    uint32_t *metric_columns = calloc(shard_count * (detector->metric_count ? detector->metric_count : 1),
+                                      sizeof(uint32_t));
+    if (!cursors || !metric_columns) {
+        fprintf(stderr, "Failed to allocate memory for merging %s.\n", detector->name);
+        free(cursors);
+        free(metric_columns);
+        return -1;
+    }
+
+    int result = 0;
+    for (size_t shard_i = 0; shard_i < shard_count && result == 0; ++shard_i) {
+        Cursor *cursor = &cursors[shard_i];
+        cursor->shard = &shards[shard_i];
+        cursor->metric_columns = metric_columns + shard_i * detector->metric_count;
+        result = find_binary_detector(&cursor->shard->results, detector, &cursor->detector, cursor->metric_columns);
+    }
+
+    int merged = 0;
+    while (result == 0 && merged == 0) {
+        merged = merge_next_file(cursors, shard_count, detector->smell_list);
+    }
+    if (merged < 0) {
+        fprintf(stderr, "Failed to allocate memory for the candidates of %s.\n", detector->name);
+        result = -1;
+    }
+    // percentage steps refer to the candidates of all shards
+    detector->candidate_count = detector->smell_list->count;
+
+    free(cursors);
+    free(metric_columns);
+    return result;
+}
+
+int merge_shards(const char *const *paths, size_t path_count, size_t *file_count, uint32_t *total_LOC) {
+    Shard *shards = calloc(path_count, sizeof(Shard));
+    if (!shards) {
+        fprintf(stderr, "Failed to allocate memory for %zu shards.\n", path_count);
+        return -1;
+    }
+
+    int result = open_shards(shards, paths, path_count);
+    for (size_t detector_i = 0; detector_i < detector_count && result == 0; ++detector_i) {
+        result = merge_detector(shards, path_count, detectors[detector_i]);
+    }
+    if (result == 0) {
+        for (size_t shard_i = 0; shard_i < path_count; ++shard_i) {
+            *file_count += (size_t)shards[shard_i].results.info.file_count;
+            *total_LOC += (uint32_t)shards[shard_i].results.info.total_LOC;
+        }
+    }
+
+    close_shards(shards, path_count);
+    free(shards);
+    return result;
+}
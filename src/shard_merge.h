@@ -0,0 +1,20 @@
+#ifndef SHARD_MERGE_H
+#define SHARD_MERGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+combines the unfiltered candidates that the shards of a run
+(--shard, directory_walker.h) wrote to their binary files
+(binary_report.h) into the smell list of every detector. each
+shard of the run has to be given exactly once, in any order.
+the smells are merged in the order of the directory walk, so the
+lists equal the ones of a single process run over the same path
+and the filters afterwards give the same result, percentage
+steps refer to the candidates of all shards. detectors and
+metrics are matched by name, errors are printed.
+*/
+int merge_shards(const char *const *paths, size_t path_count, size_t *file_count, uint32_t *total_LOC);
+
+#endif
@@ -6,92 +6,185 @@
 
 #define INITIAL_SMELL_CAPACITY 32
 
-Smell_location create_location(char *file_name, uint32_t line) {
+Smell_location create_location(const char *file_name, uint32_t line) {
     Smell_location location;
-    location.file_name = file_name; //copy pointer, points to file_name in the file_list
+    location.file_name = file_name; //copy pointer, points into the path table
     location.line = line;
     return location;
 }
 
-Metric create_float_metric(const char *name, float measured_value) {
-    Metric metric;
-    metric.name = name;
-    metric.measured_value.float_value = measured_value;
-    metric.is_float = 1;
-    return metric;
+int init_smell_list(Smell_list *list, const Metric_definition *metrics, size_t metric_count) {
+    list->metrics = metrics;
+    list->metric_count = metric_count;
+    list->capacity = 0;
+    list->count = 0;
+    list->locations = malloc(INITIAL_SMELL_CAPACITY * sizeof(Smell_location));
+    list->columns = calloc(metric_count ? metric_count : 1, sizeof(Metric_value *));
+    if (!list->locations || !list->columns) {
+        fprintf(stderr, "Initial smell memory allocation failed.\n");
+        free_smell_list(list);
+        return -1;
+    }
+    for (size_t metric_i = 0; metric_i < metric_count; ++metric_i) {
+        list->columns[metric_i] = malloc(INITIAL_SMELL_CAPACITY * sizeof(Metric_value));
+        if (!list->columns[metric_i]) {
+            fprintf(stderr, "Initial smell memory allocation failed.\n");
+            free_smell_list(list);
+            return -1;
+        }
+    }
+    list->capacity = INITIAL_SMELL_CAPACITY;
+    return 0;
 }
 
-Metric create_int_metric(const char *name, uint32_t measured_value) {
-    Metric metric;
-    metric.name = name;
-    metric.measured_value.int_value = measured_value;
-    metric.is_float = 0;
-    return metric;
+static int reserve_smells(Smell_list *list, size_t count) {
+    if (count <= list->capacity) return 0;
+    size_t new_capacity = list->capacity ? list->capacity * 2 : INITIAL_SMELL_CAPACITY;
+    while (new_capacity < count) new_capacity *= 2;
+
+    Smell_location *locations = realloc(list->locations, new_capacity * sizeof(Smell_location));
+    if (!locations) {
+        fprintf(stderr, "Failed to allocate memory for new smells.\n");
+        return -1;
+    }
+    list->locations = locations;
+    for (size_t metric_i = 0; metric_i < list->metric_count; ++metric_i) {
+        Metric_value *column = realloc(list->columns[metric_i], new_capacity * sizeof(Metric_value));
+        if (!column) {
+            // columns that already grew stay larger, capacity only counts what all of them hold
+            fprintf(stderr, "Failed to allocate memory for new smells.\n");
+            return -1;
+        }
+        list->columns[metric_i] = column;
+    }
+    list->capacity = new_capacity;
+    return 0;
 }
 
-Smell *create_smell(Smell_location location) {
-    Smell *smell = malloc(sizeof(Smell));
-    if (!smell) return NULL;
-    smell->location = location;
-    smell->metric_count = 0;
-    return smell;
+size_t add_smell(Smell_list *list, Smell_location location) {
+    if (reserve_smells(list, list->count + 1) != 0) return SMELL_NOT_ADDED;
+    size_t smell_i = list->count++;
+    list->locations[smell_i] = location;
+    for (size_t metric_i = 0; metric_i < list->metric_count; ++metric_i) {
+        memset(&list->columns[metric_i][smell_i], 0, sizeof(Metric_value));
+    }
+    return smell_i;
 }
 
-void init_smell_list(Smell_list *list) {
-    list->smells = malloc(INITIAL_SMELL_CAPACITY * sizeof(Smell));
-    if (!list->smells) {
-        fprintf(stderr, "Initial smell memory allocation failed.\n");
-        return;
+int append_smells(Smell_list *target, const Smell_list *source, size_t start, size_t count) {
+    if (count == 0) return 0;
+    if (reserve_smells(target, target->count + count) != 0) return -1;
+    memcpy(&target->locations[target->count], &source->locations[start], count * sizeof(Smell_location));
+    for (size_t metric_i = 0; metric_i < target->metric_count; ++metric_i) {
+        memcpy(&target->columns[metric_i][target->count], &source->columns[metric_i][start],
+               count * sizeof(Metric_value));
     }
-    list->capacity = INITIAL_SMELL_CAPACITY;
-    list->count = 0;
+    target->count += count;
+    return 0;
 }
 
-void add_smell_to_list(Smell_list *list, Smell smell) {
-    if (list->count >= list->capacity) {
-        size_t new_capacity = list->capacity*2;
-        list->smells = realloc(list->smells, new_capacity*sizeof(Smell));
-        if (!list->smells) {
-            fprintf(stderr, "Failed to allocate memory for new smells.\n");
-            return;
-        }
-        list->capacity = new_capacity;
+void copy_smell(Smell_list *target, size_t target_i, const Smell_list *source, size_t source_i) {
+    target->locations[target_i] = source->locations[source_i];
+    for (size_t metric_i = 0; metric_i < target->metric_count; ++metric_i) {
+        target->columns[metric_i][target_i] = source->columns[metric_i][source_i];
     }
-    list->smells[list->count] = smell;
-    list->count = list->count + 1; 
 }
 
+void swap_smells(Smell_list *list, size_t smell_a, size_t smell_b) {
+    Smell_location location = list->locations[smell_a];
+    list->locations[smell_a] = list->locations[smell_b];
+    list->locations[smell_b] = location;
+    for (size_t metric_i = 0; metric_i < list->metric_count; ++metric_i) {
+        Metric_value *column = list->columns[metric_i];
+        Metric_value value = column[smell_a];
+        column[smell_a] = column[smell_b];
+        column[smell_b] = value;
+    }
+}
 
-void add_metric(Smell *smell, Metric metric) {
-    if (smell->metric_count < MAX_METRICS) {
-        smell->metrics[smell->metric_count] = metric;
-        smell->metric_count = smell->metric_count + 1;
-    } else {
-        fprintf(stderr, "Maximum amount of metrics reached.\n");
+// the ranges may overlap
+static void move_smells(Smell_list *list, size_t target_i, size_t source_i, size_t count) {
+    if (count == 0 || target_i == source_i) return;
+    memmove(&list->locations[target_i], &list->locations[source_i], count * sizeof(Smell_location));
+    for (size_t metric_i = 0; metric_i < list->metric_count; ++metric_i) {
+        Metric_value *column = list->columns[metric_i];
+        memmove(&column[target_i], &column[source_i], count * sizeof(Metric_value));
     }
-    
 }
 
-void print_smell_list(Smell_list *list) {
-    for (size_t smell_i = 0; smell_i < list->count; ++smell_i) {
-        Smell current_smell = list->smells[smell_i];
-        printf("-------------\n");
-        printf("File: %s Line: %d\n", current_smell.location.file_name, current_smell.location.line);
-        for (size_t metric_i = 0; metric_i < current_smell.metric_count; ++metric_i) {
-            Metric current_metric = current_smell.metrics[metric_i];
-            printf("Metric: %s, Measured Value: ", current_metric.name);
-            if (current_metric.is_float) {
-                printf("%.2f\n", current_metric.measured_value.float_value);
-            } else {
-                printf("%d\n", current_metric.measured_value.int_value);
-            }
+void remove_smells(Smell_list *list, const size_t *positions, size_t count) {
+    if (count == 0) return;
+    size_t kept = positions[0];
+    for (size_t removed_i = 0; removed_i < count; ++removed_i) {
+        size_t start = positions[removed_i] + 1;
+        size_t end = removed_i + 1 < count ? positions[removed_i + 1] : list->count;
+        move_smells(list, kept, start, end - start);
+        kept += end - start;
+    }
+    list->count = kept;
+}
+
+int insert_smells(Smell_list *target, const size_t *positions, const Smell_list *source) {
+    if (source->count == 0) return 0;
+    if (reserve_smells(target, target->count + source->count) != 0) return -1;
+    // from the back, so every smell of target only moves once
+    size_t end = target->count;
+    for (size_t inserted_i = source->count; inserted_i-- > 0;) {
+        size_t position = positions[inserted_i];
+        move_smells(target, position + inserted_i + 1, position, end - position);
+        copy_smell(target, position + inserted_i, source, inserted_i);
+        end = position;
+    }
+    target->count += source->count;
+    return 0;
+}
+
+int copy_smell_list(Smell_list *target, const Smell_list *source) {
+    target->count = 0;
+    return append_smells(target, source, 0, source->count);
+}
+
+int gather_smells(Smell_list *list, const size_t *smell_indices, size_t count) {
+    // one column at a time through a single scratch column
+    size_t scratch_size = sizeof(Smell_location) > sizeof(Metric_value) ? sizeof(Smell_location)
+                                                                         : sizeof(Metric_value);
+    char *scratch = malloc((count ? count : 1) * scratch_size);
+    if (!scratch) {
+        fprintf(stderr, "Failed to allocate memory for reordering smells.\n");
+        return -1;
+    }
+
+    Smell_location *locations = (Smell_location *)scratch;
+    for (size_t smell_i = 0; smell_i < count; ++smell_i) {
+        locations[smell_i] = list->locations[smell_indices[smell_i]];
+    }
+    memcpy(list->locations, locations, count * sizeof(Smell_location));
+
+    Metric_value *values = (Metric_value *)scratch;
+    for (size_t metric_i = 0; metric_i < list->metric_count; ++metric_i) {
+        Metric_value *column = list->columns[metric_i];
+        for (size_t smell_i = 0; smell_i < count; ++smell_i) {
+            values[smell_i] = column[smell_indices[smell_i]];
         }
+        memcpy(column, values, count * sizeof(Metric_value));
     }
-    printf("\n");
+    list->count = count;
+    free(scratch);
+    return 0;
 }
 
 void free_smell_list(Smell_list *list) {
-    // list->smells[i].location.file_name belongs to file list,
-    // gets freed in free_file_list(File_list *list) in file_utils.c
-    free(list->smells);
-}
\ No newline at end of file
+    // list->locations[i].file_name belongs to the path table,
+    // gets freed in free_path_table() in path_table.c
+    if (list->columns) {
+        for (size_t metric_i = 0; metric_i < list->metric_count; ++metric_i) {
+            free(list->columns[metric_i]);
+        }
+    }
+    free(list->columns);
+    free(list->locations);
+    list->columns = NULL;
+    list->locations = NULL;
+    list->capacity = 0;
+    list->count = 0;
+}
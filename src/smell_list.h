@@ -3,50 +3,51 @@
 
 #include "tree_sitter/api.h"
 #include <stddef.h>
+#include <stdint.h>
 
 #include "matlab_file_list.h"
 
-//maximum amount of thresholds any kind of smell has
-// this should be dynamic based on the detector
-#define MAX_METRICS 3
+// returned by add_smell if the list couldn't grow
+#define SMELL_NOT_ADDED ((size_t)-1)
 
 /*
 data structures to store found smells and store them
-in a dynamic list 
+in a dynamic list
 */
 
 typedef struct {
-    char *file_name;
+    const char *file_name;
     uint32_t line;
 } Smell_location;
 
+// every metric a detector attaches to its candidates, declared up front
+typedef struct {
+    const char *name;
+    int is_float;
+} Metric_definition;
+
 /*
 TODO: actual value currently unused, designed to
 evaluate severity of a smell (difference between
 values)
-
-TODO: threshold value is always taken from global_config
--> maybe there is some better way to refrence this
-information / storage might be unneccessary
-    -> metric type could be enough
 */
-typedef struct {
-    const char *name;
-    union {
-        float float_value;
-        int int_value;
-    } measured_value;
-    int is_float;
-} Metric;
+typedef union {
+    int32_t int_value;
+    float float_value;
+} Metric_value;
 
+/*
+structure of arrays: smell i is at locations[i] and its value
+of metric m is columns[m][i]. a metric id is the index of its
+definition in metrics, the definitions are given when the list
+is initialized and every smell of the list has all of them.
+sorting, filtering and output only scan the columns they need.
+*/
 typedef struct {
-    Smell_location location;
-    Metric metrics[MAX_METRICS];
+    Smell_location *locations;
+    Metric_value **columns;
+    const Metric_definition *metrics;
     size_t metric_count;
-} Smell;
-
-typedef struct {
-    Smell *smells;
     size_t capacity;
     size_t count;
 } Smell_list;
@@ -55,18 +56,52 @@ typedef struct {
 // maybe put it somewhere else
 TSLanguage *tree_sitter_matlab(void);
 
-Smell_location create_location(char *file_name, uint32_t line);
+Smell_location create_location(const char *file_name, uint32_t line);
+
+// returns -1 if the columns couldn't be allocated
+int init_smell_list(Smell_list *list, const Metric_definition *metrics, size_t metric_count);
+void free_smell_list(Smell_list *list);
 
-Metric create_int_metric(const char *name, uint32_t measured_value);
-Metric create_float_metric(const char *name, float measured_value);
-void add_metric(Smell *candidate, Metric metric);
+/*
+not synchronized, concurrent callers have to use separate lists.
+add_smell appends a smell with all metrics 0 and returns its
+index, the metrics are set afterwards by their ids.
+*/
+size_t add_smell(Smell_list *list, Smell_location location);
 
-Smell *create_smell(Smell_location location);
-void add_smell_to_list(Smell_list *list, Smell smell);
+static inline void set_int_metric(Smell_list *list, size_t smell_i, size_t metric_id, int32_t value) {
+    list->columns[metric_id][smell_i].int_value = value;
+}
 
-void init_smell_list(Smell_list *list);
-void free_smell_list(Smell_list *list);
+static inline void set_float_metric(Smell_list *list, size_t smell_i, size_t metric_id, float value) {
+    list->columns[metric_id][smell_i].float_value = value;
+}
 
-void print_smell_list(Smell_list *list);
+static inline double get_metric(const Smell_list *list, size_t smell_i, size_t metric_id) {
+    Metric_value value = list->columns[metric_id][smell_i];
+    return list->metrics[metric_id].is_float ? value.float_value : value.int_value;
+}
+
+/*
+the following functions only work on lists with the same metric
+definitions. append_smells adds count smells of source starting
+at start.
+*/
+int append_smells(Smell_list *target, const Smell_list *source, size_t start, size_t count);
+// overwrites smell target_i of target, both lists may be the same
+void copy_smell(Smell_list *target, size_t target_i, const Smell_list *source, size_t source_i);
+void swap_smells(Smell_list *list, size_t smell_a, size_t smell_b);
+/*
+remove_smells drops the smells at positions (ascending, distinct),
+insert_smells puts smell i of source before the smell that was at
+positions[i] (ascending, count of target for the end). both move
+every smell of the list at most once.
+*/
+void remove_smells(Smell_list *list, const size_t *positions, size_t count);
+int insert_smells(Smell_list *target, const size_t *positions, const Smell_list *source);
+// replaces the content of target with a copy of source
+int copy_smell_list(Smell_list *target, const Smell_list *source);
+// keeps only the smells at the given indices, in that order
+int gather_smells(Smell_list *list, const size_t *smell_indices, size_t count);
 
 #endif
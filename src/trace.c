@@ -0,0 +1,436 @@
+#include "trace.h"
+#include "detector_registry.h"
+#include "report_writer.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define INITIAL_EVENT_CAPACITY 1024
+#define SLOWEST_FILE_COUNT 10
+// distinct names (detectors, outputs) shown below a phase in the summary
+#define MAX_NAMED_ROWS 32
+#define NO_DETECTOR_TIMES SIZE_MAX
+
+typedef struct {
+    Trace_phase phase;
+    const char *name;
+    const char *file_name;
+    uint64_t begin;
+    uint64_t end;
+    // first of detector_count entries in the thread's detector_times, detect scopes only
+    size_t detector_times_at;
+} Trace_event;
+
+// scopes of one thread, only that thread appends to it
+typedef struct Trace_thread {
+    struct Trace_thread *next;
+    uint32_t id;
+    Trace_event *events;
+    size_t event_count;
+    size_t event_capacity;
+    uint64_t *detector_times;
+    size_t detector_time_count;
+    size_t detector_time_capacity;
+} Trace_thread;
+
+static const char *const phase_names[PHASE_COUNT] = {
+    [PHASE_DISCOVERY] = "discovery",
+    [PHASE_READ] = "read",
+    [PHASE_PARSE] = "parse",
+    [PHASE_DETECT] = "detect",
+    [PHASE_CACHE] = "cache",
+    [PHASE_FILTER] = "filter",
+    [PHASE_OUTPUT] = "output"
+};
+
+static int enabled = 0;
+static uint64_t trace_start;
+static pthread_mutex_t threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Trace_thread *threads = NULL;
+static uint32_t next_thread_id = 0;
+// scopes that couldn't be stored, reported in the summary
+static atomic_size_t lost_events;
+static _Thread_local Trace_thread *current_thread = NULL;
+
+uint64_t trace_now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000u + (uint64_t)time.tv_nsec;
+}
+
+int init_trace(void) {
+    atomic_init(&lost_events, 0);
+    trace_start = trace_now();
+    enabled = 1;
+    return 0;
+}
+
+int tracing_enabled(void) {
+    return enabled;
+}
+
+void free_trace(void) {
+    pthread_mutex_lock(&threads_mutex);
+    while (threads) {
+        Trace_thread *next = threads->next;
+        free(threads->events);
+        free(threads->detector_times);
+        free(threads);
+        threads = next;
+    }
+    pthread_mutex_unlock(&threads_mutex);
+    current_thread = NULL;
+    enabled = 0;
+}
+
+static Trace_thread *get_current_thread(void) {
+    if (current_thread) return current_thread;
+    Trace_thread *thread = calloc(1, sizeof(Trace_thread));
+    if (!thread) return NULL;
+    pthread_mutex_lock(&threads_mutex);
+    thread->id = next_thread_id++;
+    thread->next = threads;
+    threads = thread;
+    pthread_mutex_unlock(&threads_mutex);
+    current_thread = thread;
+    return thread;
+}
+
+static int reserve(void **array, size_t *capacity, size_t count, size_t element_size) {
+    if (count <= *capacity) return 0;
+    size_t new_capacity = *capacity ? *capacity * 2 : INITIAL_EVENT_CAPACITY;
+    while (new_capacity < count) new_capacity *= 2;
+    void *larger = realloc(*array, new_capacity * element_size);
+    if (!larger) return -1;
+    *array = larger;
+    *capacity = new_capacity;
+    return 0;
+}
+
+static Trace_event *add_event(Trace_thread *thread) {
+    if (!thread || reserve((void **)&thread->events, &thread->event_capacity,
+                           thread->event_count + 1, sizeof(Trace_event)) != 0) {
+        atomic_fetch_add(&lost_events, 1);
+        return NULL;
+    }
+    return &thread->events[thread->event_count++];
+}
+
+void trace_scope(Trace_phase phase, const char *name, const char *file_name, uint64_t begin, uint64_t end) {
+    if (!enabled) return;
+    Trace_event *event = add_event(get_current_thread());
+    if (!event) return;
+    *event = (Trace_event){ phase, name, file_name, begin, end, NO_DETECTOR_TIMES };
+}
+
+void trace_detect(const char *file_name, uint64_t begin, uint64_t end, const uint64_t *detector_times) {
+    if (!enabled) return;
+    Trace_thread *thread = get_current_thread();
+    Trace_event *event = add_event(thread);
+    if (!event) return;
+    *event = (Trace_event){ PHASE_DETECT, NULL, file_name, begin, end, NO_DETECTOR_TIMES };
+    if (reserve((void **)&thread->detector_times, &thread->detector_time_capacity,
+                thread->detector_time_count + detector_count, sizeof(uint64_t)) == 0) {
+        event->detector_times_at = thread->detector_time_count;
+        memcpy(&thread->detector_times[thread->detector_time_count], detector_times,
+               detector_count * sizeof(uint64_t));
+        thread->detector_time_count += detector_count;
+    }
+}
+
+int scopes_enabled(void) {
+    return enabled || perf_counters_enabled();
+}
+
+void begin_scope(Scope_start *start) {
+    start->time = trace_now();
+    // counters last and first at the end, so the scope counts as little of itself as possible
+    if (perf_counters_enabled()) read_perf_counters(&start->counters);
+}
+
+void end_scope(const Scope_start *start, Trace_phase phase, const char *name, const char *file_name) {
+    if (perf_counters_enabled()) {
+        Counter_values end;
+        read_perf_counters(&end);
+        add_counted_scope(phase, phase_names[phase], name, &start->counters, &end);
+    }
+    if (enabled) trace_scope(phase, name, file_name, start->time, trace_now());
+}
+
+typedef struct {
+    const char *name;
+    uint64_t total;
+    size_t count;
+} Named_total;
+
+typedef struct {
+    uint64_t totals[PHASE_COUNT];
+    size_t counts[PHASE_COUNT];
+    uint64_t detector_totals[MAX_NAMED_ROWS];
+    int has_detector_times; // detect scopes of the shared pass, not one per detector
+    Named_total named[PHASE_COUNT][MAX_NAMED_ROWS];
+    size_t named_count[PHASE_COUNT];
+} Phase_summary;
+
+static void add_named_total(Phase_summary *summary, const Trace_event *event) {
+    Named_total *named = summary->named[event->phase];
+    size_t *count = &summary->named_count[event->phase];
+    size_t name_i = 0;
+    while (name_i < *count && strcmp(named[name_i].name, event->name) != 0) name_i++;
+    if (name_i == *count) {
+        if (*count >= MAX_NAMED_ROWS) return;
+        named[(*count)++] = (Named_total){ event->name, 0, 0 };
+    }
+    named[name_i].total += event->end - event->begin;
+    named[name_i].count++;
+}
+
+static void summarize_phases(Phase_summary *summary) {
+    memset(summary, 0, sizeof(*summary));
+    for (const Trace_thread *thread = threads; thread; thread = thread->next) {
+        for (size_t event_i = 0; event_i < thread->event_count; ++event_i) {
+            const Trace_event *event = &thread->events[event_i];
+            summary->totals[event->phase] += event->end - event->begin;
+            summary->counts[event->phase]++;
+            if (event->name) add_named_total(summary, event);
+            if (event->detector_times_at != NO_DETECTOR_TIMES) {
+                const uint64_t *times = &thread->detector_times[event->detector_times_at];
+                summary->has_detector_times = 1;
+                for (size_t detector_i = 0; detector_i < detector_count && detector_i < MAX_NAMED_ROWS;
+                     ++detector_i) {
+                    summary->detector_totals[detector_i] += times[detector_i];
+                }
+            }
+        }
+    }
+}
+
+// all file scopes of one file, grouped for the slow path attribution
+typedef struct {
+    const char *file_name;
+    uint64_t phase_times[PHASE_COUNT];
+    uint64_t total;
+    uint64_t slowest_detector_time;
+    const char *slowest_detector;
+} File_times;
+
+typedef struct {
+    const char *file_name;
+    const Trace_event *event;
+    const uint64_t *detector_times; // NULL for scopes other than detect
+} File_scope;
+
+static int compare_file_scopes(const void *a, const void *b) {
+    const char *name_a = ((const File_scope *)a)->file_name;
+    const char *name_b = ((const File_scope *)b)->file_name;
+    return (name_a > name_b) - (name_a < name_b);
+}
+
+static void add_slowest_file(File_times *slowest, size_t *count, const File_times *file) {
+    size_t position = *count < SLOWEST_FILE_COUNT ? (*count)++ : SLOWEST_FILE_COUNT;
+    while (position > 0 && slowest[position - 1].total < file->total) {
+        if (position < SLOWEST_FILE_COUNT) slowest[position] = slowest[position - 1];
+        position--;
+    }
+    if (position < SLOWEST_FILE_COUNT) slowest[position] = *file;
+}
+
+// the files with the largest sum of their read, parse, detect and cache scopes
+static size_t find_slowest_files(File_times *slowest) {
+    size_t scope_count = 0;
+    for (const Trace_thread *thread = threads; thread; thread = thread->next) {
+        for (size_t event_i = 0; event_i < thread->event_count; ++event_i) {
+            if (thread->events[event_i].file_name) scope_count++;
+        }
+    }
+    File_scope *scopes = malloc((scope_count ? scope_count : 1) * sizeof(File_scope));
+    if (!scopes) return 0;
+
+    size_t scope_i = 0;
+    for (const Trace_thread *thread = threads; thread; thread = thread->next) {
+        for (size_t event_i = 0; event_i < thread->event_count; ++event_i) {
+            const Trace_event *event = &thread->events[event_i];
+            if (!event->file_name) continue;
+            const uint64_t *times = event->detector_times_at != NO_DETECTOR_TIMES
+                                  ? &thread->detector_times[event->detector_times_at] : NULL;
+            scopes[scope_i++] = (File_scope){ event->file_name, event, times };
+        }
+    }
+    // file names point into the path table, every read file has its own entry
+    qsort(scopes, scope_count, sizeof(File_scope), compare_file_scopes);
+
+    size_t slowest_count = 0;
+    for (size_t first = 0; first < scope_count;) {
+        File_times file = { .file_name = scopes[first].file_name };
+        size_t last = first;
+        for (; last < scope_count && scopes[last].file_name == file.file_name; ++last) {
+            const Trace_event *event = scopes[last].event;
+            file.phase_times[event->phase] += event->end - event->begin;
+            file.total += event->end - event->begin;
+            for (size_t detector_i = 0; scopes[last].detector_times && detector_i < detector_count; ++detector_i) {
+                if (scopes[last].detector_times[detector_i] > file.slowest_detector_time) {
+                    file.slowest_detector_time = scopes[last].detector_times[detector_i];
+                    file.slowest_detector = detectors[detector_i]->name;
+                }
+            }
+        }
+        add_slowest_file(slowest, &slowest_count, &file);
+        first = last;
+    }
+    free(scopes);
+    return slowest_count;
+}
+
+static void print_row(FILE *file, int indent, const char *name, uint64_t total, size_t count, uint64_t wall) {
+    fprintf(file, "  %*s%-*s %12.3f %9zu %8.1f%%\n", indent, "", 24 - indent, name, total / 1e6, count,
+            wall ? 100.0 * total / wall : 0.0);
+}
+
+void print_trace_summary(FILE *file) {
+    if (!enabled) return;
+    uint64_t wall = trace_now() - trace_start;
+    pthread_mutex_lock(&threads_mutex);
+
+    Phase_summary *summary = malloc(sizeof(Phase_summary));
+    if (!summary) {
+        pthread_mutex_unlock(&threads_mutex);
+        fprintf(stderr, "Failed to allocate memory for the timing summary.\n");
+        return;
+    }
+    summarize_phases(summary);
+
+    fprintf(file, "Timings (wall time %.3f ms, phases summed over all threads):\n", wall / 1e6);
+    fprintf(file, "  %-24s %12s %9s %9s\n", "phase", "total ms", "scopes", "of wall");
+    for (size_t phase = 0; phase < PHASE_COUNT; ++phase) {
+        if (summary->counts[phase] == 0) continue;
+        print_row(file, 0, phase_names[phase], summary->totals[phase], summary->counts[phase], wall);
+
+        if (phase == PHASE_DETECT && summary->has_detector_times) {
+            // the rest of the shared pass is the traversal itself and begin/end of the files
+            uint64_t detectors_total = 0;
+            for (size_t detector_i = 0; detector_i < detector_count && detector_i < MAX_NAMED_ROWS; ++detector_i) {
+                print_row(file, 2, detectors[detector_i]->name, summary->detector_totals[detector_i],
+                          summary->counts[phase], wall);
+                detectors_total += summary->detector_totals[detector_i];
+            }
+            uint64_t traversal = summary->totals[phase] > detectors_total ? summary->totals[phase] - detectors_total : 0;
+            print_row(file, 2, "traversal", traversal, summary->counts[phase], wall);
+        }
+        for (size_t name_i = 0; name_i < summary->named_count[phase]; ++name_i) {
+            const Named_total *named = &summary->named[phase][name_i];
+            print_row(file, 2, named->name, named->total, named->count, wall);
+        }
+    }
+    free(summary);
+
+    File_times slowest[SLOWEST_FILE_COUNT];
+    size_t slowest_count = find_slowest_files(slowest);
+    if (slowest_count > 0) {
+        fprintf(file, "Slowest files:\n");
+        fprintf(file, "  %10s %9s %9s %9s  %-20s %s\n", "total ms", "read ms", "parse ms", "detect ms",
+                "slowest detector", "file");
+        for (size_t file_i = 0; file_i < slowest_count; ++file_i) {
+            const File_times *times = &slowest[file_i];
+            fprintf(file, "  %10.3f %9.3f %9.3f %9.3f  %-20s %s\n", times->total / 1e6,
+                    times->phase_times[PHASE_READ] / 1e6, times->phase_times[PHASE_PARSE] / 1e6,
+                    times->phase_times[PHASE_DETECT] / 1e6,
+                    times->slowest_detector ? times->slowest_detector : "-", times->file_name);
+        }
+    }
+    size_t lost = atomic_load(&lost_events);
+    if (lost > 0) fprintf(file, "%zu scopes were lost, the timings are incomplete.\n", lost);
+    pthread_mutex_unlock(&threads_mutex);
+}
+
+// nanoseconds as microseconds with three decimals, the unit of trace events
+static void append_microseconds(Report_buffer *buffer, uint64_t nanoseconds) {
+    char fraction[4];
+    uint64_t remainder = nanoseconds % 1000;
+    fraction[0] = '.';
+    fraction[1] = (char)('0' + remainder / 100);
+    fraction[2] = (char)('0' + remainder / 10 % 10);
+    fraction[3] = (char)('0' + remainder % 10);
+    append_int(buffer, (int64_t)(nanoseconds / 1000));
+    append_bytes(buffer, fraction, sizeof(fraction));
+}
+
+static void append_json_string(Report_buffer *buffer, const char *text) {
+    static const char hex_digits[] = "0123456789abcdef";
+    append_bytes(buffer, "\"", 1);
+    const char *run = text;
+    for (const char *character = text; *character; ++character) {
+        unsigned char byte = (unsigned char)*character;
+        if (byte >= 0x20 && byte != '"' && byte != '\\') continue;
+        append_bytes(buffer, run, (size_t)(character - run));
+        if (byte == '"' || byte == '\\') {
+            char escaped[2] = { '\\', (char)byte };
+            append_bytes(buffer, escaped, sizeof(escaped));
+        } else {
+            char escaped[6] = { '\\', 'u', '0', '0', hex_digits[byte >> 4], hex_digits[byte & 15] };
+            append_bytes(buffer, escaped, sizeof(escaped));
+        }
+        run = character + 1;
+    }
+    append_text(buffer, run);
+    append_bytes(buffer, "\"", 1);
+}
+
+static void append_trace_event(Report_buffer *buffer, const Trace_thread *thread, const Trace_event *event) {
+    append_text(buffer, "{\"name\":");
+    append_json_string(buffer, event->name ? event->name : phase_names[event->phase]);
+    append_text(buffer, ",\"cat\":\"");
+    append_text(buffer, phase_names[event->phase]);
+    append_text(buffer, "\",\"ph\":\"X\",\"pid\":1,\"tid\":");
+    append_int(buffer, thread->id);
+    append_text(buffer, ",\"ts\":");
+    append_microseconds(buffer, event->begin - trace_start);
+    append_text(buffer, ",\"dur\":");
+    append_microseconds(buffer, event->end - event->begin);
+    if (event->file_name) {
+        append_text(buffer, ",\"args\":{\"file\":");
+        append_json_string(buffer, event->file_name);
+        if (event->detector_times_at != NO_DETECTOR_TIMES) {
+            // microseconds every detector spent in its hooks
+            for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+                append_bytes(buffer, ",", 1);
+                append_json_string(buffer, detectors[detector_i]->name);
+                append_bytes(buffer, ":", 1);
+                append_microseconds(buffer, thread->detector_times[event->detector_times_at + detector_i]);
+            }
+        }
+        append_bytes(buffer, "}", 1);
+    }
+    append_bytes(buffer, "}", 1);
+}
+
+int write_chrome_trace(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+
+    Report_buffer buffer;
+    init_report_buffer(&buffer, file);
+    append_text(&buffer, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    int first = 1;
+    pthread_mutex_lock(&threads_mutex);
+    for (const Trace_thread *thread = threads; thread; thread = thread->next) {
+        for (size_t event_i = 0; event_i < thread->event_count; ++event_i) {
+            if (!first) append_text(&buffer, ",\n");
+            append_trace_event(&buffer, thread, &thread->events[event_i]);
+            first = 0;
+        }
+    }
+    pthread_mutex_unlock(&threads_mutex);
+    append_text(&buffer, "\n]}\n");
+
+    int result = flush_report_buffer(&buffer, file);
+    free_report_buffer(&buffer);
+    if (fclose(file) != 0) result = -1;
+    if (result != 0) fprintf(stderr, "Failed to write %s.\n", path);
+    return result;
+}
@@ -0,0 +1,68 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "perf_counters.h"
+
+/*
+wall clock instrumentation of the phases of a run. when tracing
+is enabled every thread records its finished scopes into its own
+buffer, nothing is shared while the analysis runs. the scopes
+feed a summary table (phase totals, per detector times and the
+slowest files) and a Chrome trace event file that can be opened
+in chrome://tracing or https://ui.perfetto.dev.
+the callers check scopes_enabled() (or tracing_enabled()) before
+taking any time, so a disabled trace costs one branch per scope.
+*/
+
+typedef enum {
+    PHASE_DISCOVERY,
+    PHASE_READ,
+    PHASE_PARSE,
+    PHASE_DETECT,
+    PHASE_CACHE,
+    PHASE_FILTER,
+    PHASE_OUTPUT,
+    PHASE_COUNT
+} Trace_phase;
+
+// has to be called before any thread records a scope, returns -1 on errors
+int init_trace(void);
+int tracing_enabled(void);
+void free_trace(void);
+
+// monotonic wall clock in nanoseconds, also usable without tracing
+uint64_t trace_now(void);
+
+/*
+records a finished scope of the calling thread. name (e.g. the
+detector of a filter) and file_name may be NULL, both have to
+stay valid until the trace is written.
+*/
+void trace_scope(Trace_phase phase, const char *name, const char *file_name, uint64_t begin, uint64_t end);
+
+/*
+begin_scope and end_scope wrap a phase for the trace and, with
+perf counters enabled (perf_counters.h), count it as well. the
+callers check scopes_enabled() first.
+*/
+typedef struct {
+    uint64_t time;
+    Counter_values counters;
+} Scope_start;
+
+int scopes_enabled(void);
+void begin_scope(Scope_start *start);
+void end_scope(const Scope_start *start, Trace_phase phase, const char *name, const char *file_name);
+
+// the shared detector pass over one file, detector_times has detector_count entries
+void trace_detect(const char *file_name, uint64_t begin, uint64_t end, const uint64_t *detector_times);
+
+// phase totals summed over all threads and the files that took the longest
+void print_trace_summary(FILE *file);
+int write_chrome_trace(const char *path);
+
+#endif
@@ -0,0 +1,107 @@
+#include "tree_allocator.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tree_sitter/api.h"
+
+// in front of every allocation, realloc needs the size of arena blocks
+typedef struct {
+    size_t size;
+    size_t in_arena;
+} Allocation_header;
+
+#define HEADER_SIZE ((sizeof(Allocation_header) + _Alignof(max_align_t) - 1) & ~(_Alignof(max_align_t) - 1))
+
+static int installed = 0;
+static int arenas_enabled = 0;
+static _Thread_local Arena *current_arena = NULL;
+static _Thread_local Tree_allocations thread_allocations;
+
+static Allocation_header *header_of(void *pointer) {
+    return (Allocation_header *)((char *)pointer - HEADER_SIZE);
+}
+
+// tree-sitter doesn't check its allocations, like its default allocator this aborts
+static void out_of_memory(size_t size) {
+    fprintf(stderr, "Failed to allocate %zu bytes for tree-sitter.\n", size);
+    abort();
+}
+
+static void *tree_malloc(size_t size) {
+    Allocation_header *header = current_arena ? arena_alloc(current_arena, HEADER_SIZE + size) : NULL;
+    if (header) {
+        header->in_arena = 1;
+        ++thread_allocations.arena_allocations;
+    } else {
+        header = malloc(HEADER_SIZE + size);
+        if (!header) out_of_memory(size);
+        header->in_arena = 0;
+        ++thread_allocations.heap_allocations;
+    }
+    header->size = size;
+    return (char *)header + HEADER_SIZE;
+}
+
+static void *tree_calloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) out_of_memory(SIZE_MAX);
+    void *pointer = tree_malloc(count * size);
+    memset(pointer, 0, count * size);
+    return pointer;
+}
+
+static void *tree_realloc(void *pointer, size_t size) {
+    if (!pointer) return tree_malloc(size);
+
+    Allocation_header *header = header_of(pointer);
+    if (!header->in_arena) {
+        // heap blocks stay on the heap, they may belong to objects that outlive the arena
+        Allocation_header *resized = realloc(header, HEADER_SIZE + size);
+        if (!resized) out_of_memory(size);
+        resized->size = size;
+        ++thread_allocations.heap_allocations;
+        return (char *)resized + HEADER_SIZE;
+    }
+
+    if (size <= header->size) return pointer;
+    void *larger = tree_malloc(size);
+    memcpy(larger, pointer, header->size);
+    return larger;
+}
+
+static void tree_free(void *pointer) {
+    if (!pointer) return;
+    Allocation_header *header = header_of(pointer);
+    // arena blocks are released by reset_arena
+    if (header->in_arena) return;
+    ++thread_allocations.heap_frees;
+    free(header);
+}
+
+void install_tree_allocator(void) {
+    if (installed) return;
+    ts_set_allocator(tree_malloc, tree_calloc, tree_realloc, tree_free);
+    installed = 1;
+}
+
+void enable_tree_arenas(int enabled) {
+    arenas_enabled = installed && enabled;
+}
+
+int tree_arenas_enabled(void) {
+    return arenas_enabled;
+}
+
+void begin_tree_arena(Arena *arena) {
+    current_arena = arena;
+}
+
+void end_tree_arena(void) {
+    current_arena = NULL;
+}
+
+void read_tree_allocations(Tree_allocations *allocations) {
+    *allocations = thread_allocations;
+}
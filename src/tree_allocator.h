@@ -0,0 +1,42 @@
+#ifndef TREE_ALLOCATOR_H
+#define TREE_ALLOCATOR_H
+
+#include <stdint.h>
+
+#include "arena.h"
+
+/*
+allocator of tree-sitter (ts_set_allocator) that can serve the
+allocations of a thread from an arena (arena.h). between
+begin_tree_arena and end_tree_arena every new allocation of the
+calling thread is bumped from the arena and freeing it does
+nothing, so a parser and its tree are dropped with one
+reset_arena instead of thousands of frees. blocks allocated
+before begin_tree_arena stay on the heap, also when they are
+reallocated inside, but nothing allocated inside may be used
+after the arena was reset.
+*/
+
+// has to be called before the first tree-sitter object (including the queries) is created
+void install_tree_allocator(void);
+
+// workers (analysis.h) parse every file in their own arena, needs install_tree_allocator
+void enable_tree_arenas(int enabled);
+int tree_arenas_enabled(void);
+
+void begin_tree_arena(Arena *arena);
+void end_tree_arena(void);
+
+/*
+tree-sitter allocations of the calling thread since it started,
+arena blocks are not included (arena_block_count)
+*/
+typedef struct {
+    uint64_t heap_allocations; // malloc, calloc and realloc calls that reached the heap
+    uint64_t heap_frees;
+    uint64_t arena_allocations;
+} Tree_allocations;
+
+void read_tree_allocations(Tree_allocations *allocations);
+
+#endif
@@ -0,0 +1,664 @@
+#include "watch.h"
+#include "analysis.h"
+#include "detector_registry.h"
+#include "file_utils.h"
+#include "hash.h"
+#include "path_table.h"
+#include "smell_list.h"
+#include "filter_utils.h"
+#include "report_writer.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <time.h>
+#include <unistd.h>
+
+#define INITIAL_TABLE_CAPACITY 256
+#define INITIAL_DIRECTORY_CAPACITY 64
+#define INITIAL_PENDING_CAPACITY 16
+#define MAX_PATH_LENGTH 4096
+#define EVENT_BUFFER_SIZE (64 * 1024)
+// files are only analyzed once they were closed after writing or moved into place
+#define DIRECTORY_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE)
+
+// rescans are mostly a single new directory, one thread is enough
+static const Walk_options walk_options = { UNLIMITED_DEPTH, 1, NULL, 0, 1 };
+
+typedef struct {
+    const char *file_name; // path table, shared by all versions of the file
+    Matlab_file *file; // content the tree was parsed from, NULL if the file is gone
+    TSTree *tree;
+    uint32_t LOC;
+    Smell_list *candidates; // unfiltered, one list per detector in the order of its ranked list
+    int pending; // changed since the last report
+} Watched_file;
+
+// open addressing, files are never removed from the table, only emptied
+typedef struct {
+    Watched_file **slots;
+    size_t capacity;
+    size_t count;
+} File_table;
+
+/*
+all candidates of a detector in the order of its first filter step.
+the candidates that pass that step are always the first cutoff ones
+(count_first_step_survivors, filter_utils.h), only they are copied
+into the smell list and filtered further. first_moved is the first
+position that changed since the last report, below it the list is
+the same, so the survivors are only copied again if it is below
+the cutoff or the cutoff moved.
+*/
+typedef struct {
+    Smell_list candidates;
+    size_t metric_id;
+    int ascending;
+    size_t cutoff;
+    size_t reported_count; // candidates when the survivors were copied last
+    size_t first_moved;
+} Ranked_list;
+
+typedef struct {
+    const char *path;
+    int inotify_fd;
+    char **directories; // indexed by watch descriptor
+    size_t directory_capacity;
+    File_table files;
+    Watched_file **pending;
+    size_t pending_count;
+    size_t pending_capacity;
+    Ranked_list *ranked; // per detector
+    size_t *positions; // scratch for the positions of a file's candidates in a ranked list
+    size_t position_capacity;
+    TSParser *parser;
+    Tree_visitor *visitor;
+    void **detector_states;
+} Watch_state;
+
+static int is_matlab_file(const char *file_name) {
+    const char *file_extension = strrchr(file_name, '.');
+    return file_extension && strcmp(file_extension, ".m") == 0;
+}
+
+static char *copy_string(const char *string) {
+    size_t length = strlen(string);
+    char *copy = malloc(length + 1);
+    if (copy) memcpy(copy, string, length + 1);
+    return copy;
+}
+
+static Watched_file **find_slot(const File_table *table, const char *path) {
+    size_t mask = table->capacity - 1;
+    size_t slot_i = (size_t)hash_bytes(path, strlen(path), 0) & mask;
+    while (table->slots[slot_i] && strcmp(table->slots[slot_i]->file_name, path) != 0) {
+        slot_i = (slot_i + 1) & mask;
+    }
+    return &table->slots[slot_i];
+}
+
+static int grow_table(File_table *table) {
+    File_table larger = {
+        .slots = calloc(table->capacity * 2, sizeof(Watched_file *)),
+        .capacity = table->capacity * 2,
+        .count = table->count
+    };
+    if (!larger.slots) return -1;
+    for (size_t slot_i = 0; slot_i < table->capacity; ++slot_i) {
+        if (table->slots[slot_i]) {
+            *find_slot(&larger, table->slots[slot_i]->file_name) = table->slots[slot_i];
+        }
+    }
+    free(table->slots);
+    *table = larger;
+    return 0;
+}
+
+static void free_watched_file(Watched_file *watched) {
+    if (watched->tree) ts_tree_delete(watched->tree);
+    if (watched->file) free_matlab_file(watched->file);
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        free_smell_list(&watched->candidates[detector_i]);
+    }
+    free(watched->candidates);
+    free(watched);
+}
+
+static Watched_file *get_watched_file(Watch_state *state, const char *path) {
+    File_table *table = &state->files;
+    if ((table->count + 1) * 2 > table->capacity && grow_table(table) != 0) {
+        fprintf(stderr, "Failed to allocate memory for watched files.\n");
+        return NULL;
+    }
+    Watched_file **slot = find_slot(table, path);
+    if (*slot) return *slot;
+
+    Watched_file *watched = calloc(1, sizeof(Watched_file));
+    Smell_list *candidates = calloc(detector_count, sizeof(Smell_list));
+    const char *file_name = path_table_add(path);
+    if (!watched || !candidates || !file_name) {
+        fprintf(stderr, "Failed to allocate memory for watched file %s.\n", path);
+        free(watched);
+        free(candidates);
+        return NULL;
+    }
+    watched->file_name = file_name;
+    watched->candidates = candidates;
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        if (init_smell_list(&candidates[detector_i], detectors[detector_i]->metrics,
+                            detectors[detector_i]->metric_count) != 0) {
+            free_watched_file(watched);
+            return NULL;
+        }
+    }
+    *slot = watched;
+    table->count++;
+    return watched;
+}
+
+static int mark_pending(Watch_state *state, const char *path) {
+    Watched_file *watched = get_watched_file(state, path);
+    if (!watched) return -1;
+    if (watched->pending) return 0;
+
+    if (state->pending_count >= state->pending_capacity) {
+        size_t new_capacity = state->pending_capacity ? state->pending_capacity * 2
+                                                      : INITIAL_PENDING_CAPACITY;
+        Watched_file **larger = realloc(state->pending, new_capacity * sizeof(Watched_file *));
+        if (!larger) {
+            fprintf(stderr, "Failed to allocate memory for changed files.\n");
+            return -1;
+        }
+        state->pending = larger;
+        state->pending_capacity = new_capacity;
+    }
+    watched->pending = 1;
+    state->pending[state->pending_count++] = watched;
+    return 0;
+}
+
+static int queue_changed_file(const char *file_path, void *context) {
+    return mark_pending(context, file_path);
+}
+
+static int add_directory_watch(const char *directory_path, void *context) {
+    Watch_state *state = context;
+    int descriptor = inotify_add_watch(state->inotify_fd, directory_path, DIRECTORY_EVENTS);
+    if (descriptor < 0) {
+        fprintf(stderr, "Failed to watch directory %s: %s\n", directory_path, strerror(errno));
+        return -1;
+    }
+
+    size_t index = (size_t)descriptor;
+    if (index >= state->directory_capacity) {
+        size_t new_capacity = state->directory_capacity ? state->directory_capacity : INITIAL_DIRECTORY_CAPACITY;
+        while (new_capacity <= index) new_capacity *= 2;
+        char **larger = realloc(state->directories, new_capacity * sizeof(char *));
+        if (!larger) {
+            fprintf(stderr, "Failed to allocate memory for watched directories.\n");
+            return -1;
+        }
+        memset(larger + state->directory_capacity, 0,
+               (new_capacity - state->directory_capacity) * sizeof(char *));
+        state->directories = larger;
+        state->directory_capacity = new_capacity;
+    }
+    // watching the same directory again returns the same descriptor
+    free(state->directories[index]);
+    state->directories[index] = copy_string(directory_path);
+    return state->directories[index] ? 0 : -1;
+}
+
+/*
+the content has to stay valid for the next diff, a mapping of
+a file that is rewritten in place would change with it
+*/
+static Matlab_file *read_file_copy(const char *path) {
+    Matlab_file *file = read_file(path);
+    if (!file || !file->is_mapped) return file;
+
+    char *content = malloc(file->length);
+    Matlab_file *copy = malloc(sizeof(Matlab_file));
+    if (!content || !copy) {
+        fprintf(stderr, "Failed to allocate memory for file %s.\n", path);
+        free(content);
+        free(copy);
+        free_matlab_file(file);
+        return NULL;
+    }
+    memcpy(content, file->content, file->length);
+    *copy = *file;
+    copy->content = content;
+    copy->is_mapped = 0;
+    free_matlab_file(file);
+    return copy;
+}
+
+static TSPoint advance_point(TSPoint point, const char *from, const char *to) {
+    const char *newline;
+    while ((newline = memchr(from, '\n', (size_t)(to - from)))) {
+        point.row++;
+        point.column = 0;
+        from = newline + 1;
+    }
+    point.column += (uint32_t)(to - from);
+    return point;
+}
+
+// one edit replacing everything between the common prefix and suffix
+static TSInputEdit diff_to_edit(const Matlab_file *old_file, const Matlab_file *new_file) {
+    const char *old_content = old_file->content;
+    const char *new_content = new_file->content;
+    size_t shorter = old_file->length < new_file->length ? old_file->length : new_file->length;
+
+    size_t prefix = 0;
+    while (prefix < shorter && old_content[prefix] == new_content[prefix]) prefix++;
+    size_t suffix = 0;
+    while (suffix < shorter - prefix
+            && old_content[old_file->length - 1 - suffix] == new_content[new_file->length - 1 - suffix]) {
+        suffix++;
+    }
+
+    TSInputEdit edit;
+    edit.start_byte = (uint32_t)prefix;
+    edit.old_end_byte = (uint32_t)(old_file->length - suffix);
+    edit.new_end_byte = (uint32_t)(new_file->length - suffix);
+    TSPoint origin = {0, 0};
+    edit.start_point = advance_point(origin, old_content, old_content + prefix);
+    edit.old_end_point = advance_point(edit.start_point, old_content + prefix, old_content + edit.old_end_byte);
+    edit.new_end_point = advance_point(edit.start_point, new_content + prefix, new_content + edit.new_end_byte);
+    return edit;
+}
+
+static int compare_ranked(const Ranked_list *ranked, const Smell_list *list_a, size_t smell_a,
+                          const Smell_list *list_b, size_t smell_b) {
+    return compare_smells_by_metric(list_a, smell_a, list_b, smell_b, ranked->metric_id, ranked->ascending);
+}
+
+// first position whose smell ranks after the candidate (or_equal 0) or not before it (or_equal 1)
+static size_t find_ranked(const Ranked_list *ranked, const Smell_list *candidates, size_t smell_i, int or_equal) {
+    size_t low = 0;
+    size_t high = ranked->candidates.count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        int order = compare_ranked(ranked, &ranked->candidates, middle, candidates, smell_i);
+        if (order < 0 || (order == 0 && !or_equal)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static int reserve_positions(Watch_state *state, size_t count) {
+    if (count <= state->position_capacity) return 0;
+    size_t *positions = realloc(state->positions, count * sizeof(size_t));
+    if (!positions) {
+        fprintf(stderr, "Failed to allocate memory for ranking candidates.\n");
+        return -1;
+    }
+    state->positions = positions;
+    state->position_capacity = count;
+    return 0;
+}
+
+static void note_moved(Ranked_list *ranked, size_t position) {
+    if (position < ranked->first_moved) ranked->first_moved = position;
+}
+
+/*
+candidates are the file's ranked candidates, in ranked order. the
+positions are found by binary search, equal candidates share the
+location and so the file, they are next to each other.
+*/
+static void remove_ranked(Watch_state *state, Ranked_list *ranked, const Smell_list *candidates) {
+    if (candidates->count == 0 || reserve_positions(state, candidates->count) != 0) return;
+    size_t found = 0;
+    for (size_t smell_i = 0; smell_i < candidates->count; ++smell_i) {
+        size_t position = find_ranked(ranked, candidates, smell_i, 1);
+        if (found > 0 && position <= state->positions[found - 1]) position = state->positions[found - 1] + 1;
+        // a candidate whose insertion failed isn't ranked
+        if (position >= ranked->candidates.count
+                || compare_ranked(ranked, &ranked->candidates, position, candidates, smell_i) != 0) {
+            continue;
+        }
+        state->positions[found++] = position;
+    }
+    if (found == 0) return;
+    note_moved(ranked, state->positions[0]);
+    remove_smells(&ranked->candidates, state->positions, found);
+}
+
+static void insert_ranked(Watch_state *state, Ranked_list *ranked, const Smell_list *candidates) {
+    if (candidates->count == 0) return;
+    if (reserve_positions(state, candidates->count) != 0) return;
+    for (size_t smell_i = 0; smell_i < candidates->count; ++smell_i) {
+        state->positions[smell_i] = find_ranked(ranked, candidates, smell_i, 0);
+    }
+    if (insert_smells(&ranked->candidates, state->positions, candidates) != 0) return;
+    note_moved(ranked, state->positions[0]);
+}
+
+/*
+brings the file's tree and candidates up to date with its content on
+disk. new candidates are merged into the ranked lists, or only
+appended if keep_order is 0 (the initial scan sorts once at the end)
+*/
+static void update_file(Watch_state *state, Watched_file *watched, int keep_order) {
+    Matlab_file *new_file = read_file_copy(watched->file_name);
+    if (new_file) {
+        new_file->file_name = watched->file_name;
+        if (watched->file && watched->file->length == new_file->length
+                && memcmp(watched->file->content, new_file->content, new_file->length) == 0) {
+            free_matlab_file(new_file);
+            return;
+        }
+    }
+
+    TSTree *tree = NULL;
+    if (new_file) {
+        TSTree *old_tree = watched->tree;
+        if (old_tree) {
+            TSInputEdit edit = diff_to_edit(watched->file, new_file);
+            ts_tree_edit(old_tree, &edit);
+        }
+        tree = parse_matlab_file(state->parser, old_tree, new_file);
+        if (!tree) {
+            fprintf(stderr, "Failed to parse file %s.\n", watched->file_name);
+            free_matlab_file(new_file);
+            new_file = NULL;
+        }
+    }
+
+    if (watched->tree) ts_tree_delete(watched->tree);
+    if (watched->file) free_matlab_file(watched->file);
+    watched->tree = tree;
+    watched->file = new_file;
+    watched->LOC = 0;
+
+    Smell_list *lists[detector_count];
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        remove_ranked(state, &state->ranked[detector_i], &watched->candidates[detector_i]);
+        watched->candidates[detector_i].count = 0;
+        lists[detector_i] = &watched->candidates[detector_i];
+    }
+    if (!tree) return;
+
+    watched->LOC = run_detectors(state->visitor, state->detector_states,
+                                 ts_tree_root_node(tree), new_file, lists);
+
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        Ranked_list *ranked = &state->ranked[detector_i];
+        Smell_list *candidates = lists[detector_i];
+        // sorted once here, so removing them again needs no sort
+        if (sort_smell_list(candidates, ranked->metric_id, ranked->ascending) != 0) {
+            candidates->count = 0;
+            continue;
+        }
+        if (keep_order) {
+            insert_ranked(state, ranked, candidates);
+        } else {
+            append_smells(&ranked->candidates, candidates, 0, candidates->count);
+        }
+    }
+}
+
+static int is_pending_file(const Watch_state *state, const char *file_name) {
+    for (size_t pending_i = 0; pending_i < state->pending_count; ++pending_i) {
+        if (state->pending[pending_i]->file_name == file_name) return 1;
+    }
+    return 0;
+}
+
+static void print_changed_smells(const Watch_state *state, const Smell_detector *detector) {
+    Smell_list changed;
+    if (init_smell_list(&changed, detector->metrics, detector->metric_count) != 0) return;
+    for (size_t smell_i = 0; smell_i < detector->smell_list->count; ++smell_i) {
+        if (is_pending_file(state, detector->smell_list->locations[smell_i].file_name)) {
+            append_smells(&changed, detector->smell_list, smell_i, 1);
+        }
+    }
+    if (changed.count > 0) {
+        printf("Smell List: %s\n", detector->name);
+        print_smell_list(&changed);
+    }
+    free_smell_list(&changed);
+}
+
+static double elapsed_milliseconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) * 1000.0 + (double)(now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/*
+filters the survivors of the first step again if they changed, later
+percentage steps also refer to the number of all candidates
+*/
+static void update_smells(Ranked_list *ranked, Smell_detector *detector) {
+    size_t cutoff = count_first_step_survivors(detector, &ranked->candidates);
+    int changed = cutoff != ranked->cutoff || ranked->first_moved < cutoff
+                  || (ranked->candidates.count != ranked->reported_count && detector->filter_step_count > 1);
+    if (!changed) return;
+
+    detector->smell_list->count = 0;
+    if (append_smells(detector->smell_list, &ranked->candidates, 0, cutoff) != 0) return;
+    detector->candidate_count = ranked->candidates.count;
+    filter_smell_list(detector);
+    ranked->cutoff = cutoff;
+    ranked->reported_count = ranked->candidates.count;
+    ranked->first_moved = SIZE_MAX;
+}
+
+// full reports print all smells, otherwise only those of changed files
+static void report(Watch_state *state, int full, const struct timespec *start) {
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        update_smells(&state->ranked[detector_i], detectors[detector_i]);
+    }
+
+    for (size_t pending_i = 0; pending_i < state->pending_count && !full; ++pending_i) {
+        const Watched_file *watched = state->pending[pending_i];
+        printf("%s %s\n", watched->file ? "Analyzed" : "Removed", watched->file_name);
+    }
+    if (full) {
+        print_smell_lists(1);
+    } else {
+        for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+            print_changed_smells(state, detectors[detector_i]);
+        }
+    }
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        printf("Total number of %s smells: %zu\n", detectors[detector_i]->name,
+                detectors[detector_i]->smell_list->count);
+    }
+    printf("Updated %zu files in %.1f ms\n\n", state->pending_count, elapsed_milliseconds(start));
+    fflush(stdout);
+
+    for (size_t pending_i = 0; pending_i < state->pending_count; ++pending_i) {
+        state->pending[pending_i]->pending = 0;
+    }
+    state->pending_count = 0;
+}
+
+static int rescan(Watch_state *state) {
+    for (size_t slot_i = 0; slot_i < state->files.capacity; ++slot_i) {
+        Watched_file *watched = state->files.slots[slot_i];
+        if (watched && watched->file && mark_pending(state, watched->file_name) != 0) return -1;
+    }
+    walk_directories(state->path, add_directory_watch, state);
+    return walk_matlab_files(state->path, &walk_options, queue_changed_file, state);
+}
+
+static int handle_events(Watch_state *state, const char *buffer, size_t length) {
+    const char *position = buffer;
+    while (position < buffer + length) {
+        const struct inotify_event *event = (const struct inotify_event *)position;
+        position += sizeof(struct inotify_event) + event->len;
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            // events were lost, compare every file against its last content instead
+            if (rescan(state) != 0) return -1;
+            continue;
+        }
+        size_t index = (size_t)event->wd;
+        if (event->wd < 0 || index >= state->directory_capacity || !state->directories[index]) continue;
+        if (event->mask & IN_IGNORED) {
+            free(state->directories[index]);
+            state->directories[index] = NULL;
+            continue;
+        }
+        if (event->len == 0) continue;
+
+        char event_path[MAX_PATH_LENGTH];
+        snprintf(event_path, sizeof(event_path), "%s/%s", state->directories[index], event->name);
+
+        if (event->mask & IN_ISDIR) {
+            if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                // files can be written before the directory watch exists
+                walk_directories(event_path, add_directory_watch, state);
+                if (walk_matlab_files(event_path, &walk_options, queue_changed_file, state) != 0) return -1;
+            }
+            continue;
+        }
+        if (is_matlab_file(event->name) && (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM))) {
+            if (mark_pending(state, event_path) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+static int read_events(Watch_state *state, char *buffer, size_t buffer_size) {
+    ssize_t length = read(state->inotify_fd, buffer, buffer_size);
+    if (length < 0) {
+        if (errno == EINTR) return 0;
+        perror("inotify read");
+        return -1;
+    }
+    return handle_events(state, buffer, (size_t)length);
+}
+
+static int process_events(Watch_state *state) {
+    _Alignas(struct inotify_event) char buffer[EVENT_BUFFER_SIZE];
+    struct pollfd poll_fd = { .fd = state->inotify_fd, .events = POLLIN };
+
+    for (;;) {
+        if (read_events(state, buffer, sizeof(buffer)) != 0) return -1;
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        // one save often produces several events, take everything that is already queued
+        while (poll(&poll_fd, 1, 0) > 0) {
+            if (read_events(state, buffer, sizeof(buffer)) != 0) return -1;
+        }
+        if (state->pending_count == 0) continue;
+
+        for (size_t pending_i = 0; pending_i < state->pending_count; ++pending_i) {
+            update_file(state, state->pending[pending_i], 1);
+        }
+        report(state, 0, &start);
+    }
+}
+
+static void free_watch_state(Watch_state *state) {
+    if (state->inotify_fd >= 0) close(state->inotify_fd);
+    for (size_t directory_i = 0; directory_i < state->directory_capacity; ++directory_i) {
+        free(state->directories[directory_i]);
+    }
+    free(state->directories);
+    for (size_t slot_i = 0; slot_i < state->files.capacity; ++slot_i) {
+        if (state->files.slots[slot_i]) free_watched_file(state->files.slots[slot_i]);
+    }
+    free(state->files.slots);
+    free(state->pending);
+    free(state->positions);
+    if (state->ranked) {
+        for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+            free_smell_list(&state->ranked[detector_i].candidates);
+        }
+        free(state->ranked);
+    }
+    if (state->detector_states) {
+        free_detector_states(state->detector_states);
+        free(state->detector_states);
+    }
+    if (state->visitor) free_tree_visitor(state->visitor);
+    if (state->parser) ts_parser_delete(state->parser);
+}
+
+static int init_watch_state(Watch_state *state, const char *path) {
+    memset(state, 0, sizeof(Watch_state));
+    state->path = path;
+    state->inotify_fd = inotify_init();
+    if (state->inotify_fd < 0) {
+        perror("inotify_init");
+        return -1;
+    }
+
+    state->files.slots = calloc(INITIAL_TABLE_CAPACITY, sizeof(Watched_file *));
+    state->files.capacity = INITIAL_TABLE_CAPACITY;
+    state->ranked = calloc(detector_count, sizeof(Ranked_list));
+    state->detector_states = calloc(detector_count, sizeof(void *));
+    if (!state->files.slots || !state->ranked || !state->detector_states) {
+        fprintf(stderr, "Failed to allocate memory for watch mode.\n");
+        return -1;
+    }
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        const Smell_detector *detector = detectors[detector_i];
+        Ranked_list *ranked = &state->ranked[detector_i];
+        if (init_smell_list(&ranked->candidates, detector->metrics, detector->metric_count) != 0) return -1;
+        if (detector->filter_step_count > 0) {
+            ranked->metric_id = detector->filter_steps[0].metric_id;
+            ranked->ascending = detector->filter_steps[0].ascending;
+        }
+        // the first report copies the survivors
+        ranked->first_moved = 0;
+    }
+    if (init_detector_states(state->detector_states) != 0) return -1;
+
+    state->visitor = create_detector_visitor();
+    if (!state->visitor) {
+        fprintf(stderr, "Failed to create tree visitor for the detectors.\n");
+        return -1;
+    }
+    state->parser = ts_parser_new();
+    ts_parser_set_language(state->parser, tree_sitter_matlab());
+    return 0;
+}
+
+int watch_path(const char *path) {
+    Watch_state state;
+    if (init_watch_state(&state, path) != 0) {
+        free_watch_state(&state);
+        return -1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    // directories are watched first, so files written during the first scan aren't missed
+    if (walk_directories(path, add_directory_watch, &state) != 0) {
+        fprintf(stderr, "Error: --watch expects a directory that can be watched.\n");
+        free_watch_state(&state);
+        return -1;
+    }
+    walk_matlab_files(path, &walk_options, queue_changed_file, &state);
+
+    for (size_t pending_i = 0; pending_i < state.pending_count; ++pending_i) {
+        update_file(&state, state.pending[pending_i], 0);
+    }
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        Ranked_list *ranked = &state.ranked[detector_i];
+        sort_smell_list(&ranked->candidates, ranked->metric_id, ranked->ascending);
+    }
+    report(&state, 1, &start);
+    printf("Watching %s for changes.\n", path);
+    fflush(stdout);
+
+    int result = process_events(&state);
+    free_watch_state(&state);
+    return result;
+}
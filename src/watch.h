@@ -0,0 +1,21 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+/*
+long running mode: analyzes the directory once and then reacts
+to changes reported by inotify. every file keeps its content
+and syntax tree. a change is turned into one ts_tree_edit
+(everything between the common prefix and suffix of the old
+and new content) and the file is reparsed with its edited old
+tree, so tree-sitter only rebuilds the changed region. only the
+candidates of changed files are recomputed.
+the unfiltered candidates of each detector are kept ordered by
+its first metric (detector.h). changed files remove and insert
+their candidates in place, so the first step of every filter
+finds the list already ranked and needs no selection.
+only returns on errors, smell lists of the detectors have to
+be initialized before.
+*/
+int watch_path(const char *path);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef WORK_QUEUE_H
+#define WORK_QUEUE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/*
+bounded blocking queue connecting the stages of the
+analysis pipeline. producers block while the queue is full,
+consumers block while it is empty. after the producer side
+closed the queue, pop returns 0 once it is drained.
+*/
+typedef struct {
+    void **items;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    int closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} Work_queue;
+
+int init_work_queue(Work_queue *queue, size_t capacity);
+void free_work_queue(Work_queue *queue);
+
+// returns -1 if the queue was closed
+int work_queue_push(Work_queue *queue, void *item);
+// returns 1 and stores the item, 0 if the queue is closed and empty
+int work_queue_pop(Work_queue *queue, void **item);
+void work_queue_close(Work_queue *queue);
+
+#endif
@@ -0,0 +1,298 @@
+/*
+checks filter_smell_list and the bounded prefilter (Top_candidates,
+merge_top_candidates) against the sort-and-cut filter they replaced:
+every step sorts the remaining candidates by its metric and cuts the
+list at the threshold or after its share of all candidates. the
+candidates found in the .m fixtures of the given directory and
+synthetic ones with many ties are filtered with every combination
+of percentage and absolute steps, with shares of 0%, 30% and 100%,
+and have to give the same smells in the same order (make test).
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analysis.h"
+#include "detector_registry.h"
+#include "file_utils.h"
+#include "filter_utils.h"
+#include "path_table.h"
+#include "query_registry.h"
+#include "smell_list.h"
+
+#define SYNTHETIC_COUNT 500
+#define PART_COUNT 3
+
+static const float shares[] = { 0.0f, 0.3f, 1.0f };
+
+// the old filters passed the sorted metric through a global as well
+static const Smell_list *sorted_list;
+static size_t sorted_metric;
+static int sorted_ascending;
+
+static int compare_reference(const void *a, const void *b) {
+    size_t smell_a = *(const size_t *)a;
+    size_t smell_b = *(const size_t *)b;
+    double value_a = get_metric(sorted_list, smell_a, sorted_metric);
+    double value_b = get_metric(sorted_list, smell_b, sorted_metric);
+    if (value_a != value_b) return (value_a < value_b) == sorted_ascending ? -1 : 1;
+    const Smell_location *location_a = &sorted_list->locations[smell_a];
+    const Smell_location *location_b = &sorted_list->locations[smell_b];
+    int file_order = strcmp(location_a->file_name, location_b->file_name);
+    if (file_order != 0) return file_order;
+    return location_a->line < location_b->line ? -1 : location_a->line > location_b->line;
+}
+
+static int sort_reference(Smell_list *list, size_t metric_id, int ascending) {
+    size_t *items = malloc((list->count ? list->count : 1) * sizeof(size_t));
+    if (!items) return -1;
+    for (size_t item_i = 0; item_i < list->count; ++item_i) {
+        items[item_i] = item_i;
+    }
+    sorted_list = list;
+    sorted_metric = metric_id;
+    sorted_ascending = ascending;
+    qsort(items, list->count, sizeof(size_t), compare_reference);
+    int result = gather_smells(list, items, list->count);
+    free(items);
+    return result;
+}
+
+// the filter before the selection engine, list holds all candidates
+static int filter_reference(Smell_detector *detector, Smell_list *list) {
+    size_t total_count = list->count;
+    for (size_t step_i = 0; step_i < detector->filter_step_count && list->count > 0; ++step_i) {
+        const Filter_step *step = &detector->filter_steps[step_i];
+        const Configuration *config = get_config_by_name(detector, detector->metrics[step->metric_id].name);
+        if (!config || sort_reference(list, step->metric_id, step->ascending) != 0) return -1;
+
+        if (config->use_percentage) {
+            if (config->percentage_value < 0.0f || config->percentage_value > 1.0f) continue;
+            size_t keep_count = (size_t)(total_count * config->percentage_value);
+            if (keep_count < list->count) list->count = keep_count;
+            continue;
+        }
+        double threshold = config->absolute_is_float ? config->absolute_value.float_absolute
+                                                     : config->absolute_value.int_absolute;
+        size_t kept = 0;
+        while (kept < list->count) {
+            double value = get_metric(list, kept, step->metric_id);
+            if (step->ascending ? value > threshold : value < threshold) break;
+            kept++;
+        }
+        list->count = kept;
+    }
+    return 0;
+}
+
+static int same_smells(const Smell_list *a, const Smell_list *b) {
+    if (a->count != b->count) return 0;
+    for (size_t smell_i = 0; smell_i < a->count; ++smell_i) {
+        if (a->locations[smell_i].file_name != b->locations[smell_i].file_name
+                || a->locations[smell_i].line != b->locations[smell_i].line) {
+            return 0;
+        }
+        for (size_t metric_i = 0; metric_i < a->metric_count; ++metric_i) {
+            if (memcmp(&a->columns[metric_i][smell_i], &b->columns[metric_i][smell_i], sizeof(Metric_value)) != 0) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// the candidates are spread over the parts like over the workers, a second pass knows the total
+static int filter_bounded(Smell_detector *detector, const Smell_list *candidates) {
+    const size_t *known_total = NULL;
+    for (int pass = 0; pass < 2; ++pass) {
+        Top_candidates parts[PART_COUNT];
+        int result = 0;
+        for (size_t part_i = 0; part_i < PART_COUNT; ++part_i) {
+            if (init_top_candidates(&parts[part_i], detector, known_total) != 0) result = -1;
+        }
+        for (size_t smell_i = 0; smell_i < candidates->count && result == 0; ++smell_i) {
+            offer_candidate(&parts[smell_i % PART_COUNT], candidates, smell_i);
+        }
+        detector->smell_list->count = 0;
+        int merged = result == 0 ? merge_top_candidates(parts, PART_COUNT, detector) : -1;
+        for (size_t part_i = 0; part_i < PART_COUNT; ++part_i) {
+            free_top_candidates(&parts[part_i]);
+        }
+        if (merged < 0) return -1;
+        if (merged == 1) return filter_smell_list(detector);
+        known_total = &candidates->count;
+    }
+    fprintf(stderr, "%s: the bounded prefilter is incomplete with the total known.\n", detector->name);
+    return -1;
+}
+
+static void set_configs(Smell_detector *detector, const Configuration *configured, unsigned percentage_mask,
+                        float share, int middle_thresholds) {
+    for (size_t config_i = 0; config_i < detector->config_count; ++config_i) {
+        Configuration *config = &detector->configs[config_i];
+        *config = configured[config_i];
+        config->use_percentage = (percentage_mask >> config_i) & 1;
+        config->percentage_value = share;
+        if (!middle_thresholds) continue;
+        if (config->absolute_is_float) {
+            config->absolute_value.float_absolute = 0.5f;
+        } else {
+            config->absolute_value.int_absolute = 2;
+        }
+    }
+}
+
+// returns the number of configurations whose results differ, -1 on errors
+static int check_detector(Smell_detector *detector, const Smell_list *candidates, const char *source) {
+    Configuration configured[MAX_CONFIGS];
+    memcpy(configured, detector->configs, sizeof(configured));
+    Smell_list expected;
+    if (init_smell_list(&expected, detector->metrics, detector->metric_count) != 0) return -1;
+
+    int failures = 0;
+    for (unsigned mask = 0; mask < 1u << detector->config_count && failures >= 0; ++mask) {
+        for (size_t share_i = 0; share_i < sizeof(shares) / sizeof(shares[0]); ++share_i) {
+            for (int middle_thresholds = 0; middle_thresholds < 2; ++middle_thresholds) {
+                set_configs(detector, configured, mask, shares[share_i], middle_thresholds);
+                if (copy_smell_list(&expected, candidates) != 0 || filter_reference(detector, &expected) != 0
+                        || copy_smell_list(detector->smell_list, candidates) != 0) {
+                    failures = -1;
+                    break;
+                }
+                detector->candidate_count = candidates->count;
+                if (filter_smell_list(detector) != 0) {
+                    failures = -1;
+                    break;
+                }
+                const char *mismatch = !same_smells(&expected, detector->smell_list) ? "filter_smell_list" : NULL;
+                if (!mismatch) {
+                    if (filter_bounded(detector, candidates) != 0) {
+                        failures = -1;
+                        break;
+                    }
+                    if (!same_smells(&expected, detector->smell_list)) mismatch = "bounded prefilter";
+                }
+                if (mismatch) {
+                    fprintf(stderr, "FAIL %s on %s candidates: percentage steps %#x, share %.2f, %s thresholds,"
+                                    " %zu smells expected, %zu found\n",
+                            mismatch, source, mask, shares[share_i], middle_thresholds ? "middle" : "configured",
+                            expected.count, detector->smell_list->count);
+                    failures++;
+                }
+            }
+        }
+    }
+    memcpy(detector->configs, configured, sizeof(configured));
+    free_smell_list(&expected);
+    return failures;
+}
+
+// deterministic pseudo random numbers (xorshift64)
+static uint64_t next_random(uint64_t *random_state) {
+    uint64_t x = *random_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *random_state = x;
+}
+
+// few distinct values, so most candidates tie with others and only their location orders them
+static int fill_tied_candidates(Smell_list *list, uint64_t *random_state) {
+    const char *file_names[] = { path_table_add("b.m"), path_table_add("a.m"), path_table_add("a/c.m") };
+    for (size_t smell_i = 0; smell_i < SYNTHETIC_COUNT; ++smell_i) {
+        if (!file_names[smell_i % 3]) return -1;
+        // every candidate needs a distinct location
+        size_t added = add_smell(list, create_location(file_names[smell_i % 3], (uint32_t)(smell_i / 3) + 1));
+        if (added == SMELL_NOT_ADDED) return -1;
+        for (size_t metric_i = 0; metric_i < list->metric_count; ++metric_i) {
+            uint64_t value = next_random(random_state) % 5;
+            if (list->metrics[metric_i].is_float) {
+                set_float_metric(list, added, metric_i, (float)value / 4.0f);
+            } else {
+                set_int_metric(list, added, metric_i, (int32_t)value);
+            }
+        }
+    }
+    return 0;
+}
+
+static int check_fixtures(const char *path, Smell_list *candidates) {
+    File_list file_list;
+    init_file_list(&file_list);
+    Walk_options walk = { UNLIMITED_DEPTH, 1, NULL, 0, 1 };
+    uint32_t total_LOC = 0;
+    int result = load_files(path, &walk, &file_list) == 0 && file_list.count > 0 ? 0 : -1;
+    if (result == 0) result = analyze_files(&file_list, 1, 0, &total_LOC);
+    free_file_list(&file_list);
+    if (result != 0) {
+        fprintf(stderr, "Failed to analyze the fixtures in %s.\n", path);
+        return -1;
+    }
+
+    int failures = 0;
+    for (size_t detector_i = 0; detector_i < detector_count && failures >= 0; ++detector_i) {
+        if (copy_smell_list(&candidates[detector_i], detectors[detector_i]->smell_list) != 0) return -1;
+        int detector_failures = check_detector(detectors[detector_i], &candidates[detector_i], path);
+        failures = detector_failures < 0 ? -1 : failures + detector_failures;
+    }
+    return failures;
+}
+
+static int check_synthetic(Smell_list *candidates) {
+    uint64_t random_state = 0x9e3779b97f4a7c15u;
+    int failures = 0;
+    for (size_t detector_i = 0; detector_i < detector_count && failures >= 0; ++detector_i) {
+        candidates[detector_i].count = 0;
+        if (fill_tied_candidates(&candidates[detector_i], &random_state) != 0) return -1;
+        int detector_failures = check_detector(detectors[detector_i], &candidates[detector_i], "synthetic");
+        failures = detector_failures < 0 ? -1 : failures + detector_failures;
+    }
+    return failures;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s FIXTURE_DIRECTORY\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    load_config("config.ini", detectors, detector_count);
+    if (compile_queries() != 0) {
+        fprintf(stderr, "Error: Failed to compile detector queries.\n");
+        return EXIT_FAILURE;
+    }
+
+    Smell_list candidates[detector_count];
+    int result = 0;
+    for (size_t i = 0; i < detector_count; ++i) {
+        detectors[i]->smell_list = malloc(sizeof(Smell_list));
+        if (!detectors[i]->smell_list
+                || init_smell_list(detectors[i]->smell_list, detectors[i]->metrics, detectors[i]->metric_count) != 0
+                || init_smell_list(&candidates[i], detectors[i]->metrics, detectors[i]->metric_count) != 0) {
+            fprintf(stderr, "Error: Failed to allocate smell lists.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    int fixture_failures = check_fixtures(argv[1], candidates);
+    int synthetic_failures = fixture_failures < 0 ? -1 : check_synthetic(candidates);
+    if (fixture_failures < 0 || synthetic_failures < 0) {
+        fprintf(stderr, "Error: Filter test failed to run.\n");
+        result = -1;
+    } else if (fixture_failures + synthetic_failures > 0) {
+        fprintf(stderr, "%d filter configurations differ from sort-and-cut.\n", fixture_failures + synthetic_failures);
+        result = -1;
+    } else {
+        printf("filter_test: all filter configurations match sort-and-cut\n");
+    }
+
+    for (size_t i = 0; i < detector_count; ++i) {
+        free_smell_list(&candidates[i]);
+        free_smell_list(detectors[i]->smell_list);
+        free(detectors[i]->smell_list);
+    }
+    free_path_table();
+    free_queries();
+    return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
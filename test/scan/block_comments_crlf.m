@@ -0,0 +1,14 @@
+function y = nested(x)
+%{
+outer block comment, long enough to cross a block
+  %{  
+  inner block comment
+
+  %}
+still in the outer block
+%}
+%{ not a block, text follows the marker
+y = x; % code with a trailing comment
+%}
+y = y + 1;
+end
@@ -0,0 +1,4 @@
+% keyword across the blocks
+function y = twice(x)
+    y = 2 * x;
+end
@@ -0,0 +1,3 @@
+% the only keyword is the last word of the file,
+% without a newline after it
+x = 1; % classdef
\ No newline at end of file
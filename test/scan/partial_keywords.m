@@ -0,0 +1,3 @@
+% parts stop short       classde
+unction = 3;
+x = unction + 1; % functio
\ No newline at end of file
@@ -0,0 +1,422 @@
+/*
+checks the AVX2 scans of the prefilter and the line index against
+the scalar loops and against plain byte loops: the fixtures in
+scan/ of the given directory, whose keywords and newlines sit at
+the edges of the 32 byte blocks, and buffers of every length up to
+MAX_SWEEP_LENGTH with a keyword or newlines at every position (make
+test). the line classifier is checked against hand counted lines
+of the fixtures with nested "%{ %}" blocks, with '\n' and "\r\n"
+line endings. the TCC pair kernels get random access matrices of
+classes with 0 to MAX_TCC_METHODS methods and property counts on
+both sides of the 256 bit lanes, their TCC has to match a plain
+count of the connected pairs. every buffer is a heap copy of
+exactly its length, so reads past the end are caught by
+sanitizers. without AVX2 only the scalar loops are checked.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "detector_registry.h"
+#include "file_utils.h"
+#include "line_index.h"
+#include "path_table.h"
+#include "prefilter.h"
+#include "tcc.h"
+
+#define MAX_SWEEP_LENGTH 100
+// newline runs fill the line index up to its capacity, 256 lines and doubled from there
+#define MAX_NEWLINE_RUN 1100
+#define MAX_PATH_LENGTH 4096
+#define MAX_TCC_METHODS 12
+#define MAX_TCC_PROPERTIES 520
+#define TCC_SEED_COUNT 4
+
+// the prefilter's decision for the fixtures, checked on top of the comparison
+typedef struct {
+    const char *file_name;
+    int needs_parse;
+} Expected_decision;
+
+static const Expected_decision expected_decisions[] = {
+    { "keyword_across_blocks.m", 1 },
+    { "keyword_at_end.m", 1 },
+    { "partial_keywords.m", 0 },
+    { "newlines_33.m", 0 },
+};
+
+// hand counted lines of the classifier fixtures, the rows are the outer "%{ %}" block
+typedef struct {
+    const char *file_name;
+    uint32_t code_lines;
+    uint32_t comment_lines;
+    uint32_t block_first_row;
+    uint32_t block_last_row;
+    uint32_t block_comment_lines;
+} Expected_lines;
+
+static const Expected_lines expected_lines[] = {
+    { "block_comments.m", 4, 9, 1, 8, 7 },
+    { "block_comments_crlf.m", 4, 9, 1, 8, 7 },
+};
+
+static int failures;
+
+static void fail(const char *mode, const char *check, const char *source, size_t length) {
+    fprintf(stderr, "FAIL %s %s on %s (%zu bytes)\n", mode, check, source, length);
+    failures++;
+}
+
+static size_t count_newlines_plain(const char *text, size_t length) {
+    size_t newline_count = 0;
+    for (size_t position = 0; position < length; ++position) {
+        newline_count += text[position] == '\n';
+    }
+    return newline_count;
+}
+
+static int contains_plain(const char *text, size_t length, const char *keyword) {
+    size_t keyword_length = strlen(keyword);
+    for (size_t start = 0; start + keyword_length <= length; ++start) {
+        if (memcmp(text + start, keyword, keyword_length) == 0) return 1;
+    }
+    return 0;
+}
+
+static int needs_parse_plain(const char *text, size_t length) {
+    for (size_t detector_i = 0; detector_i < detector_count; ++detector_i) {
+        for (const char *const *keyword = detectors[detector_i]->keywords; *keyword; ++keyword) {
+            if (contains_plain(text, length, *keyword)) return 1;
+        }
+    }
+    return 0;
+}
+
+// content is copied, so the buffer ends exactly after length bytes
+static void check_prefilter(const char *content, size_t length, const char *source) {
+    char *copy = malloc(length ? length : 1);
+    if (!copy) {
+        fail("copy", "allocation", source, length);
+        return;
+    }
+    memcpy(copy, content, length);
+    Matlab_file file = { .file_name = source, .content = copy, .length = length };
+
+    int needs_parse = needs_parse_plain(copy, length);
+    size_t newline_count = count_newlines_plain(copy, length);
+    uint32_t scalar_LOC = 0;
+    for (int vector = 0; vector < 2; ++vector) {
+        enable_vector_scans(vector);
+        if (vector && !vector_scans_enabled()) break;
+        const char *mode = vector ? "AVX2" : "scalar";
+        if (file_needs_parse(&file) != needs_parse) fail(mode, "keyword scan", source, length);
+        if (count_newlines(copy, length) != newline_count) fail(mode, "newline count", source, length);
+        uint32_t LOC = count_unparsed_LOC(&file);
+        if (!vector) scalar_LOC = LOC;
+        if (LOC != scalar_LOC) fail(mode, "unparsed LOC", source, length);
+    }
+    enable_vector_scans(1);
+    free(copy);
+}
+
+static int same_rows(const uint32_t *rows, const uint32_t *other_rows, size_t count) {
+    return count == 0 || memcmp(rows, other_rows, count * sizeof(uint32_t)) == 0;
+}
+
+/*
+builds the index with the scalar and the AVX2 scans. the line
+starts are compared with a plain loop, the prefix counts of the
+classifier with the scalar index. expected is NULL if the counts
+aren't known.
+*/
+static void check_line_index(const char *content, size_t length, const char *source,
+                             const Expected_lines *expected) {
+    char *copy = malloc(length ? length : 1);
+    uint32_t *line_starts = malloc((count_newlines_plain(content, length) + 1) * sizeof(uint32_t));
+    Line_index indexes[2];
+    init_line_index(&indexes[0]);
+    init_line_index(&indexes[1]);
+    if (!copy || !line_starts) {
+        fail("copy", "allocation", source, length);
+        goto cleanup;
+    }
+    memcpy(copy, content, length);
+    size_t line_count = 1;
+    line_starts[0] = 0;
+    for (size_t position = 0; position < length; ++position) {
+        if (copy[position] == '\n') line_starts[line_count++] = (uint32_t)(position + 1);
+    }
+
+    for (int vector = 0; vector < 2; ++vector) {
+        enable_vector_scans(vector);
+        if (vector && !vector_scans_enabled()) break;
+        const char *mode = vector ? "AVX2" : "scalar";
+        Line_index *index = &indexes[vector];
+        if (build_line_index(index, copy, length) != 0) {
+            fail(mode, "line index allocation", source, length);
+            continue;
+        }
+        if (index->line_count != line_count || !same_rows(index->line_starts, line_starts, line_count)) {
+            fail(mode, "line starts", source, length);
+            continue;
+        }
+        if (vector && (!same_rows(index->code_before, indexes[0].code_before, line_count + 1) ||
+                       !same_rows(index->comments_before, indexes[0].comments_before, line_count + 1))) {
+            fail(mode, "line classes", source, length);
+        }
+        if (!expected) continue;
+        if (count_code_lines(index, 0, UINT32_MAX) != expected->code_lines) {
+            fail(mode, "code lines", source, length);
+        }
+        if (count_comment_lines(index, 0, UINT32_MAX) != expected->comment_lines) {
+            fail(mode, "comment lines", source, length);
+        }
+        if (count_code_lines(index, expected->block_first_row, expected->block_last_row) != 0 ||
+            count_comment_lines(index, expected->block_first_row, expected->block_last_row) !=
+                expected->block_comment_lines) {
+            fail(mode, "block comment lines", source, length);
+        }
+    }
+
+cleanup:
+    enable_vector_scans(1);
+    free_line_index(&indexes[0]);
+    free_line_index(&indexes[1]);
+    free(line_starts);
+    free(copy);
+}
+
+static const char *base_name(const char *file_name) {
+    const char *slash = strrchr(file_name, '/');
+    return slash ? slash + 1 : file_name;
+}
+
+static const Expected_lines *find_expected_lines(const char *file_name) {
+    for (size_t case_i = 0; case_i < sizeof(expected_lines) / sizeof(expected_lines[0]); ++case_i) {
+        if (strcmp(expected_lines[case_i].file_name, base_name(file_name)) == 0) return &expected_lines[case_i];
+    }
+    return NULL;
+}
+
+static const Expected_decision *find_expected_decision(const char *file_name) {
+    for (size_t case_i = 0; case_i < sizeof(expected_decisions) / sizeof(expected_decisions[0]); ++case_i) {
+        if (strcmp(expected_decisions[case_i].file_name, base_name(file_name)) == 0) {
+            return &expected_decisions[case_i];
+        }
+    }
+    return NULL;
+}
+
+static int check_fixtures(const char *directory) {
+    char path[MAX_PATH_LENGTH];
+    if (snprintf(path, sizeof(path), "%s/scan", directory) >= (int)sizeof(path)) return -1;
+    File_list file_list;
+    init_file_list(&file_list);
+    Walk_options walk = { UNLIMITED_DEPTH, 1, NULL, 0, 1 };
+    if (load_files(path, &walk, &file_list) != 0 || file_list.count == 0) {
+        fprintf(stderr, "Failed to load the fixtures in %s.\n", path);
+        free_file_list(&file_list);
+        return -1;
+    }
+
+    size_t decided = 0;
+    size_t counted = 0;
+    for (size_t file_i = 0; file_i < file_list.count; ++file_i) {
+        const Matlab_file *file = file_list.files[file_i];
+        check_prefilter(file->content, file->length, file->file_name);
+        const Expected_lines *lines = find_expected_lines(file->file_name);
+        counted += lines != NULL;
+        check_line_index(file->content, file->length, file->file_name, lines);
+        const Expected_decision *expected = find_expected_decision(file->file_name);
+        if (!expected) continue;
+        decided++;
+        if (needs_parse_plain(file->content, file->length) != expected->needs_parse) {
+            fail("fixture", "prefilter decision", file->file_name, file->length);
+        }
+    }
+    if (decided != sizeof(expected_decisions) / sizeof(expected_decisions[0])) {
+        fprintf(stderr, "FAIL only %zu of the prefilter fixtures were found in %s\n", decided, path);
+        failures++;
+    }
+    if (counted != sizeof(expected_lines) / sizeof(expected_lines[0])) {
+        fprintf(stderr, "FAIL only %zu of the line classifier fixtures were found in %s\n", counted, path);
+        failures++;
+    }
+    free_file_list(&file_list);
+    return 0;
+}
+
+// filler without keywords or newlines, the sweeps put them into it
+static void fill_plain(char *buffer, size_t length) {
+    for (size_t position = 0; position < length; ++position) {
+        buffer[position] = "xy = 1 + z; "[position % 12];
+    }
+}
+
+static void sweep_prefilter(void) {
+    char buffer[MAX_SWEEP_LENGTH];
+    static const char *const keywords[] = { "function", "classdef", "functio" };
+    for (size_t length = 0; length <= MAX_SWEEP_LENGTH; ++length) {
+        fill_plain(buffer, length);
+        check_prefilter(buffer, length, "filler");
+        for (size_t keyword_i = 0; keyword_i < sizeof(keywords) / sizeof(keywords[0]); ++keyword_i) {
+            size_t keyword_length = strlen(keywords[keyword_i]);
+            for (size_t start = 0; start + keyword_length <= length; ++start) {
+                fill_plain(buffer, length);
+                memcpy(buffer + start, keywords[keyword_i], keyword_length);
+                check_prefilter(buffer, length, keywords[keyword_i]);
+            }
+        }
+        // leading whitespace and newlines at every position, also next to each other
+        for (size_t position = 0; position < length; ++position) {
+            fill_plain(buffer, length);
+            memset(buffer, ' ', position / 2);
+            buffer[position] = '\n';
+            if (position + 1 < length) buffer[position + 1] = '\n';
+            check_prefilter(buffer, length, "newlines");
+        }
+    }
+}
+
+// newlines at every position and every step, lines starting with '%' open and close blocks
+static void sweep_line_index(void) {
+    char buffer[MAX_SWEEP_LENGTH];
+    for (size_t length = 0; length <= MAX_SWEEP_LENGTH; ++length) {
+        fill_plain(buffer, length);
+        check_line_index(buffer, length, "filler", NULL);
+        for (size_t position = 0; position < length; ++position) {
+            fill_plain(buffer, length);
+            buffer[position] = '\n';
+            if (position + 1 < length) buffer[position + 1] = '\n';
+            check_line_index(buffer, length, "newlines", NULL);
+        }
+        for (size_t step = 1; step <= 33; ++step) {
+            fill_plain(buffer, length);
+            for (size_t position = step - 1, line_i = 0; position < length; position += step, ++line_i) {
+                buffer[position] = '\n';
+                if (position + 2 < length && line_i % 3 != 2) {
+                    buffer[position + 1] = '%';
+                    buffer[position + 2] = line_i % 3 == 0 ? '{' : '}';
+                }
+            }
+            check_line_index(buffer, length, "marker lines", NULL);
+        }
+    }
+
+    static char newline_run[MAX_NEWLINE_RUN];
+    memset(newline_run, '\n', sizeof(newline_run));
+    for (size_t length = MAX_SWEEP_LENGTH; length <= MAX_NEWLINE_RUN; ++length) {
+        check_line_index(newline_run, length, "newline run", NULL);
+    }
+}
+
+// xorshift, the matrices are the same on every run
+static uint32_t next_random(uint32_t *random_state) {
+    *random_state ^= *random_state << 13;
+    *random_state ^= *random_state >> 17;
+    *random_state ^= *random_state << 5;
+    return *random_state;
+}
+
+/*
+property p has the id 2 * p + 1, the even ids accessed by the
+methods are no properties and have to be ignored. a method
+accesses each property with the given chance in 1/1024.
+*/
+static void check_tcc(int method_count, int property_count, uint32_t chance, uint32_t seed, Arena *arena) {
+    static int accesses[MAX_TCC_METHODS][MAX_TCC_PROPERTIES];
+    Id_list accessed_properties[MAX_TCC_METHODS];
+    Id_set properties;
+    char source[64];
+    snprintf(source, sizeof(source), "%d methods x %d properties", method_count, property_count);
+    uint32_t random_state = seed * 2654435761u + (uint32_t)(method_count * 1024 + property_count) + 1;
+    // the size of the access matrix, for the failures
+    size_t matrix_size = (size_t)method_count * (((size_t)property_count + 255) / 256 * 32);
+
+    reset_arena(arena);
+    init_id_set(&properties);
+    for (int property_i = 0; property_i < property_count; ++property_i) {
+        if (add_to_id_set(&properties, (uint32_t)(2 * property_i + 1), arena) < 0) {
+            fail("copy", "allocation", source, matrix_size);
+            return;
+        }
+    }
+    for (int method_i = 0; method_i < method_count; ++method_i) {
+        init_id_list(&accessed_properties[method_i]);
+        for (int property_i = 0; property_i < property_count; ++property_i) {
+            accesses[method_i][property_i] = next_random(&random_state) % 1024 < chance;
+            uint32_t id = (uint32_t)(2 * property_i + (accesses[method_i][property_i] ? 1 : 0));
+            if (!accesses[method_i][property_i] && next_random(&random_state) % 8 != 0) continue;
+            if (add_to_id_list(&accessed_properties[method_i], id, arena) != 0) {
+                fail("copy", "allocation", source, matrix_size);
+                return;
+            }
+        }
+    }
+
+    uint64_t connected_pairs = 0;
+    for (int method_i = 0; method_i < method_count; ++method_i) {
+        for (int method_j = method_i + 1; method_j < method_count; ++method_j) {
+            for (int property_i = 0; property_i < property_count; ++property_i) {
+                if (accesses[method_i][property_i] && accesses[method_j][property_i]) {
+                    connected_pairs++;
+                    break;
+                }
+            }
+        }
+    }
+    uint64_t total_pairs = (uint64_t)method_count * (uint64_t)(method_count - 1) / 2;
+    float expected = method_count < 2 || property_count == 0 ? 0.0f : (float)connected_pairs / total_pairs;
+
+    for (int vector = 0; vector < 2; ++vector) {
+        enable_vector_scans(vector);
+        if (vector && !vector_scans_enabled()) break;
+        float tcc = compute_tcc_from_accesses(&properties, accessed_properties, method_count, arena);
+        if (tcc != expected) fail(vector ? "AVX2" : "scalar", "TCC pairs", source, matrix_size);
+    }
+    enable_vector_scans(1);
+}
+
+// 0, 1 and 2 methods, and property counts around the 64 bit words and the 256 bit lanes
+static void sweep_tcc(void) {
+    static const int property_counts[] = { 0, 1, 2, 7, 63, 64, 65, 100, 255, 256, 257, 300, 511, 512, 513 };
+    static const uint32_t chances[] = { 2, 16, 128, 512 };
+    Arena arena;
+    init_arena(&arena);
+    for (int method_count = 0; method_count <= MAX_TCC_METHODS; ++method_count) {
+        for (size_t count_i = 0; count_i < sizeof(property_counts) / sizeof(property_counts[0]); ++count_i) {
+            for (size_t chance_i = 0; chance_i < sizeof(chances) / sizeof(chances[0]); ++chance_i) {
+                for (uint32_t seed = 0; seed < TCC_SEED_COUNT; ++seed) {
+                    check_tcc(method_count, property_counts[count_i], chances[chance_i], seed, &arena);
+                }
+            }
+        }
+    }
+    free_arena(&arena);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s FIXTURE_DIRECTORY\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    enable_vector_scans(1);
+    if (!vector_scans_enabled()) printf("scan_test: no AVX2, only the scalar scans are checked\n");
+
+    int result = check_fixtures(argv[1]);
+    sweep_prefilter();
+    sweep_line_index();
+    sweep_tcc();
+    free_path_table();
+    if (result != 0) {
+        fprintf(stderr, "Error: Scan test failed to run.\n");
+        return EXIT_FAILURE;
+    }
+    if (failures > 0) {
+        fprintf(stderr, "%d scan checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("scan_test: all scans match\n");
+    return EXIT_SUCCESS;
+}